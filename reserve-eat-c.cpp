@@ -0,0 +1,271 @@
+// Author: Zurinee Irish M. Belo, Katherine Anne S. Liwanag, Jane Allyson L. Paray, and Jhenelle K.Alonzo
+
+// Reserve Eat C interface: maps the calls declared in reserve-eat-c.h onto ReservationSystem
+
+#include "reserve-eat-c.h"
+#include "reserve-eat-core.h"
+
+using namespace std;         // Standard namespace
+using namespace reserve_eat; // Reservation engine
+
+struct re_book
+{
+    ReservationSystem system;
+};
+
+// Runs a call and turns any exception into RE_INTERNAL, so none crosses into C
+template <typename Call>
+re_status guarded(Call call)
+{
+    try
+    {
+        return call();
+    }
+    catch (...)
+    {
+        return RE_INTERNAL;
+    }
+}
+
+// Calls visit with a reservation's fields; returns its answer
+int visitReservation(const Reservation &res, re_visit visit, void *context)
+{
+    re_reservation view = {res.getID().c_str(), res.getUsername().c_str(), res.getName().c_str(), res.getPhoneNo().c_str(),
+                           res.getDate().c_str(), res.getStartTime().c_str(), res.getEndTime().c_str(), res.getStatus().c_str(),
+                           res.getTablesReserved()};
+    return visit(&view, context);
+}
+
+// Function to tell whether a failed review or payment found the reservation in the wrong status or not at all
+re_status missingOrWrongStatus(ReservationSystem &system, const char *id)
+{
+    return system.exists(id) ? RE_WRONG_STATUS : RE_NOT_FOUND;
+}
+
+extern "C"
+{
+    int re_api_version(void)
+    {
+        return RE_API_VERSION;
+    }
+
+    const char *re_status_message(re_status status)
+    {
+        switch (status)
+        {
+        case RE_OK:
+            return "OK";
+        case RE_NOT_FOUND:
+            return "Reservation not found";
+        case RE_WRONG_STATUS:
+            return "Reservation status does not allow this";
+        case RE_INVALID:
+            return "Invalid input";
+        case RE_NO_TABLES:
+            return "Not enough tables are available";
+        case RE_TRUNCATED:
+            return "Output buffer too small";
+        case RE_IO:
+            return "File could not be read or written";
+        default:
+            return "Internal error";
+        }
+    }
+
+    re_book *re_open(const char *reservations_file)
+    {
+        try
+        {
+            if (reservations_file && !ifstream(reservations_file))
+                return nullptr;
+            re_book *book = new re_book();
+            if (reservations_file)
+                book->system.loadReservationsFromFile(reservations_file);
+            return book;
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    void re_close(re_book *book)
+    {
+        delete book;
+    }
+
+    re_status re_save(re_book *book, const char *reservations_file)
+    {
+        return guarded([&]()
+                       {
+                           if (!reservations_file || !ofstream(reservations_file, ios::app))
+                               return RE_IO;
+                           book->system.saveReservationsToFile(reservations_file);
+                           return RE_OK; });
+    }
+
+    re_status re_available_tables(re_book *book, const char *date, const char *start_time, int *tables)
+    {
+        return guarded([&]()
+                       {
+                           if (!date || !start_time || !isValidDate(date) || !isValidTime24(start_time))
+                               return RE_INVALID;
+                           int day = dayNumber(dateKey(date));
+                           book->system.loadDates(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1));
+                           *tables = max(0, book->system.getAvailableTables(date, start_time, addTwoHours24(start_time)));
+                           return RE_OK; });
+    }
+
+    re_status re_add(re_book *book, const char *username, const char *name, const char *phone, int tables, const char *date,
+                     const char *start_time, char *id, size_t id_size)
+    {
+        return re_add_keyed(book, nullptr, username, name, phone, tables, date, start_time, id, id_size);
+    }
+
+    re_status re_add_keyed(re_book *book, const char *request_key, const char *username, const char *name, const char *phone, int tables,
+                           const char *date, const char *start_time, char *id, size_t id_size)
+    {
+        return guarded([&]()
+                       {
+                           if (!username || !isValidUsername(username) || !name || !isValidName(name) || !phone || !isValidPhoneNo(phone) ||
+                               tables < 1 || tables > TOTAL_TABLES || !id || id_size == 0)
+                               return RE_INVALID;
+                           if (!date || !start_time || !isValidDate(date) || !isValidTime24(start_time))
+                               return RE_INVALID;
+                           string added = book->system.tryAddReservation(username, name, phone, tables, date, start_time, request_key ? request_key : "");
+                           if (added.empty())
+                               return RE_NO_TABLES;
+                           if (added.size() >= id_size)
+                               return RE_TRUNCATED;
+                           memcpy(id, added.c_str(), added.size() + 1);
+                           return RE_OK; });
+    }
+
+    re_status re_update(re_book *book, const char *id, const char *username, const char *date, const char *start_time, int tables)
+    {
+        return guarded([&]()
+                       {
+                           if (!id || !username || !isValidUsername(username) || !date || !start_time || !isValidDate(date) ||
+                               !isValidTime24(start_time) || tables < 1 || tables > TOTAL_TABLES)
+                               return RE_INVALID;
+                           Reservation res;
+                           if (!book->system.resolve(book->system.findHandle(id), res) || res.getUsername() != username)
+                               return RE_NOT_FOUND;
+                           if (res.getStatus() != STATUS[0])
+                               return RE_WRONG_STATUS;
+                           if (book->system.updateReservation(id, username, date, start_time, tables).empty())
+                               return RE_OK;
+                           // The input was checked above, so it failed on the tables or on a review that got in first
+                           return book->system.getStatus(id) == STATUS[0] ? RE_NO_TABLES : RE_WRONG_STATUS; });
+    }
+
+    re_status re_approve(re_book *book, const char *id)
+    {
+        return guarded([&]()
+                       { return !id ? RE_INVALID : book->system.approveReservation(id) ? RE_OK : missingOrWrongStatus(book->system, id); });
+    }
+
+    re_status re_reject(re_book *book, const char *id)
+    {
+        return guarded([&]()
+                       { return !id ? RE_INVALID : book->system.rejectReservation(id) ? RE_OK : missingOrWrongStatus(book->system, id); });
+    }
+
+    re_status re_cancel(re_book *book, const char *id)
+    {
+        return re_cancel_keyed(book, nullptr, id);
+    }
+
+    re_status re_cancel_keyed(re_book *book, const char *request_key, const char *id)
+    {
+        return guarded([&]()
+                       { return !id ? RE_INVALID : book->system.cancelReservation(id, request_key ? request_key : "") ? RE_OK : RE_NOT_FOUND; });
+    }
+
+    void re_set_request_key_limits(re_book *book, size_t max_keys, int ttl_seconds)
+    {
+        guarded([&]()
+                {
+                    book->system.setRequestKeyLimits(max_keys, ttl_seconds);
+                    return RE_OK; });
+    }
+
+    re_status re_settle(re_book *book, const char *id, const char *payment_type)
+    {
+        return guarded([&]()
+                       {
+                           if (!id || !payment_type)
+                               return RE_INVALID;
+                           return book->system.settlePayment(id, payment_type) ? RE_OK : missingOrWrongStatus(book->system, id); });
+    }
+
+    re_status re_get(re_book *book, const char *id, re_visit visit, void *context)
+    {
+        return guarded([&]()
+                       {
+                           Reservation res;
+                           if (!id || !visit)
+                               return RE_INVALID;
+                           if (!book->system.resolve(book->system.findHandle(id), res))
+                               return RE_NOT_FOUND;
+                           visitReservation(res, visit, context);
+                           return RE_OK; });
+    }
+
+    size_t re_list(re_book *book, const char *username, const char *status, re_visit visit, void *context)
+    {
+        size_t visited = 0;
+        if (!visit)
+            return 0;
+        try
+        {
+            if (username)
+                book->system.loadUser(username);
+            ReservationSnapshot snap = book->system.snapshot();
+            for (const auto &res : snap)
+            {
+                if ((username && res.getUsername() != username) || (status && res.getStatus() != status))
+                    continue;
+                visited++;
+                if (visitReservation(res, visit, context) != 0)
+                    break;
+            }
+        }
+        catch (...)
+        {
+        }
+        return visited;
+    }
+
+    re_status re_history(re_book *book, const char *username, re_customer_history *history)
+    {
+        return guarded([&]()
+                       {
+                           if (!username || !history)
+                               return RE_INVALID;
+                           CustomerHistory totals = book->system.customerHistory(username);
+                           *history = {totals.bookings, totals.settled, totals.rejected, totals.tablesConsumed, totals.lastVisit};
+                           return RE_OK; });
+    }
+
+    size_t re_search(re_book *book, const char *query, size_t limit, re_visit visit, void *context)
+    {
+        size_t visited = 0;
+        try
+        {
+            if (!query || !visit)
+                return 0;
+            book->system.loadDates(0, 99999999);
+            for (const auto &res : book->system.searchGuests(query, limit))
+            {
+                visited++;
+                if (visitReservation(res, visit, context) != 0)
+                    break;
+            }
+        }
+        catch (...)
+        {
+        }
+        return visited;
+    }
+}
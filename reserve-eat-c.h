@@ -0,0 +1,99 @@
+/* Reserve Eat C interface: a stable, C-callable wrapper around the reservation engine in reserve-eat-core.h, for embedding
+the engine in other services or driving it from benchmarks without the console. Functions never throw or prompt; they return
+an re_status. Strings are NUL-terminated and copied on the way in; strings handed to a callback stay valid until it returns.
+Requests are not rate limited here, unlike the console and session menus; a service exposing these calls meters its own clients. */
+
+#ifndef RESERVE_EAT_C_H
+#define RESERVE_EAT_C_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define RE_API_VERSION 1 /* Bumped only when an existing declaration changes */
+
+typedef struct re_book re_book; /* One reservation book; separate books share nothing but the log files */
+
+typedef enum re_status
+{
+    RE_OK = 0,
+    RE_NOT_FOUND = 1,    /* No reservation with that ID (for that user) */
+    RE_WRONG_STATUS = 2, /* The reservation's status does not allow it, such as approving one that is not pending */
+    RE_INVALID = 3,      /* A date, time, phone number, name, username or table count was rejected; names and usernames
+                            are limited to 100 and 32 bytes and may not contain commas or control characters */
+    RE_NO_TABLES = 4,    /* Not enough tables are free at that time */
+    RE_TRUNCATED = 5,    /* An output buffer was too small */
+    RE_IO = 6,           /* A file could not be read or written */
+    RE_INTERNAL = 7      /* Anything else, such as running out of memory */
+} re_status;
+
+/* A reservation as passed to callbacks; dates are MM-DD-YYYY and times HH:MM (24-hour) */
+typedef struct re_reservation
+{
+    const char *id;
+    const char *username;
+    const char *name;
+    const char *phone;
+    const char *date;
+    const char *start_time;
+    const char *end_time;
+    const char *status; /* Pending, Approved, Settled or Rejected */
+    int tables;
+} re_reservation;
+
+/* A customer's totals over every reservation on record, archived ones included */
+typedef struct re_customer_history
+{
+    size_t bookings; /* Cancelled reservations are not counted */
+    size_t settled;
+    size_t rejected;
+    long long tables_consumed; /* Tables of the settled reservations */
+    int last_visit;            /* YYYYMMDD of the latest settled reservation, 0 if none */
+} re_customer_history;
+
+/* Called once per reservation; return nonzero to stop early */
+typedef int (*re_visit)(const re_reservation *reservation, void *context);
+
+int re_api_version(void);
+const char *re_status_message(re_status status);
+
+/* Opens a book from a reservations file, or an empty one if reservations_file is NULL; returns NULL if the file cannot be read */
+re_book *re_open(const char *reservations_file);
+void re_close(re_book *book);
+re_status re_save(re_book *book, const char *reservations_file);
+
+re_status re_available_tables(re_book *book, const char *date, const char *start_time, int *tables);
+/* Adds a pending two-hour reservation and copies its ID into id */
+re_status re_add(re_book *book, const char *username, const char *name, const char *phone, int tables, const char *date,
+                 const char *start_time, char *id, size_t id_size);
+re_status re_update(re_book *book, const char *id, const char *username, const char *date, const char *start_time, int tables);
+re_status re_approve(re_book *book, const char *id);
+re_status re_reject(re_book *book, const char *id);
+re_status re_cancel(re_book *book, const char *id);
+/* Like re_add and re_cancel, but a request_key already used within its time to live (10 minutes unless changed) gets the
+   first call's answer again instead of booking or cancelling twice, so clients can retry safely. NULL or "" is no key. */
+re_status re_add_keyed(re_book *book, const char *request_key, const char *username, const char *name, const char *phone, int tables,
+                       const char *date, const char *start_time, char *id, size_t id_size);
+re_status re_cancel_keyed(re_book *book, const char *request_key, const char *id);
+/* Sets how many request keys a book remembers (the oldest are dropped first) and for how many seconds */
+void re_set_request_key_limits(re_book *book, size_t max_keys, int ttl_seconds);
+/* Marks an approved reservation as settled, once its payment has gone through elsewhere */
+re_status re_settle(re_book *book, const char *id, const char *payment_type);
+
+re_status re_get(re_book *book, const char *id, re_visit visit, void *context);
+/* Visits the reservations of a user and/or with a status (NULL matches any); returns how many were visited, 0 if visit is NULL */
+size_t re_list(re_book *book, const char *username, const char *status, re_visit visit, void *context);
+/* Copies the totals of a user into history; a user without reservations gets all zeros */
+re_status re_history(re_book *book, const char *username, re_customer_history *history);
+/* Visits up to limit reservations whose guest name approximately matches query or whose phone number contains it, best
+   first; returns how many were visited, 0 if visit is NULL */
+size_t re_search(re_book *book, const char *query, size_t limit, re_visit visit, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESERVE_EAT_C_H */
@@ -0,0 +1,3014 @@
+// Author: Zurinee Irish M. Belo, Katherine Anne S. Liwanag, Jane Allyson L. Paray, and Jhenelle K.Alonzo
+
+// Reserve Eat core: definitions of what reserve-eat-core.h declares
+
+#include "reserve-eat-core.h"
+using namespace std; // Standard namespace
+
+namespace reserve_eat
+{
+
+// Function to convert a string to uppercase
+string toUpperCase(string str)
+{
+    transform(str.begin(), str.end(), str.begin(), ::toupper);
+    return str;
+}
+
+// Function to convert a string to lowercase
+string toLowerCase(const string &str)
+{
+    string result = str;
+    transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+}
+
+// Function to check if a string contains only digits
+bool isAllDigits(const string &str)
+{
+    for (char c : str)
+    {
+        if (!isdigit(c))
+            return false;
+    }
+    return true;
+}
+
+// Function to convert a time into local calendar time without sharing localtime's static buffer between threads
+tm localTime(time_t t)
+{
+    tm result{};
+#ifdef _WIN32
+    localtime_s(&result, &t);
+#else
+    localtime_r(&t, &result);
+#endif
+    return result;
+}
+
+// Local calendar time of now(), converted at most once per second on each thread
+tm Clock::local() const
+{
+    thread_local time_t convertedAt = -1;
+    thread_local tm converted{};
+    time_t t = now();
+    if (t != convertedAt)
+    {
+        converted = localTime(t);
+        convertedAt = t;
+    }
+    return converted;
+}
+
+static atomic<Clock *> installedClock{nullptr}; // Set by setEngineClock; nullptr means the system clock
+
+// Function to get the clock the engine runs on, the system clock unless another was set
+Clock &engineClock()
+{
+    static SystemClock systemClock;
+    Clock *clock = installedClock.load(memory_order_acquire);
+    return clock ? *clock : systemClock;
+}
+
+// Function to run the engine on another clock, or on the system clock again with nullptr
+void setEngineClock(Clock *clock)
+{
+    installedClock.store(clock, memory_order_release);
+}
+
+// Function to format the engine clock's time like ctime, without the newline
+string clockTimestamp()
+{
+    tm now = engineClock().local();
+    char text[32];
+    strftime(text, sizeof(text), "%a %b %e %H:%M:%S %Y", &now);
+    return text;
+}
+
+static ostream *installedOutput = nullptr;            // Set by setEngineOutput
+static function<void(const string &)> installedLog; // Set by setEngineLog
+
+// Function to send the engine's listings (the display methods) to a stream, or nowhere again with nullptr, the default
+void setEngineOutput(ostream *output)
+{
+    installedOutput = output;
+}
+
+// Function to get the stream the engine's listings go to
+ostream &engineOutput()
+{
+    static ostream nowhere(nullptr); // Has no buffer, so everything written to it is dropped
+    return installedOutput ? *installedOutput : nowhere;
+}
+
+// Function to receive the problems the engine reports, or drop them again with an empty sink, the default
+void setEngineLog(function<void(const string &)> sink)
+{
+    installedLog = move(sink);
+}
+
+// Function to report a problem to the engine's log sink
+void engineLog(const string &message)
+{
+    if (installedLog)
+        installedLog(message);
+}
+
+// Function to check if a date is valid
+bool isValidDate(const string &date)
+{
+    if (date.length() != 10 || date[2] != '-' || date[5] != '-')
+        return false;
+
+    string mm = date.substr(0, 2);
+    string dd = date.substr(3, 2);
+    string yyyy = date.substr(6, 4);
+
+    if (!isAllDigits(mm) || !isAllDigits(dd) || !isAllDigits(yyyy))
+        return false;
+
+    int month = stoi(mm);
+    int day = stoi(dd);
+    int year = stoi(yyyy);
+
+    // Get current year
+    int currentYear = engineClock().local().tm_year + 1900;
+
+    // Disallow years before the current year
+    if (year < currentYear)
+        return false;
+
+    if (month < 1 || month > 12)
+        return false;
+
+    if (day < 1 || day > 31)
+        return false;
+
+    int daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+        daysInMonth[1] = 29;
+
+    if (day > daysInMonth[month - 1])
+        return false;
+
+    return true;
+}
+
+// Function to check if a time is valid
+bool isValidTime24(const string &time)
+{
+    if (time.length() != 5 || time[2] != ':')
+        return false;
+
+    string hh = time.substr(0, 2);
+    string mm = time.substr(3, 2);
+
+    int hour, minute;
+    try
+    {
+        hour = stoi(hh);
+        minute = stoi(mm);
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    if (hour < 0 || hour > 23)
+        return false;
+    if (minute < 0 || minute > 59)
+        return false;
+
+    return true;
+}
+
+// Function to check if a contact number follows 09XXXXXXXXX
+bool isValidPhoneNo(const string &phoneNo)
+{
+    return phoneNo.length() == 11 && phoneNo[0] == '0' && phoneNo[1] == '9' &&
+           all_of(phoneNo.begin(), phoneNo.end(), [](char c)
+                  { return c >= '0' && c <= '9'; });
+}
+
+// Function to check that a field can be written to a comma-separated line as is: no commas, line breaks or other control characters
+bool isPlainField(const string &field)
+{
+    return none_of(field.begin(), field.end(), [](char c)
+                   { return c == ',' || (unsigned char)c < 0x20 || c == 0x7F; });
+}
+
+// Function to check a guest name: not empty, at most MAX_NAME_LENGTH characters, and a plain field
+bool isValidName(const string &name)
+{
+    return !name.empty() && name.length() <= MAX_NAME_LENGTH && isPlainField(name);
+}
+
+// Function to check a username: not empty, at most MAX_USERNAME_LENGTH characters, and a plain field
+bool isValidUsername(const string &username)
+{
+    return !username.empty() && username.length() <= MAX_USERNAME_LENGTH && isPlainField(username);
+}
+
+// Function to add two hours to a 24-hour format time
+string addTwoHours24(const string &startTime)
+{
+    int hour = stoi(startTime.substr(0, 2));
+    int minute = stoi(startTime.substr(3, 2));
+
+    hour += 2;
+    if (hour >= 24)
+    {
+        hour -= 24; // Wrap around to the next day if needed
+    }
+
+    // Format back to HH:MM
+    stringstream ss;
+    ss << setw(2) << setfill('0') << hour << ":"
+       << setw(2) << setfill('0') << minute;
+    return ss.str();
+}
+
+// Function to convert a MM-DD-YYYY date into a sortable YYYYMMDD number (-1 if the date is malformed)
+int dateKey(string_view date)
+{
+    if (date.length() != 10 || date[2] != '-' || date[5] != '-')
+        return -1;
+    int key = 0;
+    for (int i : {6, 7, 8, 9, 0, 1, 3, 4})
+    {
+        if (!isdigit((unsigned char)date[i]))
+            return -1;
+        key = key * 10 + (date[i] - '0');
+    }
+    return key;
+}
+
+// Function to convert a YYYYMMDD number back into a MM-DD-YYYY date
+string dateFromKey(int key)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%02d-%02d-%04d", (key / 100) % 100, key % 100, key / 10000);
+    return buffer;
+}
+
+// Function to convert a HH:MM time into minutes since midnight (-1 if the time is malformed)
+int minutesOfDay(const string &time)
+{
+    if (time.length() != 5 || time[2] != ':' || !isdigit((unsigned char)time[0]) || !isdigit((unsigned char)time[1]) ||
+        !isdigit((unsigned char)time[3]) || !isdigit((unsigned char)time[4]))
+        return -1;
+    return ((time[0] - '0') * 10 + (time[1] - '0')) * 60 + (time[3] - '0') * 10 + (time[4] - '0');
+}
+
+// Function to get the index of a status in STATUS (-1 if unknown)
+int statusCode(const string &status)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (STATUS[i] == status)
+            return i;
+    }
+    return -1;
+}
+
+// Function to convert a YYYYMMDD number into a count of days since 01-01-1970, so dates can be subtracted
+int dayNumber(int key)
+{
+    int year = key / 10000, month = (key / 100) % 100, day = key % 100;
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Function to convert a day count from dayNumber back into a YYYYMMDD number
+int keyFromDayNumber(int days)
+{
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int dayOfEra = days - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int mp = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    int month = mp + (mp < 10 ? 3 : -9);
+    int year = yearOfEra + era * 400 + (month <= 2);
+    return year * 10000 + month * 100 + day;
+}
+
+// Function to check that a YYYYMMDD number is a real calendar date (any year from 0001), such as no 02-30
+bool isCalendarDate(int key)
+{
+    return key >= 10101 && key <= 99991231 && keyFromDayNumber(dayNumber(key)) == key;
+}
+
+// Function to get today's date as a YYYYMMDD number
+int todayKey()
+{
+    tm now = engineClock().local();
+    return (now.tm_year + 1900) * 10000 + (now.tm_mon + 1) * 100 + now.tm_mday;
+}
+
+// Function to get the local time as minutes since 01-01-1970 00:00, the unit reservations are scheduled in
+long long currentMinute()
+{
+    tm now = engineClock().local();
+    return (long long)dayNumber((now.tm_year + 1900) * 10000 + (now.tm_mon + 1) * 100 + now.tm_mday) * 1440 + now.tm_hour * 60 + now.tm_min;
+}
+
+// Function to get the one string pool of the program
+static StringPool &stringPool()
+{
+    static StringPool pool;
+    return pool;
+}
+
+// Function to get the pooled copy of a string shared by every reservation. Values that repeat a lot (statuses, times,
+// dates, regular guests) are usually found in a small cache of each thread's recent strings, without locking the pool.
+const string *pooled(string_view text)
+{
+    struct Recent
+    {
+        size_t hash;
+        const string *value;
+    };
+    thread_local Recent recent[1024] = {};
+    size_t textHash = hash<string_view>()(text);
+    Recent &slot = recent[textHash % 1024];
+    if (slot.value && slot.hash == textHash && *slot.value == text)
+        return slot.value;
+    slot = {textHash, stringPool().intern(text, textHash)};
+    return slot.value;
+}
+
+// Function to count the distinct strings pooled so far
+size_t pooledCount()
+{
+    return stringPool().size();
+}
+
+#ifdef RESERVE_EAT_MEMPROFILE
+#ifdef RESERVE_EAT_BENCH
+#error "RESERVE_EAT_MEMPROFILE and RESERVE_EAT_BENCH both replace operator new; build with one of them"
+#endif
+
+// Heap use per subsystem; every block carries its size and subsystem in a header in front of it, so frees are charged
+// back to whoever allocated it, on any thread
+struct MemoryCounters
+{
+    atomic<size_t> liveBytes{0}, liveAllocations{0}, peakBytes{0}, allocations{0};
+};
+static MemoryCounters memoryCounters[MEMORY_TAGS];
+static thread_local MemoryTag memoryTag = MemoryTag::Other;
+constexpr size_t MEMORY_HEADER = alignof(max_align_t); // Keeps the block behind the header aligned like malloc's
+
+MemoryScope::MemoryScope(MemoryTag tag) : previous(memoryTag)
+{
+    memoryTag = tag;
+}
+
+MemoryScope::~MemoryScope()
+{
+    memoryTag = previous;
+}
+
+} // namespace reserve_eat
+
+// The replacement allocation functions have to be global
+void *operator new(size_t size)
+{
+    char *block = (char *)malloc(size + reserve_eat::MEMORY_HEADER);
+    if (!block)
+        throw bad_alloc();
+    reserve_eat::MemoryTag tag = reserve_eat::memoryTag;
+    memcpy(block, &size, sizeof(size));
+    memcpy(block + sizeof(size), &tag, sizeof(tag));
+
+    reserve_eat::MemoryCounters &counters = reserve_eat::memoryCounters[(int)tag];
+    counters.allocations.fetch_add(1, memory_order_relaxed);
+    counters.liveAllocations.fetch_add(1, memory_order_relaxed);
+    size_t live = counters.liveBytes.fetch_add(size, memory_order_relaxed) + size;
+    size_t peak = counters.peakBytes.load(memory_order_relaxed);
+    while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed))
+    {
+    }
+    return block + reserve_eat::MEMORY_HEADER;
+}
+
+// Kept out of line so GCC does not pair inlined new-expressions with free() and warn
+[[gnu::noinline]] void operator delete(void *memory) noexcept
+{
+    if (!memory)
+        return;
+    char *block = (char *)memory - reserve_eat::MEMORY_HEADER;
+    size_t size;
+    reserve_eat::MemoryTag tag;
+    memcpy(&size, block, sizeof(size));
+    memcpy(&tag, block + sizeof(size), sizeof(tag));
+    reserve_eat::memoryCounters[(int)tag].liveAllocations.fetch_sub(1, memory_order_relaxed);
+    reserve_eat::memoryCounters[(int)tag].liveBytes.fetch_sub(size, memory_order_relaxed);
+    free(block);
+}
+
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept { operator delete(memory); }
+
+namespace reserve_eat
+{
+// Function to get the heap use charged to a subsystem so far
+MemoryUsage memoryUsage(MemoryTag tag)
+{
+    const MemoryCounters &counters = memoryCounters[(int)tag];
+    return {counters.liveBytes.load(), counters.liveAllocations.load(), counters.peakBytes.load(), counters.allocations.load()};
+}
+#else
+// Function to get the heap use charged to a subsystem so far; allocations are only counted with RESERVE_EAT_MEMPROFILE
+MemoryUsage memoryUsage(MemoryTag)
+{
+    return {};
+}
+#endif
+
+// Function to get the name of a subsystem as shown in reports
+const char *memoryTagName(MemoryTag tag)
+{
+    static const char *names[MEMORY_TAGS] = {"other", "reservations", "users", "logging", "payments"};
+    return names[(int)tag];
+}
+
+// Function to format a reservation as a line of reservations.txt (without the newline)
+string formatReservationLine(const Reservation &res)
+{
+    return res.getID() + ',' + res.getUsername() + ',' + res.getName() + ',' + res.getPhoneNo() + ',' +
+           to_string(res.getTablesReserved()) + ',' + res.getDate() + ',' + res.getStartTime() + ',' +
+           res.getEndTime() + ',' + res.getStatus();
+}
+
+// Function to parse a line of reservations.txt, returns false if the line is incomplete
+bool parseReservationLine(string_view line, Reservation &res)
+{
+    string_view fields[9];
+    int tables = 0;
+    if (splitFields(line, fields, 9) < 9 ||
+        from_chars(fields[4].data(), fields[4].data() + fields[4].size(), tables).ec != errc())
+        return false;
+    string_view status = line.substr(fields[8].data() - line.data()); // The status runs to the end of the line
+    res = Reservation(fields[0], fields[1], fields[2], fields[3], tables, fields[5], fields[6], fields[7], status);
+    return true;
+}
+
+// Function to append a number using 7 bits per byte (the high bit marks that more bytes follow)
+void appendVarint(string &out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+// Function to read a number written by appendVarint, throws if the data ends early
+size_t readVarint(const string &in, size_t &pos)
+{
+    size_t value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7)
+    {
+        unsigned char byte = (unsigned char)in[pos++];
+        value |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw runtime_error("Corrupted archive block.");
+}
+
+// Function to compress text with a small LZ77 coder: [literal count][literals][match length - 3][2-byte offset]...
+string lzCompress(const string &in)
+{
+    const size_t MIN_MATCH = 4, HASH_BITS = 14;
+    vector<int64_t> lastSeen(1u << HASH_BITS, -1);
+    string out;
+    out.reserve(in.size() / 2 + 16);
+
+    size_t anchor = 0, i = 0;
+    while (i + MIN_MATCH <= in.size())
+    {
+        uint32_t word;
+        memcpy(&word, in.data() + i, 4);
+        uint32_t hash = (word * 2654435761u) >> (32 - HASH_BITS);
+        int64_t candidate = lastSeen[hash];
+        lastSeen[hash] = (int64_t)i;
+
+        if (candidate < 0 || i - (size_t)candidate > 0xFFFF || memcmp(in.data() + candidate, in.data() + i, MIN_MATCH) != 0)
+        {
+            i++;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (i + length < in.size() && in[candidate + length] == in[i + length])
+            length++;
+
+        size_t offset = i - (size_t)candidate;
+        appendVarint(out, i - anchor);
+        out.append(in, anchor, i - anchor);
+        appendVarint(out, length - 3);
+        out += (char)(offset & 0xFF);
+        out += (char)(offset >> 8);
+
+        i += length;
+        anchor = i;
+    }
+
+    appendVarint(out, in.size() - anchor);
+    out.append(in, anchor, string::npos);
+    appendVarint(out, 0); // No match: end of block
+    return out;
+}
+
+// Function to restore text compressed by lzCompress
+string lzDecompress(const string &in, size_t rawSize)
+{
+    string out;
+    out.reserve(rawSize);
+    size_t pos = 0;
+    while (true)
+    {
+        size_t literals = readVarint(in, pos);
+        if (literals > in.size() - pos)
+            throw runtime_error("Corrupted archive block.");
+        out.append(in, pos, literals);
+        pos += literals;
+
+        size_t length = readVarint(in, pos);
+        if (length == 0)
+            break;
+        length += 3;
+        if (pos + 2 > in.size())
+            throw runtime_error("Corrupted archive block.");
+        size_t offset = (unsigned char)in[pos] | ((size_t)(unsigned char)in[pos + 1] << 8);
+        pos += 2;
+        if (offset == 0 || offset > out.size())
+            throw runtime_error("Corrupted archive block.");
+
+        size_t from = out.size() - offset;
+        for (size_t k = 0; k < length; k++) // Byte by byte because a match may overlap its own output
+            out += out[from + k];
+    }
+    if (out.size() != rawSize)
+        throw runtime_error("Corrupted archive block.");
+    return out;
+}
+
+// Function to split text into about parts pieces that each end at a newline, as [begin, end) offsets
+vector<pair<size_t, size_t>> splitIntoLineChunks(const string &data, size_t parts)
+{
+    vector<pair<size_t, size_t>> chunks;
+    size_t begin = 0, step = max<size_t>(1, data.size() / max<size_t>(1, parts));
+    while (begin < data.size())
+    {
+        size_t end = min(data.size(), begin + step);
+        size_t newline = data.find('\n', end == 0 ? 0 : end - 1);
+        end = newline == string::npos ? data.size() : newline + 1;
+        chunks.emplace_back(begin, end);
+        begin = end;
+    }
+    return chunks;
+}
+
+// Function to read a whole file into data in one go, returns false if it cannot be read
+bool readFile(const string &filename, string &data)
+{
+    ifstream file(filename, ios::binary | ios::ate);
+    if (!file)
+        return false;
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    return data.empty() || (bool)file.read(&data[0], data.size());
+}
+
+// Function to split data into newline-aligned chunks for parsing on several threads, none smaller than 64 KB
+vector<pair<size_t, size_t>> splitForThreads(const string &data)
+{
+    size_t threads = max(1u, thread::hardware_concurrency());
+    return splitIntoLineChunks(data, min(threads, max<size_t>(1, data.size() / (64 * 1024))));
+}
+
+// Function to run work(0) to work(count - 1) at once, the first on the caller's thread
+void runOnThreads(size_t count, const function<void(size_t)> &work)
+{
+    vector<thread> workers;
+    for (size_t i = 1; i < count; i++)
+        workers.emplace_back(work, i);
+    if (count > 0)
+        work(0);
+    for (auto &worker : workers)
+        worker.join();
+}
+
+// Function to split a line into comma-separated fields, returns how many fields it has (only maxFields are stored)
+size_t splitFields(string_view line, string_view *fields, size_t maxFields)
+{
+    size_t count = 0, start = 0;
+    while (true)
+    {
+        size_t comma = line.find(',', start);
+        if (count < maxFields)
+            fields[count] = line.substr(start, comma == string_view::npos ? string_view::npos : comma - start);
+        count++;
+        if (comma == string_view::npos)
+            return count;
+        start = comma + 1;
+    }
+}
+
+// Function to parse and validate one import line in the reservations.txt schema; the ID is assigned later
+ImportRow parseImportLine(string_view line, size_t lineNo)
+{
+    ImportRow row;
+    row.line = lineNo;
+    string_view fields[9];
+    if (splitFields(line, fields, 9) != 9)
+    {
+        row.error = "Expected 9 fields: id,username,name,phone,tables,date,start,end,status";
+        return row;
+    }
+
+    string username = toUpperCase(string(fields[1])), name(fields[2]), phoneNo(fields[3]);
+    string date(fields[5]), startTime(fields[6]), endTime(fields[7]), status(fields[8]);
+    int tables = 0;
+    auto parsed = from_chars(fields[4].data(), fields[4].data() + fields[4].size(), tables);
+
+    if (!isValidUsername(username))
+        row.error = "Username must be 1 to " + to_string(MAX_USERNAME_LENGTH) + " characters, without commas";
+    else if (!isValidName(name))
+        row.error = "Name must be 1 to " + to_string(MAX_NAME_LENGTH) + " characters, without commas";
+    else if (!isValidPhoneNo(phoneNo))
+        row.error = "Invalid contact number";
+    else if (parsed.ec != errc() || parsed.ptr != fields[4].data() + fields[4].size() || tables < 1 || tables > TOTAL_TABLES)
+        row.error = "Tables must be a number from 1 to " + to_string(TOTAL_TABLES);
+    else if (!isValidDate(date))
+        row.error = "Invalid date (MM-DD-YYYY, current year or later)";
+    else if (!isValidTime24(startTime))
+        row.error = "Invalid start time (HH:MM)";
+    else if (!endTime.empty() && !isValidTime24(endTime))
+        row.error = "Invalid end time (HH:MM)";
+    else if (!status.empty() && statusCode(status) < 0)
+        row.error = "Invalid status";
+
+    if (row.error.empty())
+    {
+        if (endTime.empty())
+            endTime = addTwoHours24(startTime);
+        row.res = Reservation("", username, name, phoneNo, tables, date, startTime, endTime, status.empty() ? STATUS[0] : status);
+    }
+    return row;
+}
+
+// Function to parse an import file on several threads, one newline-aligned chunk per thread
+vector<ImportRow> parseImportData(const string &data)
+{
+    vector<pair<size_t, size_t>> chunks = splitForThreads(data);
+    vector<vector<ImportRow>> parsed(chunks.size());
+    vector<size_t> lineCounts(chunks.size(), 0);
+    runOnThreads(chunks.size(), [&](size_t c)
+                 {
+                     MemoryScope memory(MemoryTag::Reservations); // Each parsing thread charges its own rows
+                     size_t localLine = 0;
+                     forEachLine(data, chunks[c].first, chunks[c].second, [&](string_view line, size_t)
+                                 {
+                                     localLine++;
+                                     if (!line.empty())
+                                         parsed[c].push_back(parseImportLine(line, localLine)); });
+                     lineCounts[c] = localLine; });
+
+    // Turn chunk-local line numbers into file line numbers while merging
+    vector<ImportRow> rows;
+    size_t total = 0, firstLine = 0;
+    for (const auto &chunk : parsed)
+        total += chunk.size();
+    rows.reserve(total);
+    for (size_t c = 0; c < parsed.size(); c++)
+    {
+        for (auto &row : parsed[c])
+        {
+            row.line += firstLine;
+            rows.push_back(move(row));
+        }
+        firstLine += lineCounts[c];
+    }
+
+    // A header line in the reservations.txt schema is skipped
+    if (!rows.empty() && rows[0].line == 1 && toLowerCase(data.substr(0, data.find(','))) == "id")
+        rows.erase(rows.begin());
+    return rows;
+}
+
+// Function to get the name of a weekday (0 = Sunday)
+string weekdayName(int weekday)
+{
+    const char *names[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+    return names[weekday];
+}
+
+// Function to format minutes since midnight as HH:MM
+string timeFromMinutes(int minutes)
+{
+    char text[8];
+    snprintf(text, sizeof(text), "%02d:%02d", minutes / 60 % 24, minutes % 60);
+    return text;
+}
+
+// Function to format a standing rule as a line of standing.txt: id,username,name,phone,tables,from,to,start,status,exception;exception...
+string formatStandingRule(const StandingRule &rule)
+{
+    string line = to_string(rule.id) + ',' + rule.username + ',' + rule.name + ',' + rule.phoneNo + ',' + to_string(rule.tables) + ',' +
+                  dateFromKey(rule.fromDate) + ',' + dateFromKey(rule.toDate) + ',' + timeFromMinutes(rule.startMinute) + ',' + rule.status + ',';
+    for (int date : rule.exceptions)
+        line += (date == *rule.exceptions.begin() ? "" : ";") + dateFromKey(date);
+    return line;
+}
+
+// Function to parse a line of standing.txt, returns false if the line is incomplete or invalid
+bool parseStandingRule(const string &line, StandingRule &rule)
+{
+    string_view fields[10];
+    if (splitFields(line, fields, 10) < 9)
+        return false;
+    rule = StandingRule();
+    from_chars(fields[0].data(), fields[0].data() + fields[0].size(), rule.id);
+    rule.username = string(fields[1]);
+    rule.name = string(fields[2]);
+    rule.phoneNo = string(fields[3]);
+    from_chars(fields[4].data(), fields[4].data() + fields[4].size(), rule.tables);
+    rule.fromDate = dateKey(string(fields[5]));
+    rule.toDate = dateKey(string(fields[6]));
+    rule.startMinute = minutesOfDay(string(fields[7]));
+    rule.status = string(fields[8]);
+    if (rule.id == 0 || rule.fromDate < 0 || rule.toDate < 0 || rule.startMinute < 0 || statusCode(rule.status) < 0)
+        return false;
+    for (size_t start = 0; start < fields[9].size();)
+    {
+        size_t end = min(fields[9].find(';', start), fields[9].size());
+        int date = dateKey(string(fields[9].substr(start, end - start)));
+        if (date >= 0)
+            rule.exceptions.insert(date);
+        start = end + 1;
+    }
+    return true;
+}
+
+// Publishes the empty book so snapshots always have a version to pin
+ReservationSystem::ReservationSystem()
+{
+    commit(0, ALL_ROWS);
+}
+
+// Frees the latest version; retired versions are freed by the epoch manager
+ReservationSystem::~ReservationSystem()
+{
+    stopTimers();
+    const ReservationVersion *last = current.load();
+    for (const auto *chunk : last->chunks)
+        delete chunk;
+    delete last;
+}
+
+// Schedules the timers of a reservation from its current date, times and status, replacing any it had (caller holds writeMutex)
+void ReservationSystem::armTimers(uint32_t slot)
+{
+    if (timersOfSlot.size() <= slot)
+        timersOfSlot.resize(generations.size());
+    disarmTimers(slot);
+
+    const Reservation &res = reservations[positionOfSlot[slot]];
+    int status = statusCode(res.getStatus()), key = dateKey(res.getDate());
+    int startMinute = minutesOfDay(res.getStartTime()), endMinute = minutesOfDay(res.getEndTime());
+    if ((status != 0 && status != 1) || key < 0 || startMinute < 0 || endMinute < 0)
+        return; // Settled and rejected bookings have nothing left to happen
+
+    long long start = (long long)dayNumber(key) * 1440 + startMinute;
+    long long end = start + (endMinute - startMinute + 1440) % 1440;
+    lock_guard<mutex> lock(timersMutex);
+    long long now = timers.minute();
+    auto &armed = timersOfSlot[slot];
+    if (status == 0)
+        armed[(int)TimerKind::Expire] = timers.schedule(start, {slot, generations[slot], TimerKind::Expire}); // Fires at once if already past
+    if (start - reminderLead > now)
+        armed[(int)TimerKind::Reminder] = timers.schedule(start - reminderLead, {slot, generations[slot], TimerKind::Reminder});
+    if (end > now)
+        armed[(int)TimerKind::NoShow] = timers.schedule(end, {slot, generations[slot], TimerKind::NoShow});
+    if (start <= now && status == 0)
+        timersWake.notify_one();
+}
+
+// Cancels the timers of a reservation (caller holds writeMutex)
+void ReservationSystem::disarmTimers(uint32_t slot)
+{
+    if (slot >= timersOfSlot.size())
+        return;
+    lock_guard<mutex> lock(timersMutex);
+    for (auto &id : timersOfSlot[slot])
+    {
+        timers.cancel(id);
+        id = TimerId();
+    }
+}
+
+// Advances the wheel to the current minute and acts on the events that came due; the timer thread calls it every minute,
+// a simulation each time it moves the clock
+void ReservationSystem::fireTimers()
+{
+    vector<TimerEvent> due;
+    {
+        lock_guard<mutex> lock(timersMutex);
+        timers.advance(currentMinute(), due);
+    }
+    if (due.empty())
+        return;
+
+    lock_guard<mutex> lock(writeMutex);
+    size_t from = ALL_ROWS, to = 0;
+    for (const auto &event : due)
+    {
+        if (event.slot >= generations.size() || generations[event.slot] != event.generation)
+            continue; // The reservation is gone
+        timersOfSlot[event.slot][(int)event.kind] = TimerId();
+        size_t position = positionOfSlot[event.slot];
+        Reservation &res = reservations[position];
+        string when = res.getDate() + " " + res.getStartTime();
+
+        if (event.kind == TimerKind::Expire && res.getStatus() == STATUS[0])
+        {
+            changeStatus(position, STATUS[3]);
+            disarmTimers(event.slot);
+            persist(position);
+            from = min(from, position);
+            to = max(to, position + 1);
+            logToFile("Reservation ID " + res.getID() + " expired while pending and was rejected");
+            notify(res.getUsername(), "Reservation ID " + res.getID() + " on " + when + " was not approved in time and has expired.");
+        }
+        else if (event.kind == TimerKind::Reminder && res.getStatus() == STATUS[1])
+            notify(res.getUsername(), "Reminder: reservation ID " + res.getID() + " for " + to_string(res.getTablesReserved()) + " table(s) on " + when + ".");
+        else if (event.kind == TimerKind::NoShow && res.getStatus() == STATUS[1])
+        {
+            logToFile("No-show: reservation ID " + res.getID() + " of " + res.getUsername() + " on " + when + " ended without payment");
+            ofstream noShows("no_shows.txt", ios::app);
+            noShows << res.getID() << ',' << res.getUsername() << ',' << res.getDate() << ',' << res.getStartTime() << '\n';
+        }
+    }
+    if (from < to)
+        commit(from, to);
+}
+
+// Starts the thread that fires timers once a minute, or sooner when an overdue one is armed
+void ReservationSystem::startTimers(int reminderHours)
+{
+    lock_guard<mutex> lock(writeMutex);
+    if (reminderHours * 60 != reminderLead)
+    {
+        reminderLead = reminderHours * 60;
+        for (size_t position = 0; position < reservations.size(); position++)
+            armTimers(slotOfPosition[position]); // Reminders of already loaded bookings use the new lead
+    }
+    timersStopping = false;
+    timerThread = thread([this]()
+                         {
+                             unique_lock<mutex> lock(timersMutex);
+                             while (!timersStopping)
+                             {
+                                 lock.unlock();
+                                 fireTimers();
+                                 lock.lock();
+                                 auto nextMinute = chrono::system_clock::time_point(chrono::duration_cast<chrono::minutes>(chrono::system_clock::now().time_since_epoch()) + chrono::minutes(1));
+                                 timersWake.wait_until(lock, nextMinute);
+                             } });
+}
+
+// Stops the timer thread; timers stay armed
+void ReservationSystem::stopTimers()
+{
+    {
+        lock_guard<mutex> lock(timersMutex);
+        timersStopping = true;
+    }
+    timersWake.notify_all();
+    if (timerThread.joinable())
+        timerThread.join();
+}
+
+// Counts the armed timers
+size_t ReservationSystem::timerCount()
+{
+    lock_guard<mutex> lock(timersMutex);
+    return timers.size();
+}
+
+// Leaves a message for a user
+void ReservationSystem::notify(const string &username, const string &message)
+{
+    MemoryScope memory(MemoryTag::Logging);
+    lock_guard<mutex> lock(noticesMutex);
+    notices[username].push_back(message);
+}
+
+// Takes the messages left for a user
+vector<string> ReservationSystem::takeNotices(const string &username)
+{
+    lock_guard<mutex> lock(noticesMutex);
+    auto it = notices.find(username);
+    if (it == notices.end())
+        return {};
+    vector<string> messages = move(it->second);
+    notices.erase(it);
+    return messages;
+}
+
+// Pins the latest version of the book for reading
+ReservationSnapshot ReservationSystem::snapshot() const
+{
+    return ReservationSnapshot(epochs, current);
+}
+
+// Publishes a new version after a write (caller holds writeMutex); only the chunks covering positions [from, to) are copied
+void ReservationSystem::commit(size_t from, size_t to)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    version++;
+    const ReservationVersion *old = current.load();
+    auto *next = new ReservationVersion();
+    next->number = version;
+    next->size = reservations.size();
+    next->chunks.resize((reservations.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+    for (size_t k = 0; k < next->chunks.size(); k++)
+    {
+        size_t begin = k * CHUNK_SIZE, end = min(begin + CHUNK_SIZE, reservations.size());
+        bool changed = begin < to && end > from;
+        if (!changed && old && k < old->chunks.size() && old->chunks[k]->size() == end - begin)
+            next->chunks[k] = old->chunks[k];
+        else
+            next->chunks[k] = new vector<Reservation>(reservations.begin() + begin, reservations.begin() + end);
+    }
+
+    current.store(next);
+    if (store.isOpen())
+        store.flush(); // Every change reaches the disk before it is visible
+    if (old)
+    {
+        vector<const vector<Reservation> *> replaced;
+        for (size_t k = 0; k < old->chunks.size(); k++)
+        {
+            if (k >= next->chunks.size() || next->chunks[k] != old->chunks[k])
+                replaced.push_back(old->chunks[k]);
+        }
+        epochs.retire([old, replaced]()
+                      {
+                          for (const auto *chunk : replaced)
+                              delete chunk;
+                          delete old; });
+    }
+    epochs.reclaim();
+}
+
+// Appends a reservation and gives it a slot, reusing a freed one if there is any (caller holds writeMutex and commits)
+ReservationHandle ReservationSystem::place(const Reservation &res)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        positionOfSlot[slot] = (uint32_t)reservations.size();
+    }
+    else
+    {
+        slot = (uint32_t)generations.size();
+        generations.push_back(0);
+        positionOfSlot.push_back((uint32_t)reservations.size());
+    }
+    reservations.push_back(res);
+    slotOfPosition.push_back(slot);
+    slotByID[reservations.back().getID()] = slot;
+    armTimers(slot);
+    guests.add(slot, res);
+    return {slot, generations[slot]};
+}
+
+// Removes the reservation at a position in O(1) by moving the last one into its place (caller holds writeMutex and commits)
+void ReservationSystem::removeAt(size_t position)
+{
+    uint32_t slot = slotOfPosition[position];
+    auto it = slotByID.find(reservations[position].getID());
+    if (it != slotByID.end() && it->second == slot)
+        slotByID.erase(it);
+    disarmTimers(slot);
+    guests.remove(slot);
+    generations[slot]++;
+    freeSlots.push_back(slot);
+    if (store.isOpen())
+        store.remove(reservations[position].getID());
+    if (changeLog)
+        changeLog("DEL " + reservations[position].getID());
+
+    size_t last = reservations.size() - 1;
+    if (position != last)
+    {
+        reservations[position] = reservations[last];
+        slotOfPosition[position] = slotOfPosition[last];
+        positionOfSlot[slotOfPosition[position]] = (uint32_t)position;
+    }
+    reservations.pop_back();
+    slotOfPosition.pop_back();
+}
+
+// Forgets every slot; handles from before stop resolving (caller holds writeMutex)
+void ReservationSystem::clearSlots()
+{
+    reservations.clear();
+    slotOfPosition.clear();
+    slotByID.clear();
+    freeSlots.clear();
+    {
+        lock_guard<mutex> lock(timersMutex);
+        timers.clear();
+    }
+    timersOfSlot.assign(timersOfSlot.size(), {});
+    guests.clear();
+    for (uint32_t slot = 0; slot < generations.size(); slot++)
+    {
+        generations[slot]++;
+        freeSlots.push_back(slot);
+    }
+}
+
+// Finds the position of a reservation by ID, or ALL_ROWS (caller holds writeMutex)
+size_t ReservationSystem::positionOf(const string &id) const
+{
+    auto it = slotByID.find(id);
+    return it == slotByID.end() ? ALL_ROWS : positionOfSlot[it->second];
+}
+
+// Finds the position a handle points at, or ALL_ROWS if its reservation was removed (caller holds writeMutex)
+size_t ReservationSystem::positionOf(ReservationHandle handle) const
+{
+    if (handle.slot >= generations.size() || generations[handle.slot] != handle.generation)
+        return ALL_ROWS;
+    return positionOfSlot[handle.slot];
+}
+
+// Gets a handle that keeps finding a reservation while others are added and removed
+ReservationHandle ReservationSystem::findHandle(const string &id) const
+{
+    lock_guard<mutex> lock(writeMutex);
+    auto it = slotByID.find(id);
+    return it == slotByID.end() ? ReservationHandle() : ReservationHandle{it->second, generations[it->second]};
+}
+
+// Copies the reservation a handle points at, returns false if it was removed
+bool ReservationSystem::resolve(ReservationHandle handle, Reservation &res) const
+{
+    lock_guard<mutex> lock(writeMutex);
+    size_t position = positionOf(handle);
+    if (position == ALL_ROWS)
+        return false;
+    res = reservations[position];
+    return true;
+}
+
+// Writes the reservation at a position to the store, if one is open, and to the change log (caller holds writeMutex and commits)
+void ReservationSystem::persist(size_t position)
+{
+    if (store.isOpen())
+        store.put(reservations[position]);
+    if (changeLog)
+        changeLog("PUT " + formatReservationLine(reservations[position]));
+}
+
+// Opens the on-disk store; a new store is filled from the book in memory, an existing one replaces it
+bool ReservationSystem::openStore(const string &path)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    lock_guard<mutex> lock(writeMutex);
+    if (!store.open(path))
+        return false;
+
+    if (store.isEmpty())
+    {
+        // Reservations outside the load window are copied over too, then read back through the store's indexes
+        vector<Reservation> older;
+        ifstream file(bookFile, ios::binary);
+        string line;
+        for (const auto &entry : cold)
+        {
+            line.resize(entry.length);
+            file.seekg(entry.offset);
+            older.emplace_back();
+            if (!file.read(&line[0], entry.length) || !parseReservationLine(line, older.back()))
+                older.pop_back();
+        }
+        cold.clear();
+
+        vector<const Reservation *> batch;
+        for (const auto &res : reservations)
+            batch.push_back(&res);
+        for (const auto &res : older)
+            batch.push_back(&res);
+        store.putNew(batch);
+    }
+    else
+    {
+        clearSlots();
+        {
+            lock_guard<mutex> historyLock(historyMutex);
+            histories.clear();
+        }
+        store.scanDates(0, 99999999, [&](const Reservation &res)
+                        {
+                            recordHistory(res, 1);
+                            if (dateKey(res.getDate()) >= loadedFrom)
+                                place(res); });
+        recordArchivedHistory();
+    }
+    partial = loadedFrom > 0;
+    commit(0, ALL_ROWS);
+    return true;
+}
+
+// Sets how many days of history are loaded at startup; older reservations are read in when something needs them (-1 loads everything)
+void ReservationSystem::setLoadWindow(int days)
+{
+    lock_guard<mutex> lock(writeMutex);
+    loadedFrom = days < 0 ? 0 : keyFromDayNumber(dayNumber(todayKey()) - days);
+}
+
+// Loads the reservations dated within [fromDate, toDate] that are not loaded yet, only those of username if it is given,
+// and returns how many were loaded (caller holds writeMutex and commits)
+size_t ReservationSystem::faultIn(int fromDate, int toDate, const string &username)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    size_t loaded = 0;
+    auto load = [&](const Reservation &res)
+    {
+        int key = dateKey(res.getDate());
+        if (key >= fromDate && key <= toDate && (username.empty() || res.getUsername() == username) && positionOf(res.getID()) == ALL_ROWS)
+        {
+            place(res);
+            loaded++;
+        }
+    };
+
+    if (store.isOpen())
+    {
+        if (!username.empty())
+            store.scanUser(username, [&](const Reservation &res)
+                           {
+                               if (dateKey(res.getDate()) < loadedFrom)
+                                   load(res); });
+        else if (fromDate < loadedFrom)
+            store.scanDates(fromDate, min(toDate, loadedFrom - 1), load);
+        return loaded;
+    }
+
+    ifstream file(bookFile, ios::binary);
+    string line;
+    Reservation res;
+    size_t kept = 0;
+    for (const auto &entry : cold)
+    {
+        size_t before = loaded;
+        if (entry.date >= fromDate && entry.date <= toDate)
+        {
+            line.resize(entry.length);
+            file.seekg(entry.offset);
+            if (file.read(&line[0], entry.length) && parseReservationLine(line, res))
+                load(res);
+        }
+        if (loaded == before)
+            cold[kept++] = entry;
+    }
+    cold.resize(kept);
+    partial = !cold.empty();
+    return loaded;
+}
+
+// Finds a reservation by ID, loading it first if it is older than the load window (caller holds writeMutex)
+size_t ReservationSystem::locate(const string &id)
+{
+    size_t position = positionOf(id);
+    if (position != ALL_ROWS || !partial)
+        return position;
+
+    Reservation res;
+    if (store.isOpen())
+    {
+        if (!store.find(id, res))
+            return ALL_ROWS;
+    }
+    else
+    {
+        uint32_t number = 0;
+        auto parsed = from_chars(id.data(), id.data() + id.size(), number);
+        auto it = find_if(cold.begin(), cold.end(), [&](const ColdReservation &entry)
+                          { return entry.id == number; });
+        if (parsed.ec != errc() || parsed.ptr != id.data() + id.size() || it == cold.end())
+            return ALL_ROWS;
+
+        ifstream file(bookFile, ios::binary);
+        string line(it->length, '\0');
+        file.seekg(it->offset);
+        if (!file.read(&line[0], it->length) || !parseReservationLine(line, res))
+            return ALL_ROWS;
+        cold.erase(it);
+        partial = !cold.empty();
+    }
+
+    place(res);
+    commit(reservations.size() - 1, reservations.size());
+    return reservations.size() - 1;
+}
+
+// Makes sure every reservation dated within [fromDate, toDate] is loaded, returns how many had to be read in
+size_t ReservationSystem::loadDates(int fromDate, int toDate)
+{
+    lock_guard<mutex> lock(writeMutex);
+    if (!partial)
+        return 0;
+    size_t loaded = faultIn(fromDate, toDate, "");
+    if (store.isOpen() && fromDate < loadedFrom && toDate >= loadedFrom - 1)
+    {
+        loadedFrom = fromDate;
+        partial = loadedFrom > 0;
+    }
+    if (loaded > 0)
+        commit(reservations.size() - loaded, ALL_ROWS);
+    return loaded;
+}
+
+// Makes sure every reservation of a user is loaded, returns how many had to be read in
+size_t ReservationSystem::loadUser(const string &username)
+{
+    lock_guard<mutex> lock(writeMutex);
+    if (!partial || !loadedUsers.insert(username).second)
+        return 0;
+    size_t loaded = faultIn(0, 99999999, username);
+    if (loaded > 0)
+        commit(reservations.size() - loaded, ALL_ROWS);
+    return loaded;
+}
+
+// Rebuilds the weekday index of the standing rules (caller holds rulesMutex)
+void ReservationSystem::indexRules()
+{
+    for (auto &positions : rulesByWeekday)
+        positions.clear();
+    for (size_t i = 0; i < rules.size(); i++)
+        rulesByWeekday[rules[i].weekday()].push_back(i);
+}
+
+// Saves the standing rules at once, so a booking taken out of a rule is never counted twice after a crash, and sends them
+// to the change log as one RULES record; rules are few, so both simply rewrite them all (caller holds rulesMutex)
+void ReservationSystem::rulesChanged()
+{
+    if (!rulesFile.empty())
+        writeRules(rulesFile);
+    if (!changeLog)
+        return;
+    string record = "RULES " + to_string(rules.size());
+    for (const auto &rule : rules)
+        record += '\n' + formatStandingRule(rule);
+    changeLog(record);
+}
+
+// Writes the standing rules, one formatStandingRule line each (caller holds rulesMutex)
+void ReservationSystem::writeRules(const string &filename) const
+{
+    ofstream file(filename);
+    if (!file)
+    {
+        engineLog("Error opening standing reservation file for writing.");
+        return;
+    }
+    for (const auto &rule : rules)
+        file << formatStandingRule(rule) << '\n';
+}
+
+// Finds a standing rule of a user (any user if username is empty), or nullptr (caller holds rulesMutex)
+StandingRule *ReservationSystem::findRule(uint32_t id, const string &username)
+{
+    for (auto &rule : rules)
+    {
+        if (rule.id == id && (username.empty() || rule.username == username))
+            return &rule;
+    }
+    return nullptr;
+}
+
+// Reads the standing rules written by saveStandingRules
+void ReservationSystem::loadStandingRules(const string &filename)
+{
+    lock_guard<mutex> lock(rulesMutex);
+    rulesFile = filename; // Changes from now on are saved here, even if there is no file yet
+    ifstream file(filename);
+    if (!file)
+        return;
+
+    rules.clear();
+    string line;
+    StandingRule rule;
+    while (getline(file, line))
+    {
+        if (!parseStandingRule(line, rule))
+            continue;
+        nextRuleID = max(nextRuleID, rule.id + 1);
+        rules.push_back(move(rule));
+    }
+    indexRules();
+}
+
+// Writes the standing rules, one formatStandingRule line each
+void ReservationSystem::saveStandingRules(const string &filename) const
+{
+    lock_guard<mutex> lock(rulesMutex);
+    writeRules(filename);
+}
+
+// Visits each occurrence of the standing rules dated within [fromDate, toDate] as a reservation with the rule's ID (S<id>);
+// short ranges only look at the rules of the weekdays they cover
+void ReservationSystem::forEachOccurrence(int fromDate, int toDate, const function<void(const Reservation &)> &visit) const
+{
+    lock_guard<mutex> lock(rulesMutex);
+    auto occurrence = [&](const StandingRule &rule, int date)
+    {
+        int start = rule.startMinute;
+        visit(Reservation("S" + to_string(rule.id), rule.username, rule.name, rule.phoneNo, rule.tables, dateFromKey(date),
+                          timeFromMinutes(start), timeFromMinutes(start + 120), rule.status));
+    };
+
+    int firstDay = dayNumber(max(fromDate, 19700101)), lastDay = dayNumber(min(toDate, 99991231));
+    if (lastDay - firstDay < 7)
+    {
+        for (int day = firstDay; day <= lastDay; day++)
+        {
+            int date = keyFromDayNumber(day);
+            for (size_t position : rulesByWeekday[(day + 4) % 7])
+            {
+                if (rules[position].status != STATUS[3] && rules[position].occursOn(date))
+                    occurrence(rules[position], date);
+            }
+        }
+        return;
+    }
+
+    for (const auto &rule : rules)
+    {
+        if (rule.status == STATUS[3])
+            continue;
+        int ruleFirst = dayNumber(rule.fromDate), ruleLast = min(lastDay, dayNumber(rule.toDate));
+        int day = ruleFirst + max(0, (firstDay - ruleFirst + 6) / 7 * 7); // First occurrence on or after fromDate
+        for (; day <= ruleLast; day += 7)
+        {
+            int date = keyFromDayNumber(day);
+            if (!rule.exceptions.count(date))
+                occurrence(rule, date);
+        }
+    }
+}
+
+// Adds a pending standing rule if every occurrence has enough tables; returns an error, or an empty string on success
+string ReservationSystem::addStandingRule(const StandingRule &rule)
+{
+    int firstDay = dayNumber(rule.fromDate), lastDay = dayNumber(rule.toDate);
+    if (lastDay < firstDay || (lastDay - firstDay) / 7 >= StandingRule::MAX_WEEKS)
+        return "A standing reservation runs for 1 to " + to_string(StandingRule::MAX_WEEKS) + " weeks.";
+    string startTime = timeFromMinutes(rule.startMinute), endTime = addTwoHours24(startTime);
+    loadDates(keyFromDayNumber(firstDay - 1), keyFromDayNumber(lastDay + 1));
+
+    // The tables are counted under the booking lock and the rule is added before it is released, so no booking or
+    // other rule can take them in between
+    lock_guard<mutex> lock(writeMutex);
+    for (int day = firstDay; day <= lastDay; day += 7)
+    {
+        string date = dateFromKey(keyFromDayNumber(day));
+        int available = getAvailableTables(date, startTime, endTime);
+        if (available < rule.tables)
+            return "Only " + to_string(max(0, available)) + " table(s) are available on " + date + " at " + startTime + ".";
+    }
+
+    lock_guard<mutex> rulesLock(rulesMutex);
+    rules.push_back(rule);
+    rules.back().id = nextRuleID++;
+    rules.back().status = STATUS[0];
+    indexRules();
+    rulesChanged();
+    logToFile("Standing reservation S" + to_string(rules.back().id) + " added for " + rule.username);
+    return "";
+}
+
+// Copies the standing rules of a user and/or with a status (empty matches any)
+vector<StandingRule> ReservationSystem::standingRules(const string &username, const string &status) const
+{
+    lock_guard<mutex> lock(rulesMutex);
+    vector<StandingRule> matches;
+    for (const auto &rule : rules)
+    {
+        if ((username.empty() || rule.username == username) && (status.empty() || rule.status == status))
+            matches.push_back(rule);
+    }
+    return matches;
+}
+
+// Approves or rejects a pending standing rule
+bool ReservationSystem::reviewStandingRule(uint32_t id, const string &status)
+{
+    lock_guard<mutex> lock(rulesMutex);
+    StandingRule *rule = findRule(id, "");
+    if (!rule || rule->status != STATUS[0])
+        return false;
+    rule->status = status;
+    rulesChanged();
+    logToFile("Standing reservation S" + to_string(id) + " " + toLowerCase(status));
+    return true;
+}
+
+// Stops a user's standing rule from booking anything on or after fromDate
+bool ReservationSystem::endStandingRule(uint32_t id, const string &username, int fromDate)
+{
+    lock_guard<mutex> lock(rulesMutex);
+    StandingRule *rule = findRule(id, username);
+    if (!rule)
+        return false;
+    rule->toDate = keyFromDayNumber(dayNumber(fromDate) - 1);
+    if (rule->toDate < rule->fromDate)
+    {
+        rules.erase(rules.begin() + (rule - rules.data()));
+        indexRules();
+    }
+    rulesChanged();
+    return true;
+}
+
+// Cancels one occurrence of a user's standing rule without storing anything but the date
+bool ReservationSystem::cancelOccurrence(uint32_t id, const string &username, int date)
+{
+    lock_guard<mutex> lock(rulesMutex);
+    StandingRule *rule = findRule(id, username);
+    if (!rule || !rule->occursOn(date))
+        return false;
+    rule->exceptions.insert(date);
+    rulesChanged();
+    return true;
+}
+
+// Turns one occurrence into a regular reservation with the given status so it can be edited or settled; returns its ID or ""
+string ReservationSystem::materializeOccurrence(uint32_t id, const string &username, int date, const string &status)
+{
+    lock_guard<mutex> lock(writeMutex);
+    lock_guard<mutex> rulesLock(rulesMutex);
+    StandingRule *rule = findRule(id, username);
+    if (!rule || !rule->occursOn(date))
+        return "";
+
+    string reservationID = generateID();
+    string startTime = timeFromMinutes(rule->startMinute);
+    placeNew(Reservation(reservationID, rule->username, rule->name, rule->phoneNo, rule->tables, dateFromKey(date), startTime,
+                         addTwoHours24(startTime), status)); // Throws before the rule changes if it cannot be stored
+    rule->exceptions.insert(date);
+    rulesChanged();
+    commit(reservations.size() - 1, reservations.size());
+    return reservationID;
+}
+
+// Sends every later change to sink as a log record: PUT <reservations.txt line>, DEL <id>, or RULES <count> followed by
+// that many standing.txt lines
+void ReservationSystem::setChangeLog(function<void(const string &)> sink)
+{
+    lock_guard<mutex> lock(writeMutex);
+    lock_guard<mutex> rulesLock(rulesMutex);
+    changeLog = move(sink);
+}
+
+// Writes the whole book, including the reservations older than the load window, and the standing rules as
+// "<reservations> <rules>" followed by one line each; mark is called while no change can happen, so a log position taken
+// there is exactly where the snapshot ends. Rows loaded later are then never sent again, so they must be part of it.
+string ReservationSystem::logSnapshot(const function<void()> &mark)
+{
+    ReservationSnapshot snap;
+    vector<Reservation> unloaded;
+    string ruleLines;
+    size_t ruleCount;
+    {
+        lock_guard<mutex> lock(writeMutex);
+        lock_guard<mutex> rulesLock(rulesMutex);
+        snap = snapshot();
+        if (partial && store.isOpen())
+            store.scanDates(0, loadedFrom - 1, [&](const Reservation &res)
+                            {
+                                if (positionOf(res.getID()) == ALL_ROWS)
+                                    unloaded.push_back(res); });
+        else if (partial)
+        {
+            ifstream file(bookFile, ios::binary);
+            string line;
+            Reservation res;
+            for (const auto &entry : cold)
+            {
+                line.resize(entry.length);
+                file.seekg(entry.offset);
+                if (file.read(&line[0], entry.length) && parseReservationLine(line, res))
+                    unloaded.push_back(res);
+            }
+        }
+        for (const auto &rule : rules)
+            ruleLines += formatStandingRule(rule) + '\n';
+        ruleCount = rules.size();
+        mark();
+    }
+
+    string text = to_string(snap.size() + unloaded.size()) + ' ' + to_string(ruleCount) + '\n';
+    text.reserve(text.size() + (snap.size() + unloaded.size()) * 80 + ruleLines.size());
+    for (const auto &res : snap)
+        (text += formatReservationLine(res)) += '\n';
+    for (const auto &res : unloaded)
+        (text += formatReservationLine(res)) += '\n';
+    return text + ruleLines;
+}
+
+// Applies changes read from a primary's log in order and publishes them as one version
+void ReservationSystem::applyChanges(const vector<LogChange> &changes)
+{
+    lock_guard<mutex> lock(writeMutex);
+    size_t from = ALL_ROWS, to = 0;
+    for (const auto &change : changes)
+    {
+        size_t position = positionOf(change.removedID.empty() ? change.res.getID() : change.removedID);
+        if (!change.removedID.empty())
+        {
+            if (position == ALL_ROWS)
+                continue;
+            removeAt(position);
+        }
+        else if (position != ALL_ROWS)
+        {
+            reservations[position] = change.res;
+            armTimers(slotOfPosition[position]);
+            guests.add(slotOfPosition[position], change.res);
+        }
+        else
+        {
+            place(change.res);
+            position = reservations.size() - 1;
+        }
+        from = min(from, position);
+        to = max(to, position + 1);
+    }
+    if (from != ALL_ROWS)
+        commit(from, to);
+}
+
+// Replaces every loaded reservation, as when a replica loads a snapshot from its primary
+void ReservationSystem::replaceReservations(const vector<Reservation> &rows)
+{
+    lock_guard<mutex> lock(writeMutex);
+    clearSlots();
+    for (const auto &res : rows)
+        place(res);
+    commit(0, ALL_ROWS);
+}
+
+// Replaces the standing rules, as when a replica reads a RULES record
+void ReservationSystem::replaceStandingRules(vector<StandingRule> newRules)
+{
+    lock_guard<mutex> lock(rulesMutex);
+    rules = move(newRules);
+    for (const auto &rule : rules)
+        nextRuleID = max(nextRuleID, rule.id + 1);
+    indexRules();
+}
+
+// Adds a reservation to (sign 1) or takes it from (sign -1) the totals of its user; the last visit only moves forward
+// (caller holds writeMutex)
+void ReservationSystem::recordHistory(const string &username, string_view status, int tables, int date, int sign)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    lock_guard<mutex> lock(historyMutex);
+    CustomerHistory &history = histories[username];
+    history.bookings += sign;
+    if (status == STATUS[2]) // STATUS[2] = "Settled"
+    {
+        history.settled += sign;
+        history.tablesConsumed += sign * tables;
+        if (sign > 0)
+            history.lastVisit = max(history.lastVisit, date);
+    }
+    else if (status == STATUS[3]) // STATUS[3] = "Rejected"
+        history.rejected += sign;
+}
+
+void ReservationSystem::recordHistory(const Reservation &res, int sign)
+{
+    recordHistory(res.getUsername(), res.getStatus(), res.getTablesReserved(), dateKey(res.getDate()), sign);
+}
+
+// Places a new reservation and writes it through; if the store refuses it (say, an entry too large) it is taken out again
+// and the error rethrown, so nothing changed (caller holds writeMutex and commits)
+void ReservationSystem::placeNew(const Reservation &res)
+{
+    place(res);
+    recordHistory(reservations.back(), 1);
+    try
+    {
+        persist(reservations.size() - 1);
+    }
+    catch (const exception &)
+    {
+        recordHistory(reservations.back(), -1);
+        removeAt(reservations.size() - 1); // Also drops whatever part of it the store had written
+        throw;
+    }
+}
+
+// Counts the archived reservations into the totals, one pass over every segment (caller holds writeMutex)
+void ReservationSystem::recordArchivedHistory()
+{
+    try
+    {
+        archive.scan(0, 99999999, [&](const Reservation &res)
+                     { recordHistory(res, 1); });
+    }
+    catch (const exception &e)
+    {
+        engineLog(string("Error: ") + e.what());
+    }
+}
+
+// Moves the reservation at a position to another status and its user's totals with it (caller holds writeMutex, persists and
+// commits)
+void ReservationSystem::changeStatus(size_t position, const string &status)
+{
+    recordHistory(reservations[position], -1);
+    reservations[position].setStatus(status);
+    recordHistory(reservations[position], 1);
+}
+
+// Sets how many request keys are remembered and for how many seconds
+void ReservationSystem::setRequestKeyLimits(size_t maxKeys, int ttlSeconds)
+{
+    lock_guard<mutex> lock(writeMutex);
+    requestKeys.setLimits(maxKeys, ttlSeconds);
+}
+
+// Returns a user's totals in O(1); all zero for a user without reservations
+CustomerHistory ReservationSystem::customerHistory(const string &username) const
+{
+    lock_guard<mutex> lock(historyMutex);
+    auto it = histories.find(username);
+    return it == histories.end() ? CustomerHistory() : it->second;
+}
+
+// Measures the working copy and its slot arrays, counting the room they reserved but do not use yet
+BookFootprint ReservationSystem::footprint() const
+{
+    lock_guard<mutex> lock(writeMutex);
+    BookFootprint footprint;
+    footprint.rows = reservations.size();
+    footprint.rowCapacity = reservations.capacity();
+    footprint.slackBytes = (reservations.capacity() - reservations.size()) * sizeof(Reservation) +
+                           (slotOfPosition.capacity() - slotOfPosition.size()) * sizeof(uint32_t) +
+                           (positionOfSlot.capacity() - positionOfSlot.size()) * sizeof(uint32_t) +
+                           (generations.capacity() - generations.size()) * sizeof(uint32_t) +
+                           (timersOfSlot.capacity() - timersOfSlot.size()) * sizeof(timersOfSlot[0]);
+    footprint.pooledStrings = pooledCount();
+    return footprint;
+}
+
+// Finds the loaded reservations whose guest name approximately matches text, or whose phone number contains it, best
+// matches first; the index is built on the first search and kept up to date by every add and removal after it
+// (edits only change tables, dates and times, which it does not cover)
+vector<Reservation> ReservationSystem::searchGuests(const string &text, size_t limit)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    lock_guard<mutex> lock(writeMutex);
+    if (!guests.isBuilt())
+        guests.build(reservations, slotOfPosition);
+    vector<Reservation> matches;
+    for (uint32_t slot : guests.search(text, limit))
+        matches.push_back(reservations[positionOfSlot[slot]]);
+    return matches;
+}
+
+// Checks if changes are written to the on-disk store instead of reservations.txt
+bool ReservationSystem::usesStore() const
+{
+    return store.isOpen();
+}
+
+// Describes the store's page and buffer pool counters
+string ReservationSystem::storeStats() const
+{
+    return store.stats();
+}
+
+// Saves reservations. Nothing is loaded or changed while the file is written, and when it is the book's own file the
+// reservations that were never loaded are looked up at their new place in it afterwards.
+void ReservationSystem::saveReservationsToFile(const string &filename)
+{
+    lock_guard<mutex> lock(writeMutex);
+
+    // Reservations that were never loaded are copied from the old file before it is replaced
+    vector<string> older;
+    {
+        ifstream oldFile(bookFile, ios::binary);
+        string line;
+        size_t kept = 0;
+        for (const auto &entry : cold)
+        {
+            line.resize(entry.length);
+            oldFile.seekg(entry.offset);
+            if (!oldFile.read(&line[0], entry.length))
+                continue; // Unreadable; it cannot be carried over or loaded any more
+            older.push_back(line);
+            cold[kept++] = entry;
+        }
+        cold.resize(kept);
+        if (!store.isOpen())
+            partial = !cold.empty();
+    }
+    error_code ec;
+    bool ownFile = !bookFile.empty() && (filename == bookFile || filesystem::equivalent(filename, bookFile, ec));
+
+    ofstream file(filename);
+    if (!file)
+    {
+        engineLog("Error opening reservation file for writing.");
+        return;
+    }
+
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        file << formatReservationLine(res) << '\n';
+    }
+    for (size_t i = 0; i < older.size(); i++)
+    {
+        if (ownFile)
+            cold[i].offset = (uint64_t)file.tellp();
+        file << older[i] << '\n';
+    }
+
+    file.close();
+}
+
+// Outputs reservation details
+void ReservationSystem::loadReservationsFromFile(const string &filename)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    string data;
+    if (!readFile(filename, data))
+    {
+        engineLog("No existing reservation data found.");
+        return;
+    }
+
+    // Each thread parses one newline-aligned chunk; lines dated before the load window only have their position noted
+    struct ColdLine
+    {
+        ColdReservation entry;
+        string_view username, status;
+        int tables;
+    };
+    struct Chunk
+    {
+        vector<Reservation> rows;
+        vector<ColdLine> cold;
+    };
+    vector<pair<size_t, size_t>> ranges = splitForThreads(data);
+    vector<Chunk> chunks(ranges.size());
+    int from = loadedFrom;
+    runOnThreads(ranges.size(), [&](size_t c)
+                 {
+                     MemoryScope memory(MemoryTag::Reservations); // Each parsing thread charges its own rows
+                     Chunk &chunk = chunks[c];
+                     chunk.rows.reserve((ranges[c].second - ranges[c].first) / 64); // About the length of a line
+                     Reservation res;
+                     string_view fields[9];
+                     forEachLine(data, ranges[c].first, ranges[c].second, [&](string_view line, size_t offset)
+                                 {
+                                     if (from > 0 && splitFields(line, fields, 9) == 9)
+                                     {
+                                         int key = dateKey(fields[5]);
+                                         if (key >= 0 && key < from)
+                                         {
+                                             uint32_t id = UINT32_MAX;
+                                             int tables = 0;
+                                             from_chars(fields[0].data(), fields[0].data() + fields[0].size(), id);
+                                             from_chars(fields[4].data(), fields[4].data() + fields[4].size(), tables);
+                                             chunk.cold.push_back({{key, id, offset, (uint32_t)line.size()}, fields[1], fields[8], tables});
+                                             return;
+                                         }
+                                     }
+                                     if (parseReservationLine(line, res))
+                                         chunk.rows.push_back(move(res)); }); });
+
+    lock_guard<mutex> lock(writeMutex);
+    clearSlots();
+    cold.clear();
+    loadedUsers.clear();
+    bookFile = filename;
+    {
+        lock_guard<mutex> historyLock(historyMutex);
+        histories.clear();
+    }
+
+    // Merged in file order into storage sized for every row up front
+    size_t rowCount = 0, coldCount = 0;
+    for (const auto &chunk : chunks)
+    {
+        rowCount += chunk.rows.size();
+        coldCount += chunk.cold.size();
+    }
+    reservations.reserve(rowCount);
+    slotOfPosition.reserve(rowCount);
+    positionOfSlot.reserve(rowCount);
+    generations.reserve(rowCount);
+    slotByID.reserve(rowCount);
+    cold.reserve(coldCount);
+    for (auto &chunk : chunks)
+    {
+        for (const auto &line : chunk.cold)
+        {
+            cold.push_back(line.entry);
+            recordHistory(string(line.username), line.status, line.tables, line.entry.date, 1); // Counted now so totals never wait for a load
+        }
+        for (const auto &res : chunk.rows)
+        {
+            place(res);
+            recordHistory(res, 1);
+        }
+        chunk = Chunk(); // Freed as it goes so the parsed copies and the book are not both held for long
+    }
+    recordArchivedHistory();
+    partial = !cold.empty();
+    commit(0, ALL_ROWS);
+}
+
+// Implementation of generateID method
+string ReservationSystem::generateID()
+{
+    // Load counter from file
+    ifstream inFile("counter.txt");
+    if (inFile.is_open())
+    {
+        inFile >> reservationCounter;
+        inFile.close();
+    }
+
+    reservationCounter++; // Increment counter
+
+    // Save updated counter to file
+    ofstream outFile("counter.txt");
+    if (outFile.is_open())
+    {
+        outFile << reservationCounter;
+        outFile.close();
+    }
+
+    return to_string(reservationCounter);
+}
+
+// Takes count consecutive reservation IDs with one counter file update and returns the first one
+int ReservationSystem::reserveIDs(int count)
+{
+    ifstream inFile("counter.txt");
+    if (inFile.is_open())
+    {
+        inFile >> reservationCounter;
+        inFile.close();
+    }
+
+    int first = reservationCounter + 1;
+    reservationCounter += count;
+
+    ofstream outFile("counter.txt");
+    if (outFile.is_open())
+    {
+        outFile << reservationCounter;
+        outFile.close();
+    }
+    return first;
+}
+
+// Implementation of recording logs to file
+void ReservationSystem::logToFile(const string &logEntry)
+{
+    MemoryScope memory(MemoryTag::Logging);
+    ofstream log("reservation_log.txt", ios::app); // Append mode
+    if (log.is_open())
+    {
+        log << "[" << clockTimestamp() << "] " << logEntry << "\n";
+        log.close();
+    }
+}
+
+// Adds a pending reservation to the system and returns its ID
+// A request key makes retries safe: a key seen before, and not yet expired, returns the ID it booked the first time
+string ReservationSystem::addReservation(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date, const string &startTime,
+                                         const string &requestKey)
+{
+    lock_guard<mutex> lock(writeMutex);
+    return addLocked(username, name, phoneNo, tablesReserved, date, startTime, requestKey, false);
+}
+
+// Adds a pending reservation like addReservation, but only if enough tables are free at that time; returns its ID, or an
+// empty string if they are not. The tables are counted under the same lock as the insert, so two callers cannot both take the last ones.
+string ReservationSystem::tryAddReservation(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date,
+                                            const string &startTime, const string &requestKey)
+{
+    int day = dayNumber(dateKey(date));
+    loadDates(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1));
+    lock_guard<mutex> lock(writeMutex);
+    return addLocked(username, name, phoneNo, tablesReserved, date, startTime, requestKey, true);
+}
+
+// Shared part of addReservation and tryAddReservation; a retried request key is answered before the tables are counted,
+// as its own booking now holds some of them (caller holds writeMutex)
+string ReservationSystem::addLocked(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date,
+                                    const string &startTime, const string &requestKey, bool needTables)
+{
+    string endTime = addTwoHours24(startTime);
+    string id;
+    if (!requestKey.empty() && requestKeys.find("add:" + requestKey, id))
+        return id;
+    if (needTables && getAvailableTables(date, startTime, endTime) < tablesReserved)
+        return "";
+    id = generateID();
+    placeNew(Reservation(id, username, name, phoneNo, tablesReserved, date, startTime, endTime, STATUS[0])); // Throws if it cannot be stored
+    commit(reservations.size() - 1, reservations.size());
+    if (!requestKey.empty())
+        requestKeys.remember("add:" + requestKey, id);
+    return id;
+}
+
+// Available tables 
+int ReservationSystem::getAvailableTables(const string &date, const string &startTime, const string &endTime) const
+{
+    int totalTables = TOTAL_TABLES;
+    int bookedTables = 0;
+
+    // Times are counted in minutes from the start of the day before, so bookings that run past midnight overlap correctly
+    int key = dateKey(date), day = dayNumber(key), start = minutesOfDay(startTime), end = minutesOfDay(endTime);
+    if (key < 0 || start < 0 || end < 0)
+        return totalTables;
+    int from = 1440 + start, to = from + (end - start + 1440) % 1440;
+
+    auto count = [&](const Reservation &res)
+    {
+        if (res.getStatus() != STATUS[0] && res.getStatus() != STATUS[1] && res.getStatus() != STATUS[2])
+            return;
+        int resKey = dateKey(res.getDate()), resStart = minutesOfDay(res.getStartTime()), resEnd = minutesOfDay(res.getEndTime());
+        if (resKey < 0 || resStart < 0 || resEnd < 0)
+            return;
+        int offset = dayNumber(resKey) - day;
+        if (offset < -1 || offset > 1)
+            return;
+        // Check for time overlap
+        int resFrom = (offset + 1) * 1440 + resStart, resTo = resFrom + (resEnd - resStart + 1440) % 1440;
+        if (resFrom < to && from < resTo)
+            bookedTables += res.getTablesReserved();
+    };
+
+    if (store.isOpen())
+        store.scanDates(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1), count); // Reads only the pages of these dates
+    else
+    {
+        ReservationSnapshot snap = snapshot();
+        for (const auto &res : snap)
+            count(res);
+    }
+    forEachOccurrence(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1), count);
+
+    return totalTables - bookedTables;
+}
+
+// Moves a user's pending reservation to a new date, time and number of tables; returns an error, or an empty string on success.
+// With reopen, an approved reservation may be moved too and goes back to Pending, but only once the move succeeds.
+string ReservationSystem::updateReservation(const string &id, const string &username, const string &date, const string &startTime, int tablesReserved,
+                                            bool reopen)
+{
+    if (!isValidDate(date))
+        return "Invalid date format or value! Please follow MM-DD-YYYY.";
+    if (!isValidTime24(startTime))
+        return "Invalid time format or value! Please follow HH:MM | 24 hour format.";
+
+    ReservationHandle handle = findHandle(id);
+    Reservation res;
+    if (!resolve(handle, res) || res.getUsername() != username)
+        return "Reservation ID not found.";
+    if (res.getStatus() != STATUS[0] && !(reopen && res.getStatus() == STATUS[1]))
+        return "Only reservations with 'Pending' status can be edited.";
+
+    string endTime = addTwoHours24(startTime);
+    int day = dayNumber(dateKey(date));
+    loadDates(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1));
+
+    // The tables are counted under the same lock as the edit, so a booking made meanwhile cannot take them first
+    lock_guard<mutex> lock(writeMutex);
+    size_t position = positionOf(handle);
+    if (position == ALL_ROWS || reservations[position].getStatus() != res.getStatus())
+        return "Reservation is no longer " + toLowerCase(res.getStatus()) + " and was not updated.";
+    int available = getAvailableTables(date, startTime, endTime) + reservations[position].getTablesReserved(); // Its own tables are freed by the move
+    if (tablesReserved < 1 || tablesReserved > min(TOTAL_TABLES, available))
+        return "Invalid number of tables. Please enter a value between 1 and " + to_string(min(TOTAL_TABLES, available)) + ".";
+    Reservation before = reservations[position];
+    reservations[position].editReservation(tablesReserved, date, startTime, endTime);
+    if (reservations[position].getStatus() != STATUS[0])
+        changeStatus(position, STATUS[0]); // Reopened: the new time needs approving again
+    try
+    {
+        persist(position);
+    }
+    catch (const exception &e)
+    {
+        recordHistory(reservations[position], -1);
+        reservations[position] = before; // The store still holds the old row, or none if it failed halfway
+        recordHistory(before, 1);
+        if (store.isOpen())
+            store.put(before);
+        return string("The reservation could not be saved: ") + e.what();
+    }
+    armTimers(slotOfPosition[position]); // The old times no longer apply
+    commit(position, position + 1);
+    return "";
+}
+
+// Identifies if a reservation with a specific status exists
+bool ReservationSystem::hasStatus(const string &status) const
+{
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        if (res.getStatus() == status)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Identifies if a user has a reservation with a specific status
+bool ReservationSystem::hasUserReservationWithStatus(const string &status, const string &username) const
+{
+    if (store.isOpen())
+    {
+        bool found = false;
+        store.scanUser(username, [&](const Reservation &res)
+                       { found = found || res.getStatus() == status; });
+        return found;
+    }
+
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        if (res.getStatus() == status && res.getUsername() == username)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Displays a page of reservations with a specific status and returns the number of matches
+size_t ReservationSystem::displayByStatus(const string &status, size_t offset, size_t limit)
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("ALL " + toUpperCase(status) + " RESERVATIONS");
+    renderer.appendLine("==============================================================================================================================================================");
+    renderer.appendHeader();
+    return renderer.appendPage(snapshot(), {status, ""}, offset, limit);
+}
+
+// Displays a page of reservations for a specific user and returns the number of matches
+size_t ReservationSystem::displayUserReservations(const string &username, size_t offset, size_t limit)
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("User: " + username);
+    renderer.appendLine("======================================================================== RESERVATIONS ========================================================================");
+    renderer.appendHeader();
+    return renderer.appendPage(snapshot(), {"", username}, offset, limit);
+}
+
+// Displays a page of reservations for a specific user with a specific status and returns the number of matches
+size_t ReservationSystem::displayUserReservationByStatus(const string &status, const string &username, size_t offset, size_t limit)
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("User: " + username);
+    renderer.appendLine("ALL " + toUpperCase(status) + " RESERVATIONS");
+    renderer.appendLine("==============================================================================================================================================================");
+    renderer.appendHeader();
+    return renderer.appendPage(snapshot(), {status, username}, offset, limit);
+}
+
+// Retrieves the status of a reservation by ID
+string ReservationSystem::getStatus(const string &id) const
+{
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        if (res.getID() == id)
+        {
+            return res.getStatus();
+        }
+    }
+    return "";
+}
+
+// Displays a page of all reservations in the system and returns the number of reservations
+size_t ReservationSystem::displayAll(size_t offset, size_t limit)
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("\n====================================================================== ALL RESERVATIONS ======================================================================");
+    renderer.appendHeader();
+    return renderer.appendPage(snapshot(), {}, offset, limit);
+}
+
+// Enables the admin to approve a reservation
+bool ReservationSystem::approveReservation(const string &id)
+{
+    lock_guard<mutex> lock(writeMutex);
+    size_t position = locate(id);
+    if (position != ALL_ROWS && reservations[position].getStatus() == STATUS[0]) // STATUS[0] = "Pending"
+    {
+        changeStatus(position, STATUS[1]); // STATUS[1] = "Approved"
+        persist(position);
+        commit(position, position + 1);
+        return true;
+    }
+    return false;
+}
+
+// Enables the admin to reject a reservation
+bool ReservationSystem::rejectReservation(const string &id)
+{
+    lock_guard<mutex> lock(writeMutex);
+    size_t position = locate(id);
+    if (position != ALL_ROWS && reservations[position].getStatus() == STATUS[0]) // STATUS[0] = "Pending"
+    {
+        changeStatus(position, STATUS[3]); // STATUS[3] = "Rejected"
+        disarmTimers(slotOfPosition[position]);
+        persist(position);
+        commit(position, position + 1);
+        return true;
+    }
+    return false;
+}
+
+// Marks an approved reservation as settled, returns false if it is not approved
+bool ReservationSystem::settlePayment(const string &id, const string &paymentType)
+{
+    lock_guard<mutex> lock(writeMutex);
+    size_t position = locate(id);
+    if (position != ALL_ROWS && reservations[position].getStatus() == STATUS[1]) // STATUS[1] = "Approved"
+    {
+        changeStatus(position, STATUS[2]); // STATUS[2] = "Settled"
+        const Reservation &res = reservations[position];
+        disarmTimers(slotOfPosition[position]);
+        persist(position);
+        commit(position, position + 1);
+
+        // Log the settled reservation
+        ofstream logFile("settled_reservations.txt", ios::app);
+        if (logFile.is_open())
+        {
+            string dt = clockTimestamp();
+
+            logFile << "RESERVATION ID: " << res.getID()
+                    << " | Name: " << res.getName()
+                    << " | Phone: " << res.getPhoneNo()
+                    << " | Reserved Table: " << res.getTablesReserved()
+                    << " | Date: " << res.getDate()
+                    << " | Start Time: " << res.getStartTime()
+                    << " | End Time: " << res.getEndTime()
+                    << " | Status: Settled"
+                    << " | Payment Method: " << paymentType
+                    << " | Settled At: " << dt << endl;
+            logFile.close();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+// Enables the user to cancel a reservation; a retried request key gets the first answer rather than "not found"
+bool ReservationSystem::cancelReservation(const string &id, const string &requestKey)
+{
+    lock_guard<mutex> lock(writeMutex);
+    string cancelled;
+    if (!requestKey.empty() && requestKeys.find("cancel:" + requestKey, cancelled))
+        return !cancelled.empty();
+    size_t position = locate(id);
+    if (position != ALL_ROWS)
+    {
+        recordHistory(reservations[position], -1);
+        removeAt(position);
+        commit(position, position + 1); // Only this position and the shortened last chunk change
+        cancelled = id;
+    }
+    if (!requestKey.empty())
+        requestKeys.remember("cancel:" + requestKey, cancelled);
+    return !cancelled.empty();
+}
+
+// Checks if a reservation with a specific ID exists
+bool ReservationSystem::exists(const string &id)
+{
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        if (res.getID() == id)
+            return true;
+    }
+    return false;
+}
+
+// Checks if a reservation with a specific ID exists for a specific user
+bool ReservationSystem::existsForUser(const string &id, const string &username) const
+{
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        if (res.getID() == id && res.getUsername() == username)
+            return true;
+    }
+    return false;
+}
+
+// Checks if the reservation system is empty
+bool ReservationSystem::isEmpty() const
+{
+    return snapshot().empty() && !partial;
+}
+
+// Checks if a user has any reservations
+bool ReservationSystem::isUserReservationEmpty(const string &username) const
+{
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        if (res.getUsername() == username)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Evaluates a query over reservations using their columnar projection
+template <typename Rows>
+QueryResult evaluateQuery(const Rows &reservations, const ReservationColumns &columns, const ReservationQuery &query)
+{
+    QueryResult result;
+    vector<uint32_t> selected = columns.select(reservations, query);
+    result.matched = selected.size();
+
+    if (query.groupBy == 0)
+    {
+        auto less = [&](uint32_t a, uint32_t b)
+        {
+            switch (query.sortBy)
+            {
+            case QuerySort::Tables:
+                return columns.tables[a] < columns.tables[b];
+            case QuerySort::Name:
+                return reservations[a].getName() < reservations[b].getName();
+            case QuerySort::ID:
+            {
+                // IDs are numbers stored as text, so shorter IDs come first
+                const string &x = reservations[a].getID(), &y = reservations[b].getID();
+                return x.size() != y.size() ? x.size() < y.size() : x < y;
+            }
+            default:
+                return columns.date[a] != columns.date[b] ? columns.date[a] < columns.date[b] : columns.start[a] < columns.start[b];
+            }
+        };
+        if (query.descending)
+            stable_sort(selected.begin(), selected.end(), [&](uint32_t a, uint32_t b)
+                        { return less(b, a); });
+        else
+            stable_sort(selected.begin(), selected.end(), less);
+        result.rows = move(selected);
+        return result;
+    }
+
+    // Pack the group columns into one 64-bit key: date (27 bits) | user (24 bits) | hour (5 bits) | status (3 bits)
+    unordered_map<uint64_t, size_t> groupIndex;
+    for (uint32_t row : selected)
+    {
+        int hour = columns.start[row] < 0 ? 31 : columns.start[row] / 60;
+        uint64_t key = 0;
+        if (query.groupBy & GROUP_DATE)
+            key |= (uint64_t)(uint32_t)columns.date[row] << 32;
+        if (query.groupBy & GROUP_USER)
+            key |= (uint64_t)columns.user[row] << 8;
+        if (query.groupBy & GROUP_HOUR)
+            key |= (uint64_t)hour << 3;
+        if (query.groupBy & GROUP_STATUS)
+            key |= columns.status[row];
+
+        auto inserted = groupIndex.emplace(key, result.groups.size());
+        if (inserted.second)
+        {
+            QueryGroup group;
+            if (query.groupBy & GROUP_DATE)
+                group.date = columns.date[row];
+            if (query.groupBy & GROUP_STATUS)
+                group.status = columns.status[row];
+            if (query.groupBy & GROUP_HOUR)
+                group.hour = hour == 31 ? -1 : hour;
+            if (query.groupBy & GROUP_USER)
+                group.username = columns.userNames[columns.user[row]];
+            result.groups.push_back(group);
+        }
+        QueryGroup &group = result.groups[inserted.first->second];
+        group.count++;
+        group.tables += columns.tables[row];
+    }
+
+    // Order the groups chronologically, then by username and status
+    sort(result.groups.begin(), result.groups.end(), [](const QueryGroup &a, const QueryGroup &b)
+         { return tie(a.date, a.hour, a.username, a.status) < tie(b.date, b.hour, b.username, b.status); });
+    return result;
+}
+
+// Runs an ad-hoc query on the columnar projection, rebuilding the projection only after changes
+QueryResult ReservationSystem::runQuery(const ReservationQuery &query, bool includeArchived) const
+{
+    ReservationSnapshot snap = snapshot();
+    if (!includeArchived)
+    {
+        lock_guard<mutex> lock(columnsMutex);
+        if (columnsVersion != snap.number())
+        {
+            columns.build(snap);
+            columnsVersion = snap.number();
+        }
+        QueryResult result = evaluateQuery(snap, columns, query);
+        result.snapshot = move(snap);
+        return result;
+    }
+
+    // Archived reservations are only read for the requested dates and get a throwaway projection
+    auto combined = make_shared<vector<Reservation>>(snap.begin(), snap.end());
+    archive.scan(query.fromDate, query.toDate, [&](const Reservation &res)
+                 { combined->push_back(res); });
+    ReservationColumns combinedColumns;
+    combinedColumns.build(*combined);
+    QueryResult result = evaluateQuery(*combined, combinedColumns, query);
+    result.source = combined;
+    return result;
+}
+
+// Displays a page of the reservations matched by a query and returns the number of matches
+size_t ReservationSystem::displayQueryRows(const QueryResult &result, size_t offset, size_t limit) const
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("\n====================================================================== QUERY RESULTS =======================================================================");
+    renderer.appendHeader();
+    for (size_t i = offset; i < result.rows.size() && i - offset < limit; i++)
+        renderer.appendRow(result.source ? (*result.source)[result.rows[i]] : result.snapshot[result.rows[i]]);
+    return result.rows.size();
+}
+
+// Displays the groups of a grouped query with their reservation and table counts
+void ReservationSystem::displayQueryGroups(const QueryResult &result, unsigned groupBy) const
+{
+    ReservationRenderer renderer;
+    string line;
+    auto column = [&](const string &text, size_t width)
+    {
+        line += text;
+        if (text.size() < width)
+            line.append(width - text.size(), ' ');
+    };
+
+    renderer.appendLine("\n========================================== QUERY RESULTS ==========================================");
+    if (groupBy & GROUP_DATE)
+        column("Date", 15);
+    if (groupBy & GROUP_HOUR)
+        column("Hour", 10);
+    if (groupBy & GROUP_USER)
+        column("Username", 25);
+    if (groupBy & GROUP_STATUS)
+        column("Status", 15);
+    column("Reservations", 15);
+    column("Tables", 10);
+    renderer.appendLine(line);
+    renderer.appendLine("---------------------------------------------------------------------------------------------------");
+
+    for (const auto &group : result.groups)
+    {
+        line.clear();
+        if (groupBy & GROUP_DATE)
+            column(group.date < 0 ? "(invalid)" : dateFromKey(group.date), 15);
+        if (groupBy & GROUP_HOUR)
+            column(group.hour < 0 ? "(invalid)" : (group.hour < 10 ? "0" : "") + to_string(group.hour) + ":00", 10);
+        if (groupBy & GROUP_USER)
+            column(group.username, 25);
+        if (groupBy & GROUP_STATUS)
+            column(group.status < 4 ? STATUS[group.status] : "(unknown)", 15);
+        column(to_string(group.count), 15);
+        column(to_string(group.tables), 10);
+        renderer.appendLine(line);
+    }
+    renderer.appendLine("---------------------------------------------------------------------------------------------------");
+    renderer.appendLine(to_string(result.groups.size()) + " group(s), " + to_string(result.matched) + " matching reservation(s).");
+}
+
+// Moves past settled and rejected reservations into the archive and returns how many were moved
+size_t ReservationSystem::archiveColdReservations(int today)
+{
+    auto isCold = [&](const Reservation &res)
+    { return ReservationArchive::isCold(res, today); };
+    size_t archived = 0;
+    {
+        lock_guard<mutex> lock(writeMutex);
+        vector<Reservation> cold;
+        copy_if(reservations.begin(), reservations.end(), back_inserter(cold), isCold);
+        if (cold.empty())
+            return 0;
+
+        // A run that stopped before rewriting the book leaves rows that are already archived; they are only dropped here,
+        // and were counted twice into the history totals at load
+        int fromDate = 99999999, toDate = 0;
+        set<string> coldIDs;
+        for (const auto &res : cold)
+        {
+            fromDate = min(fromDate, dateKey(res.getDate()));
+            toDate = max(toDate, dateKey(res.getDate()));
+            coldIDs.insert(res.getID());
+        }
+        set<string> alreadyArchived;
+        try
+        {
+            archive.scan(fromDate, toDate, [&](const Reservation &res)
+                         {
+                             if (coldIDs.count(res.getID()))
+                                 alreadyArchived.insert(res.getID()); });
+            vector<Reservation> fresh;
+            for (const auto &res : cold)
+            {
+                if (alreadyArchived.count(res.getID()))
+                    recordHistory(res, -1);
+                else
+                    fresh.push_back(res);
+            }
+            archive.append(fresh);
+        }
+        catch (const exception &e)
+        {
+            // Keep the reservations in memory so nothing is lost when the archive cannot be written
+            engineLog(string("Error: ") + e.what());
+            return 0;
+        }
+
+        // Walking backwards, the reservation moved into a freed position has already been checked
+        size_t first = ALL_ROWS;
+        for (size_t i = reservations.size(); i-- > 0;)
+        {
+            if (isCold(reservations[i]))
+            {
+                removeAt(i);
+                first = i;
+            }
+        }
+        commit(first, ALL_ROWS);
+        archived = cold.size() - alreadyArchived.size();
+        logToFile("Archived " + to_string(archived) + " past settled/rejected reservation(s)");
+    }
+
+    // The book is rewritten at once (the store already dropped them), so a crash before exit cannot archive them again
+    if (!store.isOpen() && !bookFile.empty())
+        saveReservationsToFile(bookFile);
+    return archived;
+}
+
+// Reads the archived reservations dated within [fromDate, toDate]
+vector<Reservation> ReservationSystem::loadArchived(int fromDate, int toDate) const
+{
+    vector<Reservation> archived;
+    archive.scan(fromDate, toDate, [&](const Reservation &res)
+                 { archived.push_back(res); });
+    return archived;
+}
+
+// Displays a page of archived reservations and returns the number of reservations
+size_t ReservationSystem::displayArchived(const vector<Reservation> &archived, size_t offset, size_t limit) const
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("\n=================================================================== ARCHIVED RESERVATIONS ====================================================================");
+    renderer.appendHeader();
+    return renderer.appendPage(archived, {}, offset, limit);
+}
+
+// Builds the occupancy of each hour in [fromDate, toDate] in one pass with a per-minute difference array
+OccupancyReport ReservationSystem::occupancy(int fromDate, int toDate, bool includeArchived) const
+{
+    OccupancyReport report;
+    if (!isCalendarDate(fromDate) || !isCalendarDate(toDate))
+        return report;
+    int firstDay = dayNumber(fromDate);
+    toDate = min(toDate, keyFromDayNumber(firstDay + OccupancyReport::MAX_DAYS - 1)); // Longer ranges are cut short
+    report.fromDate = fromDate;
+    report.toDate = toDate;
+    report.days = max(0, dayNumber(toDate) - firstDay + 1);
+    size_t minutes = (size_t)report.days * 1440;
+
+    // +tables where a reservation starts and -tables where it ends; a prefix sum then gives tables in use per minute
+    vector<int> diff(minutes + 1, 0);
+    auto add = [&](const Reservation &res)
+    {
+        if (res.getStatus() == STATUS[3])
+            return; // Rejected reservations do not use tables
+        int key = dateKey(res.getDate()), startMinute = minutesOfDay(res.getStartTime()), endMinute = minutesOfDay(res.getEndTime());
+        if (key < 0 || startMinute < 0 || endMinute < 0)
+            return;
+        int duration = (endMinute - startMinute + 1440) % 1440; // End times past midnight wrap into the next day
+        long long start = (long long)(dayNumber(key) - firstDay) * 1440 + startMinute;
+        long long end = start + duration;
+        start = max(start, 0LL);
+        end = min(end, (long long)minutes);
+        if (start >= end)
+            return;
+        diff[start] += res.getTablesReserved();
+        diff[end] -= res.getTablesReserved();
+    };
+
+    // Reservations of the day before the range can run past midnight into it
+    int scanFrom = keyFromDayNumber(firstDay - 1);
+    ReservationSnapshot snap = snapshot();
+    for (const auto &res : snap)
+    {
+        int key = dateKey(res.getDate());
+        if (key >= scanFrom && key <= toDate)
+            add(res);
+    }
+    forEachOccurrence(scanFrom, toDate, add);
+    if (includeArchived)
+        archive.scan(scanFrom, toDate, add);
+
+    report.peak.assign((size_t)report.days * 24, 0);
+    report.average.assign((size_t)report.days * 24, 0.0);
+    long long inUse = 0, tableMinutes = 0;
+    for (size_t hour = 0; hour < report.peak.size(); hour++)
+    {
+        long long hourTotal = 0;
+        int hourPeak = 0;
+        for (size_t minute = hour * 60; minute < hour * 60 + 60; minute++)
+        {
+            inUse += diff[minute];
+            hourTotal += inUse;
+            hourPeak = max(hourPeak, (int)inUse);
+        }
+        report.peak[hour] = hourPeak;
+        report.average[hour] = hourTotal / 60.0;
+        tableMinutes += hourTotal;
+        if (hourPeak > report.peakTables)
+        {
+            report.peakTables = hourPeak;
+            report.peakDay = (int)(hour / 24);
+            report.peakHour = (int)(hour % 24);
+        }
+    }
+    if (minutes > 0)
+        report.averageUtilization = (double)tableMinutes / ((double)minutes * TOTAL_TABLES);
+    return report;
+}
+
+// Displays the occupancy report as a date x hour heatmap of the most tables in use
+void ReservationSystem::displayOccupancy(const OccupancyReport &report) const
+{
+    ReservationRenderer renderer;
+    char cell[32];
+    string line = "Date        |";
+    for (int hour = 0; hour < 24; hour++)
+    {
+        snprintf(cell, sizeof(cell), " %02d", hour);
+        line += cell;
+    }
+    line += " | Peak  Avg Use";
+
+    renderer.appendLine("\n====================================================== OCCUPANCY (most tables in use per hour) ======================================================");
+    renderer.appendLine(line);
+    renderer.appendLine(string(line.size(), '-'));
+
+    for (int day = 0; day < report.days; day++)
+    {
+        line = dateFromKey(keyFromDayNumber(dayNumber(report.fromDate) + day)) + "  |";
+        int dayPeak = 0;
+        double dayTotal = 0;
+        for (int hour = 0; hour < 24; hour++)
+        {
+            int tables = report.peak[day * 24 + hour];
+            dayPeak = max(dayPeak, tables);
+            dayTotal += report.average[day * 24 + hour];
+            if (tables == 0)
+                line += "  .";
+            else if (tables > TOTAL_TABLES)
+                line += " !!"; // Overbooked
+            else
+            {
+                snprintf(cell, sizeof(cell), " %2d", tables);
+                line += cell;
+            }
+        }
+        snprintf(cell, sizeof(cell), " | %4d %7.1f%%", dayPeak, dayTotal / 24.0 / TOTAL_TABLES * 100.0);
+        line += cell;
+        renderer.appendLine(line);
+    }
+
+    renderer.appendLine(string(line.size(), '-'));
+    if (report.peakTables > 0)
+    {
+        char hour[8];
+        snprintf(hour, sizeof(hour), "%02d:00", report.peakHour);
+        renderer.appendLine("Peak: " + to_string(report.peakTables) + " / " + to_string(TOTAL_TABLES) + " tables on " +
+                            dateFromKey(keyFromDayNumber(dayNumber(report.fromDate) + report.peakDay)) + " at " + hour);
+    }
+    else
+        renderer.appendLine("Peak: no tables in use.");
+    snprintf(cell, sizeof(cell), "%.1f%%", report.averageUtilization * 100.0);
+    renderer.appendLine(string("Average utilization: ") + cell + " of table time. (\".\" = no tables, \"!!\" = overbooked)");
+}
+
+// Writes the occupancy report as CSV with one row per (date, hour)
+bool ReservationSystem::exportOccupancy(const OccupancyReport &report, const string &filename) const
+{
+    ofstream file(filename);
+    if (!file)
+        return false;
+
+    string out = "date,hour,peak_tables,average_tables,peak_utilization\n";
+    char row[96];
+    for (int day = 0; day < report.days; day++)
+    {
+        string date = dateFromKey(keyFromDayNumber(dayNumber(report.fromDate) + day));
+        for (int hour = 0; hour < 24; hour++)
+        {
+            int tables = report.peak[day * 24 + hour];
+            snprintf(row, sizeof(row), ",%02d:00,%d,%.2f,%.2f\n", hour, tables, report.average[day * 24 + hour], (double)tables / TOTAL_TABLES);
+            out += date;
+            out += row;
+        }
+    }
+    file.write(out.data(), out.size());
+    return true;
+}
+
+// Validates an import file, resolves capacity conflicts with one sorted sweep per date and adds the accepted rows
+ImportReport ReservationSystem::bulkImport(const string &data)
+{
+    MemoryScope memory(MemoryTag::Reservations);
+    ImportReport report;
+    report.rows = parseImportData(data);
+
+    // Tables in use per minute for each date touched by the import; 2 extra hours hold reservations that run past midnight
+    const int SPAN = 1440 + 120;
+    map<int, vector<int>> occupancy; // Day number -> tables in use per minute
+    for (const auto &row : report.rows)
+    {
+        if (row.error.empty())
+        {
+            int day = dayNumber(dateKey(row.res.getDate()));
+            for (int d = day; d <= day + 1; d++)
+            {
+                if (!occupancy.count(d))
+                    occupancy[d].assign(SPAN, 0);
+            }
+        }
+    }
+
+    // Adds tables over [start, end) of a day's timeline and to the overlapping parts of the neighbouring days' timelines
+    auto occupy = [&](int day, int start, int end, int tables)
+    {
+        for (int d = day - 1; d <= day + 1; d++)
+        {
+            auto it = occupancy.find(d);
+            if (it == occupancy.end())
+                continue;
+            int offset = (day - d) * 1440;
+            for (int minute = max(start + offset, 0); minute < min(end + offset, SPAN); minute++)
+                it->second[minute] += tables;
+        }
+    };
+    auto span = [](const Reservation &res, int &start, int &end)
+    {
+        start = minutesOfDay(res.getStartTime());
+        end = start + (minutesOfDay(res.getEndTime()) - start + 1440) % 1440;
+    };
+
+    lock_guard<mutex> lock(writeMutex);
+    if (partial && !occupancy.empty())
+    {
+        size_t loaded = faultIn(keyFromDayNumber(occupancy.begin()->first - 1), keyFromDayNumber(occupancy.rbegin()->first), "");
+        if (loaded > 0)
+            commit(reservations.size() - loaded, ALL_ROWS);
+    }
+
+    // Existing bookings and standing reservations on those dates (and the day before) take their tables first
+    auto seed = [&](const Reservation &res)
+    {
+        int key = dateKey(res.getDate()), start, end;
+        if (key < 0 || res.getStatus() == STATUS[3] || minutesOfDay(res.getStartTime()) < 0 || minutesOfDay(res.getEndTime()) < 0)
+            return;
+        int day = dayNumber(key);
+        if (occupancy.count(day - 1) || occupancy.count(day) || occupancy.count(day + 1))
+        {
+            span(res, start, end);
+            occupy(day, start, end, res.getTablesReserved());
+        }
+    };
+    for (const auto &res : reservations)
+        seed(res);
+    if (!occupancy.empty())
+        forEachOccurrence(keyFromDayNumber(occupancy.begin()->first - 1), keyFromDayNumber(occupancy.rbegin()->first), seed);
+
+    // Sweep the valid rows date by date in start-time order; a row is accepted if every minute it covers still has room
+    vector<pair<long long, ImportRow *>> candidates; // Sort key: date, start minute, line
+    for (auto &row : report.rows)
+    {
+        if (row.error.empty())
+        {
+            long long key = ((long long)dateKey(row.res.getDate()) * 1440 + minutesOfDay(row.res.getStartTime())) * (long long)(report.rows.size() + 1);
+            candidates.emplace_back(key + (long long)row.line, &row);
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+
+    vector<ImportRow *> accepted;
+    for (const auto &candidate : candidates)
+    {
+        ImportRow *row = candidate.second;
+        if (row->res.getStatus() == STATUS[3])
+        {
+            accepted.push_back(row); // Rejected reservations hold no tables
+            continue;
+        }
+        int day = dayNumber(dateKey(row->res.getDate())), start, end;
+        span(row->res, start, end);
+        const vector<int> &minutes = occupancy[day];
+        int busiest = 0;
+        for (int minute = start; minute < end; minute++)
+            busiest = max(busiest, minutes[minute]);
+
+        if (busiest + row->res.getTablesReserved() > TOTAL_TABLES)
+        {
+            row->error = "Not enough tables: " + to_string(max(0, TOTAL_TABLES - busiest)) + " available at " + row->res.getDate() + " " + row->res.getStartTime();
+            continue;
+        }
+        occupy(day, start, end, row->res.getTablesReserved());
+        accepted.push_back(row);
+    }
+
+    // Accepted rows get IDs in file order with a single counter update and are published as one version
+    sort(accepted.begin(), accepted.end(), [](const ImportRow *a, const ImportRow *b)
+         { return a->line < b->line; });
+    int nextID = accepted.empty() ? 0 : reserveIDs((int)accepted.size());
+    size_t firstNew = reservations.size();
+    for (ImportRow *row : accepted)
+    {
+        const Reservation &res = row->res;
+        row->res = Reservation(to_string(nextID++), res.getUsername(), res.getName(), res.getPhoneNo(), res.getTablesReserved(),
+                               res.getDate(), res.getStartTime(), res.getEndTime(), res.getStatus());
+        place(row->res);
+        recordHistory(row->res, 1);
+    }
+    if (store.isOpen())
+    {
+        vector<const Reservation *> batch;
+        for (size_t i = firstNew; i < reservations.size(); i++)
+            batch.push_back(&reservations[i]);
+        try
+        {
+            store.putNew(batch);
+        }
+        catch (const exception &e)
+        {
+            // The whole import is taken back out, with whatever part of it the store had written
+            while (reservations.size() > firstNew)
+            {
+                recordHistory(reservations.back(), -1);
+                removeAt(reservations.size() - 1);
+            }
+            for (ImportRow *row : accepted)
+                row->error = string("Not saved: ") + e.what();
+            accepted.clear();
+        }
+    }
+    if (changeLog)
+    {
+        for (size_t i = firstNew; i < reservations.size(); i++)
+            changeLog("PUT " + formatReservationLine(reservations[i]));
+    }
+    if (!accepted.empty())
+        commit(firstNew, ALL_ROWS);
+
+    report.accepted = accepted.size();
+    report.rejected = report.rows.size() - accepted.size();
+    return report;
+}
+
+// Finds every interval where more than TOTAL_TABLES are booked, sweeping each date's start and end events in parallel
+OverbookingAudit ReservationSystem::auditOverbooking(bool includeArchived) const
+{
+    // The part of a reservation that falls on one date; reservations that run past midnight are split in two
+    struct Segment
+    {
+        int day, start, end, tables;
+        const Reservation *res;
+    };
+
+    OverbookingAudit audit;
+    ReservationSnapshot snap = snapshot();
+    vector<Reservation> archived;
+    if (includeArchived)
+        archived = loadArchived(0, 99999999);
+    forEachOccurrence(0, 99999999, [&](const Reservation &res)
+                      { archived.push_back(res); }); // Standing reservations are swept like archived ones
+    audit.scanned = snap.size() + archived.size();
+
+    size_t workers = max(1u, thread::hardware_concurrency());
+    workers = min(workers, audit.scanned / 4096 + 1);
+
+    // Each producer hands a segment to the worker that owns its date, so every date is swept by exactly one worker
+    vector<vector<vector<Segment>>> outbox(workers, vector<vector<Segment>>(workers));
+    auto split = [&](const Reservation &res, vector<vector<Segment>> &out)
+    {
+        if (res.getStatus() == STATUS[3])
+            return; // Rejected reservations do not use tables
+        int key = dateKey(res.getDate()), start = minutesOfDay(res.getStartTime()), endMinute = minutesOfDay(res.getEndTime());
+        if (key < 0 || start < 0 || endMinute < 0 || res.getTablesReserved() <= 0)
+            return;
+        int end = start + (endMinute - start + 1440) % 1440;
+        if (end == start)
+            return;
+        int day = dayNumber(key);
+        out[(unsigned)day % workers].push_back({day, start, min(end, 1440), res.getTablesReserved(), &res});
+        if (end > 1440)
+            out[(unsigned)(day + 1) % workers].push_back({day + 1, 0, end - 1440, res.getTablesReserved(), &res});
+    };
+    auto produce = [&](size_t worker)
+    {
+        for (size_t i = snap.size() * worker / workers; i < snap.size() * (worker + 1) / workers; i++)
+            split(snap[i], outbox[worker]);
+        for (size_t i = archived.size() * worker / workers; i < archived.size() * (worker + 1) / workers; i++)
+            split(archived[i], outbox[worker]);
+    };
+
+    vector<vector<OverbookedInterval>> found(workers);
+    vector<size_t> dates(workers, 0);
+    auto sweep = [&](size_t worker)
+    {
+        vector<Segment> segments;
+        size_t count = 0;
+        for (size_t producer = 0; producer < workers; producer++)
+            count += outbox[producer][worker].size();
+        segments.reserve(count);
+        for (size_t producer = 0; producer < workers; producer++)
+        {
+            segments.insert(segments.end(), outbox[producer][worker].begin(), outbox[producer][worker].end());
+            vector<Segment>().swap(outbox[producer][worker]);
+        }
+        sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b)
+             { return a.day != b.day ? a.day < b.day : a.start < b.start; });
+
+        // Events are minute * 2 + (1 for a start), so ends sort before starts at the same minute and back-to-back bookings do not clash
+        vector<pair<int, int>> events;
+        for (size_t first = 0, last; first < segments.size(); first = last)
+        {
+            for (last = first; last < segments.size() && segments[last].day == segments[first].day; last++)
+                ;
+            dates[worker]++;
+
+            events.clear();
+            for (size_t i = first; i < last; i++)
+            {
+                events.emplace_back(segments[i].start * 2 + 1, segments[i].tables);
+                events.emplace_back(segments[i].end * 2, -segments[i].tables);
+            }
+            sort(events.begin(), events.end());
+
+            size_t dayStart = found[worker].size();
+            int inUse = 0;
+            bool over = false;
+            for (size_t e = 0; e < events.size();)
+            {
+                int minute = events[e].first / 2;
+                for (; e < events.size() && events[e].first / 2 == minute; e++)
+                    inUse += events[e].second;
+
+                if (inUse > TOTAL_TABLES && !over)
+                {
+                    OverbookedInterval interval;
+                    interval.date = keyFromDayNumber(segments[first].day);
+                    interval.startMinute = minute;
+                    found[worker].push_back(move(interval));
+                    over = true;
+                }
+                else if (inUse <= TOTAL_TABLES && over)
+                {
+                    found[worker].back().endMinute = minute;
+                    over = false;
+                }
+                if (over)
+                    found[worker].back().peakTables = max(found[worker].back().peakTables, inUse);
+            }
+
+            // Segments are in start order, so the overlapping ones of each interval end the scan at the interval's end
+            for (size_t k = dayStart; k < found[worker].size(); k++)
+            {
+                OverbookedInterval &interval = found[worker][k];
+                for (size_t i = first; i < last && segments[i].start < interval.endMinute; i++)
+                {
+                    if (segments[i].end > interval.startMinute)
+                        interval.ids.push_back(segments[i].res->getID());
+                }
+            }
+        }
+    };
+
+    auto runAll = [&](const function<void(size_t)> &task)
+    {
+        vector<thread> threads;
+        for (size_t worker = 1; worker < workers; worker++)
+            threads.emplace_back(task, worker);
+        task(0);
+        for (auto &t : threads)
+            t.join();
+    };
+    runAll(produce);
+    runAll(sweep);
+
+    for (size_t worker = 0; worker < workers; worker++)
+    {
+        audit.dates += dates[worker];
+        move(found[worker].begin(), found[worker].end(), back_inserter(audit.intervals));
+    }
+    sort(audit.intervals.begin(), audit.intervals.end(), [](const OverbookedInterval &a, const OverbookedInterval &b)
+         { return a.date != b.date ? a.date < b.date : a.startMinute < b.startMinute; });
+    return audit;
+}
+
+// Displays a page of overbooked intervals and returns the number of intervals
+size_t ReservationSystem::displayAudit(const OverbookingAudit &audit, size_t offset, size_t limit) const
+{
+    ReservationRenderer renderer;
+    renderer.appendLine("\n=================================== OVERBOOKED INTERVALS ===================================");
+    renderer.appendLine("Date        Time           Tables  Reservation IDs");
+    renderer.appendLine("--------------------------------------------------------------------------------------------");
+
+    char line[64];
+    for (size_t i = offset; i < audit.intervals.size() && i - offset < limit; i++)
+    {
+        const OverbookedInterval &interval = audit.intervals[i];
+        snprintf(line, sizeof(line), "  %02d:%02d-%02d:%02d    %3d/%-3d ", interval.startMinute / 60, interval.startMinute % 60,
+                 interval.endMinute / 60, interval.endMinute % 60, interval.peakTables, TOTAL_TABLES);
+        string row = dateFromKey(interval.date) + line;
+        for (size_t k = 0; k < interval.ids.size(); k++)
+            row += (k ? ", " : " ") + interval.ids[k];
+        renderer.appendLine(row);
+    }
+    return audit.intervals.size();
+}
+
+// Function to check if text is exactly count digits
+bool isDigits(const string &text, size_t count)
+{
+    return text.size() == count && isAllDigits(text);
+}
+
+// Function to check a Maya or GCash account number (09XXXXXXXXX)
+bool isValidWalletAccount(const string &accountNo)
+{
+    return isDigits(accountNo, 11) && accountNo[0] == '0' && accountNo[1] == '9';
+}
+
+// Function to check a card expiry date (MM/YYYY)
+bool isValidExpiry(const string &expiry)
+{
+    if (expiry.size() != 7 || expiry[2] != '/' || !isDigits(expiry.substr(0, 2), 2) || !isDigits(expiry.substr(3), 4))
+        return false;
+    int month = (expiry[0] - '0') * 10 + (expiry[1] - '0');
+    return month >= 1 && month <= 12;
+}
+
+// Reads a numeric setting from the environment, or returns fallback when it is not set
+double envSetting(const char *name, double fallback)
+{
+    const char *value = getenv(name);
+    return value ? atof(value) : fallback;
+}
+
+} // namespace reserve_eat
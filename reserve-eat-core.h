@@ -0,0 +1,2760 @@
+// Author: Zurinee Irish M. Belo, Katherine Anne S. Liwanag, Jane Allyson L. Paray, and Jhenelle K.Alonzo
+
+/* Reserve Eat core: reservations, availability, standing reservations, payments and the storage behind them. It lives in
+namespace reserve_eat and never touches the console: the display methods print to the stream set with setEngineOutput
+(nowhere by default) and problems such as an unwritable file go to the sink set with setEngineLog. The console program
+(reserve-eat.cpp) is one client of it, and programs in other languages use it through the C interface in
+reserve-eat-c.h. */
+
+#ifndef RESERVE_EAT_CORE_H
+#define RESERVE_EAT_CORE_H
+
+#include <iostream>  // Used for input/output operations
+#include <vector>    // Used for dynamic array
+#include <string>    // Used for string manipulation
+#include <stdexcept> // Used for exception handling
+#include <iomanip>   // Used for formatting output
+#include <algorithm> // Used for various algorithmic operations
+#include <fstream>   // Used for file operations
+#include <ctime>     // Used for time-related functions
+#include <sstream>   // Used for string streams
+#include <functional> // Used for passing listing callbacks
+#include <unordered_map> // Used for hash-based lookups
+#include <cstring>   // Used for raw memory operations
+#include <cstdint>   // Used for fixed-width integer types
+#include <tuple>     // Used for ordering by several fields
+#include <map>       // Used for ordered key-value storage
+#include <memory>    // Used for shared ownership of query results
+#include <filesystem> // Used for the reservation archive directory
+#include <atomic>    // Used for lock-free snapshot publication
+#include <mutex>     // Used for serializing writers
+#include <thread>    // Used for yielding while waiting and payment workers
+#include <condition_variable> // Used for waking payment workers
+#include <future>    // Used for payment outcomes
+#include <chrono>    // Used for timeouts and backoff
+#include <random>    // Used for the mock payment gateway
+#include <deque>     // Used for the payment queue
+#include <cstdlib>   // Used for reading environment settings
+#include <variant>   // Used for dispatching payment strategies
+#include <type_traits> // Used for resolving payment strategies
+#include <string_view> // Used for parsing without copying
+#include <charconv>  // Used for fast number parsing
+#include <set>       // Used for ordered sets of dates
+#include <list>      // Used for the buffer pool's recency order
+#include <array>     // Used for the timers of each reservation
+#include <cmath>     // Used for rounding retry times
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h> // Used for SSE2 vector instructions in query scans
+#endif
+
+// Everything the engine declares is in reserve_eat. The standard names it uses are brought into that namespace by name,
+// so a program including this header sees neither set unless it asks for reserve_eat.
+namespace reserve_eat
+{
+using std::array, std::deque, std::list, std::map, std::set, std::unordered_map, std::vector;             // Containers
+using std::string, std::string_view, std::to_string, std::getline, std::hash;                             // Strings
+using std::fstream, std::ifstream, std::ofstream, std::ostream, std::stringstream, std::ios, std::flush,
+    std::streamoff;                                                                                       // Streams
+using std::any_of, std::count, std::fill, std::find, std::lower_bound, std::upper_bound, std::max, std::min,
+    std::partition, std::stable_partition, std::remove, std::search, std::sort, std::unique;              // Algorithms
+using std::advance, std::begin, std::end, std::empty, std::size, std::next, std::prev, std::iterator,
+    std::forward_iterator_tag;                                                                            // Iterators
+using std::atomic, std::memory_order_relaxed, std::mutex, std::lock, std::lock_guard, std::unique_lock,
+    std::condition_variable, std::thread, std::promise, std::shared_future;                               // Threads
+using std::function, std::pair, std::get, std::move, std::swap, std::decay_t, std::variant, std::visit,
+    std::shared_ptr, std::make_shared, std::unique_ptr, std::error_code, std::runtime_error;              // Utilities
+using std::mt19937, std::uniform_real_distribution;                                                       // Random numbers
+namespace chrono = std::chrono;
+namespace filesystem = std::filesystem;
+namespace this_thread = std::this_thread;
+
+const string STATUS[] = {"Pending", "Approved", "Settled", "Rejected"}; // 0, 1, 2, 3
+const int TOTAL_TABLES = 10;                                            // Tables in the restaurant
+const size_t MAX_NAME_LENGTH = 100;                                    // Longest guest name; keeps a reservation within MAX_ENTRY_BYTES
+const size_t MAX_USERNAME_LENGTH = 32;                                 // Longest username; keeps a reservation within MAX_ENTRY_BYTES
+
+// Function to convert a string to uppercase
+string toUpperCase(string str);
+
+// Function to convert a string to lowercase
+string toLowerCase(const string &str);
+
+// Function to check if a string contains only digits
+bool isAllDigits(const string &str);
+
+// Function to convert a time into local calendar time without sharing localtime's static buffer between threads
+tm localTime(time_t t);
+
+// Class to tell the engine the time. Date checks, timers, archiving and log timestamps all read it, so a simulation can
+// run the engine on a virtual clock.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+    virtual time_t now() const = 0; // Seconds since the epoch
+
+    // Local calendar time of now(); converted at most once per second on each thread, as localtime is slow
+    tm local() const;
+};
+
+// Class to read the system clock to the second; time() is cheap and local() caches the calendar conversion
+class SystemClock : public Clock
+{
+public:
+    time_t now() const override { return time(nullptr); }
+};
+
+// Class to hold a time that only moves when told to, for simulations and tests
+class ManualClock : public Clock
+{
+private:
+    atomic<time_t> current;
+
+public:
+    explicit ManualClock(time_t start) : current(start) {}
+    time_t now() const override { return current.load(memory_order_relaxed); }
+    void set(time_t time) { current.store(time, memory_order_relaxed); }
+};
+
+// Function to get the clock the engine runs on, the system clock unless another was set
+Clock &engineClock();
+
+// Function to run the engine on another clock, or on the system clock again with nullptr; the clock must outlive its use
+void setEngineClock(Clock *clock);
+
+// Function to format the engine clock's time like ctime, without the newline
+string clockTimestamp();
+
+// Function to send the engine's listings (the display methods) to a stream, or nowhere again with nullptr, the default
+void setEngineOutput(ostream *output);
+
+// Function to get the stream the engine's listings go to
+ostream &engineOutput();
+
+// Function to receive the problems the engine reports, such as a file it cannot open, or drop them again with an empty
+// sink, the default. Like the clock and the output, it is set before the engine is shared between threads.
+void setEngineLog(function<void(const string &)> sink);
+
+// Function to report a problem to the engine's log sink
+void engineLog(const string &message);
+
+// Function to check if a date is valid
+bool isValidDate(const string &date);
+
+// Function to check if a time is valid
+bool isValidTime24(const string &time);
+
+// Function to check if a contact number follows 09XXXXXXXXX
+bool isValidPhoneNo(const string &phoneNo);
+
+// Function to check that a field can be written to a comma-separated line as is: no commas, line breaks or other control characters
+bool isPlainField(const string &field);
+
+// Function to check a guest name: not empty, at most MAX_NAME_LENGTH characters, and a plain field
+bool isValidName(const string &name);
+
+// Function to check a username: not empty, at most MAX_USERNAME_LENGTH characters, and a plain field
+bool isValidUsername(const string &username);
+
+// Function to add two hours to a 24-hour format time
+string addTwoHours24(const string &startTime);
+
+// Function to convert a MM-DD-YYYY date into a sortable YYYYMMDD number (-1 if the date is malformed)
+int dateKey(string_view date);
+
+// Function to convert a YYYYMMDD number back into a MM-DD-YYYY date
+string dateFromKey(int key);
+
+// Function to convert a HH:MM time into minutes since midnight (-1 if the time is malformed)
+int minutesOfDay(const string &time);
+
+// Function to get the index of a status in STATUS (-1 if unknown)
+int statusCode(const string &status);
+
+// Function to convert a YYYYMMDD number into a count of days since 01-01-1970, so dates can be subtracted
+int dayNumber(int key);
+
+// Function to convert a day count from dayNumber back into a YYYYMMDD number
+int keyFromDayNumber(int days);
+
+// Function to check that a YYYYMMDD number is a real calendar date (any year from 0001), such as no 02-30
+bool isCalendarDate(int key);
+
+// Function to get today's date as a YYYYMMDD number
+int todayKey();
+
+// Function to get the local time as minutes since 01-01-1970 00:00, the unit reservations are scheduled in
+long long currentMinute();
+
+// Subsystems that heap allocations are charged to when the build counts them (RESERVE_EAT_MEMPROFILE)
+enum class MemoryTag
+{
+    Other, // Anything allocated outside a MemoryScope
+    Reservations,
+    Users,
+    Logging,
+    Payments,
+};
+constexpr int MEMORY_TAGS = 5;
+
+// Struct to hold the heap use charged to one subsystem
+struct MemoryUsage
+{
+    size_t liveBytes = 0, liveAllocations = 0; // Allocated and not freed yet
+    size_t peakBytes = 0, allocations = 0;     // Most live at once, and every allocation ever made
+};
+
+// Function to get the heap use charged to a subsystem so far; all zero unless the build counts allocations
+MemoryUsage memoryUsage(MemoryTag tag);
+
+// Function to get the name of a subsystem as shown in reports
+const char *memoryTagName(MemoryTag tag);
+
+// Class to charge the heap allocations of the current thread to a subsystem until it goes out of scope; an inner scope
+// takes over and hands back on exit. Frees are charged to whichever subsystem made the allocation. Does nothing unless
+// RESERVE_EAT_MEMPROFILE is defined.
+class MemoryScope
+{
+#ifdef RESERVE_EAT_MEMPROFILE
+private:
+    MemoryTag previous;
+
+public:
+    explicit MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+#else
+public:
+    explicit MemoryScope(MemoryTag) {}
+#endif
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope &operator=(const MemoryScope &) = delete;
+};
+
+// Class to keep one copy of each distinct string; reservations point into it, so copying a reservation allocates nothing.
+// Nothing is ever removed: any reservation, snapshot or reader may still hold a pointer, and counting references would
+// bring back a cost on every copy. A long-running process (--serve, --ship) therefore grows by about 60 bytes per new
+// reservation ID and per new guest name or phone number, including cancelled and archived ones; restarting reclaims it,
+// and pooledCount() and --memreport show how far it has grown.
+class StringPool
+{
+private:
+    static constexpr size_t SHARDS = 16; // Separately locked parts, so parsing threads rarely wait on each other
+    struct Entry
+    {
+        size_t hash;
+        const string *text; // nullptr for a free entry
+    };
+    struct Shard
+    {
+        mutex lock;
+        vector<Entry> index;   // Open addressing with linear probing, kept at most half full, so a lookup usually reads
+                               // one entry and compares the text only when the whole hash matches
+        deque<string> storage; // A deque never moves its elements, so pooled pointers stay valid
+    };
+    Shard shards[SHARDS];
+
+    // Finds the entry holding text, or the free entry where it belongs
+    static Entry &probe(vector<Entry> &index, string_view text, size_t textHash)
+    {
+        size_t mask = index.size() - 1;
+        for (size_t i = (textHash / SHARDS) & mask;; i = (i + 1) & mask) // The low bits already picked the shard
+        {
+            if (!index[i].text || (index[i].hash == textHash && *index[i].text == text))
+                return index[i];
+        }
+    }
+
+public:
+    // Returns the pooled copy of text, whose hash<string_view> is textHash, adding it on first use; pooled strings live
+    // until the program ends
+    const string *intern(string_view text, size_t textHash)
+    {
+        Shard &shard = shards[textHash % SHARDS];
+        lock_guard<mutex> guard(shard.lock);
+        if (shard.index.empty())
+            shard.index.resize(1024);
+        Entry *entry = &probe(shard.index, text, textHash);
+        if (entry->text)
+            return entry->text;
+
+        shard.storage.emplace_back(text);
+        if (shard.storage.size() * 2 > shard.index.size())
+        {
+            vector<Entry> grown(shard.index.size() * 2);
+            for (const Entry &old : shard.index)
+            {
+                if (old.text)
+                    probe(grown, *old.text, old.hash) = old;
+            }
+            shard.index.swap(grown);
+            entry = &probe(shard.index, text, textHash);
+        }
+        *entry = {textHash, &shard.storage.back()};
+        return entry->text;
+    }
+
+    // Counts the distinct strings kept so far
+    size_t size()
+    {
+        size_t count = 0;
+        for (auto &shard : shards)
+        {
+            lock_guard<mutex> guard(shard.lock);
+            count += shard.storage.size();
+        }
+        return count;
+    }
+};
+
+// Function to get the pooled copy of a string shared by every reservation
+const string *pooled(string_view text);
+
+// Function to count the distinct strings pooled so far
+size_t pooledCount();
+
+// Class to represent a reservation
+class Reservation
+{
+private:
+    const string *id, *username, *name, *phoneNo, *date, *startTime, *endTime, *status; // Pooled with pooled()
+    int tablesReserved;
+
+public:
+    Reservation() : tablesReserved(0) { id = username = name = phoneNo = date = startTime = endTime = status = pooled(""); }
+    Reservation(string_view id, string_view username, string_view name, string_view phoneNo, int tablesReserved, string_view date, string_view startTime, string_view endTime, string_view status) : id(pooled(id)), username(pooled(username)), name(pooled(name)), phoneNo(pooled(phoneNo)), tablesReserved(tablesReserved), date(pooled(date)), startTime(pooled(startTime)), endTime(pooled(endTime)), status(pooled(status)) {}
+
+    // Getters return references so scans compare fields without copying them
+    const string &getID() const { return *id; }
+    const string &getUsername() const { return *username; }
+    const string &getName() const { return *name; }
+    const string &getPhoneNo() const { return *phoneNo; }
+    const string &getStatus() const { return *status; }
+    int getTablesReserved() const { return tablesReserved; }
+    const string &getDate() const { return *date; }
+    const string &getStartTime() const { return *startTime; }
+    const string &getEndTime() const { return *endTime; }
+    void setStatus(const string &newStatus) { status = pooled(newStatus); }
+
+    void editReservation(int tReserved, string_view dt, string_view stm, string_view etm)
+    {
+        tablesReserved = tReserved;
+        date = pooled(dt);
+        startTime = pooled(stm);
+        endTime = pooled(etm);
+    }
+};
+
+// Function to format a reservation as a line of reservations.txt (without the newline)
+string formatReservationLine(const Reservation &res);
+
+// Function to parse a line of reservations.txt, returns false if the line is incomplete
+bool parseReservationLine(string_view line, Reservation &res);
+
+const size_t PAGE_SIZE = 20;           // Number of reservations shown per page in listings
+const size_t ALL_ROWS = (size_t)-1;    // Limit value that shows every matching reservation
+const size_t RENDER_CHUNK = 64 * 1024; // Buffered output is written in chunks of this size
+
+// Struct to describe which reservations a listing should include (empty fields match anything)
+struct ReservationFilter
+{
+    string status;
+    string username;
+
+    bool matches(const Reservation &res) const
+    {
+        return (status.empty() || res.getStatus() == status) && (username.empty() || res.getUsername() == username);
+    }
+};
+
+// Class to format reservation listings into a reusable buffer that is written out in large chunks
+class ReservationRenderer
+{
+private:
+    ostream &out;
+    string buffer;
+
+    // Appends text left-aligned and padded to the column width (long text is not cut, same as setw)
+    void appendColumn(const string &text, size_t width)
+    {
+        buffer += text;
+        if (text.size() < width)
+            buffer.append(width - text.size(), ' ');
+    }
+
+    void appendColumn(int value, size_t width)
+    {
+        appendColumn(to_string(value), width);
+    }
+
+public:
+    explicit ReservationRenderer(ostream &output = engineOutput()) : out(output)
+    {
+        buffer.reserve(RENDER_CHUNK * 2);
+    }
+
+    ~ReservationRenderer() { flush(); }
+
+    // Appends a raw line of text
+    void appendLine(const string &text)
+    {
+        buffer += text;
+        buffer += '\n';
+        if (buffer.size() >= RENDER_CHUNK)
+            flush();
+    }
+
+    // Appends the column headings of a reservation listing
+    void appendHeader()
+    {
+        appendColumn("Reservation ID", 20);
+        appendColumn("Name", 30);
+        appendColumn("Phone Number", 20);
+        appendColumn("Reserved Table", 20);
+        appendColumn("Date", 15);
+        appendColumn("Start Time", 15);
+        appendColumn("End Time", 15);
+        appendColumn("Status", 15);
+        buffer += '\n';
+        appendLine("--------------------------------------------------------------------------------------------------------------------------------------------------------------");
+    }
+
+    // Appends one reservation row followed by its separator line
+    void appendRow(const Reservation &res)
+    {
+        appendColumn(res.getID(), 20);
+        appendColumn(res.getName(), 30);
+        appendColumn(res.getPhoneNo(), 20);
+        appendColumn(res.getTablesReserved(), 20);
+        appendColumn(res.getDate(), 15);
+        appendColumn(res.getStartTime(), 15);
+        appendColumn(res.getEndTime(), 15);
+        appendColumn(res.getStatus(), 15);
+        buffer += '\n';
+        appendLine("==============================================================================================================================================================");
+    }
+
+    // Appends the matching reservations that fall on the page [offset, offset + limit) and returns the total number of matches
+    template <typename Range>
+    size_t appendPage(const Range &reservations, const ReservationFilter &filter, size_t offset, size_t limit)
+    {
+        size_t matched = 0;
+        for (const auto &res : reservations)
+        {
+            if (!filter.matches(res))
+                continue;
+            if (matched >= offset && matched - offset < limit)
+                appendRow(res);
+            matched++;
+        }
+        return matched;
+    }
+
+    // Writes the buffered text to the output stream in one call
+    void flush()
+    {
+        if (!buffer.empty())
+        {
+            out.write(buffer.data(), buffer.size());
+            out.flush();
+            buffer.clear();
+        }
+    }
+};
+
+// Class to track which epoch each reader is in, so retired versions are freed only after no reader can still see them
+class EpochManager
+{
+private:
+    static constexpr int MAX_READERS = 64;
+    atomic<uint64_t> globalEpoch{1};
+    atomic<uint64_t> readerEpochs[MAX_READERS]; // 0 when the slot is free
+    mutex retiredMutex;
+    vector<pair<uint64_t, function<void()>>> retired; // Epoch it was retired in and how to free it
+
+public:
+    EpochManager()
+    {
+        for (auto &epoch : readerEpochs)
+            epoch.store(0);
+    }
+
+    ~EpochManager()
+    {
+        for (auto &entry : retired)
+            entry.second();
+    }
+
+    // Enters the current epoch and returns the reader slot to pass to unpin
+    int pin()
+    {
+        while (true)
+        {
+            for (int slot = 0; slot < MAX_READERS; slot++)
+            {
+                uint64_t expected = 0;
+                if (readerEpochs[slot].compare_exchange_strong(expected, globalEpoch.load()))
+                    return slot;
+            }
+            this_thread::yield(); // Every slot is pinned; wait for a reader to finish
+        }
+    }
+
+    void unpin(int slot)
+    {
+        readerEpochs[slot].store(0);
+    }
+
+    // Schedules an object that was just unlinked to be freed once every reader that could see it has left
+    void retire(function<void()> free)
+    {
+        uint64_t epoch = globalEpoch.fetch_add(1);
+        lock_guard<mutex> lock(retiredMutex);
+        retired.emplace_back(epoch, move(free));
+    }
+
+    // Frees the retired objects that are older than the oldest pinned reader
+    void reclaim()
+    {
+        uint64_t oldest = UINT64_MAX;
+        for (auto &epoch : readerEpochs)
+        {
+            uint64_t pinned = epoch.load();
+            if (pinned != 0)
+                oldest = min(oldest, pinned);
+        }
+
+        vector<function<void()>> ready;
+        {
+            lock_guard<mutex> lock(retiredMutex);
+            auto stillVisible = partition(retired.begin(), retired.end(), [&](const pair<uint64_t, function<void()>> &entry)
+                                          { return entry.first >= oldest; });
+            for (auto it = stillVisible; it != retired.end(); ++it)
+                ready.push_back(move(it->second));
+            retired.erase(stillVisible, retired.end());
+        }
+        for (auto &free : ready)
+            free();
+    }
+};
+
+const size_t CHUNK_BITS = 8;
+const size_t CHUNK_SIZE = (size_t)1 << CHUNK_BITS; // Reservations per copy-on-write chunk
+
+// Struct to hold one immutable version of the reservation book; unchanged chunks are shared with older versions
+struct ReservationVersion
+{
+    unsigned long number = 0;
+    size_t size = 0;
+    vector<const vector<Reservation> *> chunks; // Chunk k holds positions [k * CHUNK_SIZE, (k + 1) * CHUNK_SIZE)
+};
+
+// Class to pin one version of the reservation book for reading; writers keep committing while it is held
+class ReservationSnapshot
+{
+private:
+    EpochManager *epochs = nullptr;
+    int slot = -1;
+    const ReservationVersion *version = nullptr;
+
+public:
+    ReservationSnapshot() = default;
+
+    ReservationSnapshot(EpochManager &manager, const atomic<const ReservationVersion *> &current) : epochs(&manager)
+    {
+        slot = epochs->pin();
+        version = current.load(); // Loaded after pinning, so it cannot be freed while pinned
+    }
+
+    ReservationSnapshot(ReservationSnapshot &&other) noexcept : epochs(other.epochs), slot(other.slot), version(other.version)
+    {
+        other.epochs = nullptr;
+    }
+
+    ReservationSnapshot &operator=(ReservationSnapshot &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (epochs)
+                epochs->unpin(slot);
+            epochs = other.epochs;
+            slot = other.slot;
+            version = other.version;
+            other.epochs = nullptr;
+        }
+        return *this;
+    }
+
+    ReservationSnapshot(const ReservationSnapshot &) = delete;
+    ReservationSnapshot &operator=(const ReservationSnapshot &) = delete;
+
+    ~ReservationSnapshot()
+    {
+        if (epochs)
+            epochs->unpin(slot);
+    }
+
+    unsigned long number() const { return version ? version->number : 0; }
+    size_t size() const { return version ? version->size : 0; }
+    bool empty() const { return size() == 0; }
+
+    const Reservation &operator[](size_t position) const
+    {
+        return (*version->chunks[position >> CHUNK_BITS])[position & (CHUNK_SIZE - 1)];
+    }
+
+    // Iterator over the reservations of the snapshot in book order
+    class const_iterator
+    {
+    private:
+        const ReservationSnapshot *snapshot;
+        size_t position;
+
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = Reservation;
+        using difference_type = ptrdiff_t;
+        using pointer = const Reservation *;
+        using reference = const Reservation &;
+
+        const_iterator(const ReservationSnapshot *snap, size_t pos) : snapshot(snap), position(pos) {}
+        const Reservation &operator*() const { return (*snapshot)[position]; }
+        const Reservation *operator->() const { return &(*snapshot)[position]; }
+        const_iterator &operator++()
+        {
+            position++;
+            return *this;
+        }
+        bool operator!=(const const_iterator &other) const { return position != other.position; }
+        bool operator==(const const_iterator &other) const { return position == other.position; }
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+};
+
+const unsigned GROUP_DATE = 1, GROUP_STATUS = 2, GROUP_USER = 4, GROUP_HOUR = 8; // Group-by columns of a query
+enum class QuerySort
+{
+    Date,
+    Tables,
+    Name,
+    ID
+};
+
+// Struct to describe an ad-hoc query over the reservations (default values match everything)
+struct ReservationQuery
+{
+    int fromDate = 0, toDate = 99999999; // Inclusive YYYYMMDD range
+    unsigned statusMask = 0xF;           // Bit i selects STATUS[i]
+    string username;                     // Exact match
+    string nameContains;                 // Case-insensitive substring
+    string phoneContains;                // Substring
+    int minTables = 0, maxTables = INT32_MAX;
+    unsigned groupBy = 0; // Combination of GROUP_* flags, 0 lists the matching reservations
+    QuerySort sortBy = QuerySort::Date;
+    bool descending = false;
+};
+
+// Struct to hold one group of a grouped query
+struct QueryGroup
+{
+    int date = 0, status = -1, hour = -1;
+    string username;
+    size_t count = 0;
+    long long tables = 0;
+};
+
+// Struct to hold the answer to a query: matching row positions or the groups
+struct QueryResult
+{
+    vector<uint32_t> rows;
+    vector<QueryGroup> groups;
+    size_t matched = 0;
+    ReservationSnapshot snapshot;                 // Version of the book the positions refer to
+    shared_ptr<const vector<Reservation>> source; // Rows the positions refer to when archived reservations were included
+};
+
+// Class to hold a column-per-field projection of the reservations that predicates are evaluated on in blocks
+class ReservationColumns
+{
+private:
+    static constexpr size_t BLOCK = 1024; // Rows evaluated per block; the masks of one block stay in cache
+
+    // Keeps mask[i] only where lo <= column[i] <= hi
+    static void andRange(const int32_t *column, uint8_t *mask, size_t n, int32_t lo, int32_t hi)
+    {
+        size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i vlo = _mm_set1_epi32(lo), vhi = _mm_set1_epi32(hi);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i out[4];
+            for (int j = 0; j < 4; j++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(column + i + j * 4));
+                __m128i outside = _mm_or_si128(_mm_cmplt_epi32(v, vlo), _mm_cmpgt_epi32(v, vhi));
+                out[j] = _mm_andnot_si128(outside, _mm_set1_epi32(-1));
+            }
+            // Narrow four 32-bit lane masks into sixteen byte masks
+            __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(out[0], out[1]), _mm_packs_epi32(out[2], out[3]));
+            __m128i current = _mm_loadu_si128((const __m128i *)(mask + i));
+            _mm_storeu_si128((__m128i *)(mask + i), _mm_and_si128(current, bytes));
+        }
+#endif
+        for (; i < n; i++)
+            mask[i] &= (uint8_t)-(column[i] >= lo && column[i] <= hi);
+    }
+
+    // Keeps mask[i] only where bit column[i] is set in allowed
+    static void andStatus(const uint8_t *column, uint8_t *mask, size_t n, unsigned allowed)
+    {
+        size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(column + i));
+            __m128i hit = _mm_setzero_si128();
+            for (int code = 0; code < 4; code++)
+            {
+                if (allowed & (1u << code))
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)code)));
+            }
+            __m128i current = _mm_loadu_si128((const __m128i *)(mask + i));
+            _mm_storeu_si128((__m128i *)(mask + i), _mm_and_si128(current, hit));
+        }
+#endif
+        for (; i < n; i++)
+            mask[i] &= (uint8_t)-((allowed >> column[i]) & 1u);
+    }
+
+public:
+    vector<int32_t> date;     // YYYYMMDD
+    vector<int32_t> start;    // Minutes since midnight
+    vector<int32_t> tables;   // Tables reserved
+    vector<int32_t> user;     // Position of the username in userNames
+    vector<uint8_t> status;   // Index into STATUS
+    vector<string> userNames; // Dictionary of usernames
+
+    // Rebuilds the projection from the reservations
+    template <typename Rows>
+    void build(const Rows &reservations)
+    {
+        size_t n = reservations.size();
+        date.resize(n);
+        start.resize(n);
+        tables.resize(n);
+        user.resize(n);
+        status.resize(n);
+        userNames.clear();
+
+        unordered_map<string, int32_t> userCodes;
+        for (size_t i = 0; i < n; i++)
+        {
+            const Reservation &res = reservations[i];
+            date[i] = dateKey(res.getDate());
+            start[i] = minutesOfDay(res.getStartTime());
+            tables[i] = res.getTablesReserved();
+            int code = statusCode(res.getStatus());
+            status[i] = (uint8_t)(code < 0 ? 4 : code); // Unknown statuses never match a status mask
+
+            auto inserted = userCodes.emplace(res.getUsername(), (int32_t)userNames.size());
+            if (inserted.second)
+                userNames.push_back(res.getUsername());
+            user[i] = inserted.first->second;
+        }
+    }
+
+    // Evaluates the query predicates block by block and returns the positions of the matching rows
+    template <typename Rows>
+    vector<uint32_t> select(const Rows &reservations, const ReservationQuery &query) const
+    {
+        vector<uint32_t> selected;
+        int32_t userCode = -1;
+        if (!query.username.empty())
+        {
+            auto it = find(userNames.begin(), userNames.end(), query.username);
+            if (it == userNames.end())
+                return selected;
+            userCode = (int32_t)(it - userNames.begin());
+        }
+        string nameNeedle = toLowerCase(query.nameContains);
+
+        uint8_t mask[BLOCK];
+        for (size_t base = 0; base < date.size(); base += BLOCK)
+        {
+            size_t n = min(BLOCK, date.size() - base);
+            memset(mask, 0xFF, n);
+            andRange(&date[base], mask, n, query.fromDate, query.toDate);
+            if (query.statusMask != 0xF)
+                andStatus(&status[base], mask, n, query.statusMask);
+            if (query.minTables > 0 || query.maxTables != INT32_MAX)
+                andRange(&tables[base], mask, n, query.minTables, query.maxTables);
+            if (userCode >= 0)
+                andRange(&user[base], mask, n, userCode, userCode);
+
+            // String predicates only run on rows that survived the column predicates
+            for (size_t i = 0; i < n; i++)
+            {
+                if (!mask[i])
+                    continue;
+                const Reservation &res = reservations[base + i];
+                if (!nameNeedle.empty() && toLowerCase(res.getName()).find(nameNeedle) == string::npos)
+                    continue;
+                if (!query.phoneContains.empty() && res.getPhoneNo().find(query.phoneContains) == string::npos)
+                    continue;
+                selected.push_back((uint32_t)(base + i));
+            }
+        }
+        return selected;
+    }
+};
+
+// Function to append a number using 7 bits per byte (the high bit marks that more bytes follow)
+void appendVarint(string &out, size_t value);
+
+// Function to read a number written by appendVarint, throws if the data ends early
+size_t readVarint(const string &in, size_t &pos);
+
+// Function to compress text with a small LZ77 coder: [literal count][literals][match length - 3][2-byte offset]...
+string lzCompress(const string &in);
+
+// Function to restore text compressed by lzCompress
+string lzDecompress(const string &in, size_t rawSize);
+
+// Class to keep past Settled and Rejected reservations out of memory in compressed, append-only monthly segments
+class ReservationArchive
+{
+private:
+    string directory;
+
+    // Path of the segment that holds the reservations of a YYYYMM month
+    string segmentPath(int month) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%04d-%02d.seg", month / 100, month % 100);
+        return directory + "/" + name;
+    }
+
+public:
+    explicit ReservationArchive(const string &dir = "archive") : directory(dir) {}
+
+    // Checks if a reservation belongs in the archive: settled or rejected and dated before today
+    static bool isCold(const Reservation &res, int today)
+    {
+        int key = dateKey(res.getDate());
+        return key >= 0 && key < today && (res.getStatus() == STATUS[2] || res.getStatus() == STATUS[3]);
+    }
+
+    // Appends the reservations to their monthly segments as one compressed block per month
+    void append(const vector<Reservation> &records) const
+    {
+        if (records.empty())
+            return;
+
+        map<int, string> blocks; // YYYYMM -> reservations.txt lines
+        for (const auto &res : records)
+        {
+            string &block = blocks[dateKey(res.getDate()) / 100];
+            block += formatReservationLine(res);
+            block += '\n';
+        }
+
+        filesystem::create_directories(directory);
+        for (const auto &entry : blocks)
+        {
+            string packed = lzCompress(entry.second);
+            ofstream segment(segmentPath(entry.first), ios::binary | ios::app);
+            if (!segment)
+                throw runtime_error("Cannot write archive segment " + segmentPath(entry.first));
+
+            // Block header: raw size and compressed size as little-endian 32-bit numbers
+            uint32_t header[2] = {(uint32_t)entry.second.size(), (uint32_t)packed.size()};
+            for (uint32_t value : header)
+            {
+                char bytes[4] = {(char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24)};
+                segment.write(bytes, 4);
+            }
+            segment.write(packed.data(), packed.size());
+        }
+    }
+
+    // Reads the archived reservations dated within [fromDate, toDate], opening only the overlapping segments
+    void scan(int fromDate, int toDate, const function<void(const Reservation &)> &visit) const
+    {
+        error_code ec;
+        if (!filesystem::is_directory(directory, ec))
+            return;
+
+        vector<int> months;
+        for (const auto &entry : filesystem::directory_iterator(directory, ec))
+        {
+            string name = entry.path().filename().string();
+            int year, month;
+            if (name.size() == 11 && sscanf(name.c_str(), "%4d-%2d.seg", &year, &month) == 2)
+            {
+                int key = year * 100 + month;
+                if (key * 100 + 31 >= fromDate && key * 100 + 1 <= toDate)
+                    months.push_back(key);
+            }
+        }
+        sort(months.begin(), months.end());
+
+        Reservation res;
+        for (int month : months)
+        {
+            ifstream segment(segmentPath(month), ios::binary);
+            unsigned char header[8];
+            while (segment.read((char *)header, 8))
+            {
+                uint32_t rawSize = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+                uint32_t packedSize = header[4] | header[5] << 8 | header[6] << 16 | (uint32_t)header[7] << 24;
+                string packed(packedSize, '\0');
+                if (!segment.read(&packed[0], packedSize))
+                    throw runtime_error("Truncated archive segment " + segmentPath(month));
+
+                stringstream lines(lzDecompress(packed, rawSize));
+                string line;
+                while (getline(lines, line))
+                {
+                    if (!parseReservationLine(line, res))
+                        continue;
+                    int key = dateKey(res.getDate());
+                    if (key >= fromDate && key <= toDate)
+                        visit(res);
+                }
+            }
+        }
+    }
+};
+
+const size_t PAGE_BYTES = 4096;      // Size of one page of the reservation store
+const size_t POOL_PAGES = 256;       // Pages the buffer pool keeps in memory (1 MB)
+const size_t MAX_ENTRY_BYTES = 1024; // Largest key + value one tree entry may hold, so a split always fits
+
+// Class to cache pages of a file in memory, writing changed pages back when they are flushed or evicted (least recently used first)
+class BufferPool
+{
+private:
+    struct Frame
+    {
+        unique_ptr<char[]> data;
+        bool dirty = false;
+        list<uint32_t>::iterator recent;
+    };
+
+    fstream file;
+    uint32_t pageCount = 0;
+    unordered_map<uint32_t, Frame> frames;
+    list<uint32_t> recent; // Most recently used page first
+
+    void writeBack(uint32_t page, Frame &frame)
+    {
+        file.seekp((streamoff)page * PAGE_BYTES);
+        file.write(frame.data.get(), PAGE_BYTES);
+        frame.dirty = false;
+        writes++;
+    }
+
+    // Makes room for one more page by dropping the least recently used one
+    void evict()
+    {
+        uint32_t page = recent.back();
+        Frame &frame = frames[page];
+        if (frame.dirty)
+            writeBack(page, frame);
+        recent.pop_back();
+        frames.erase(page);
+    }
+
+public:
+    size_t reads = 0, writes = 0, hits = 0;
+
+    // Opens or creates the file, returns false if it cannot be used
+    bool open(const string &path)
+    {
+        file.open(path, ios::in | ios::out | ios::binary);
+        if (!file)
+        {
+            ofstream create(path, ios::binary);
+            create.close();
+            file.open(path, ios::in | ios::out | ios::binary);
+        }
+        if (!file)
+            return false;
+        file.seekg(0, ios::end);
+        pageCount = (uint32_t)((size_t)file.tellg() / PAGE_BYTES);
+        return true;
+    }
+
+    bool isOpen() const { return file.is_open(); }
+    uint32_t pages() const { return pageCount; }
+
+    // Returns the bytes of a page; the pointer is only valid until the next fetch or allocate
+    char *fetch(uint32_t page)
+    {
+        auto it = frames.find(page);
+        if (it != frames.end())
+        {
+            hits++;
+            recent.splice(recent.begin(), recent, it->second.recent);
+            return it->second.data.get();
+        }
+
+        if (frames.size() >= POOL_PAGES)
+            evict();
+        Frame &frame = frames[page];
+        frame.data.reset(new char[PAGE_BYTES]());
+        if (page < pageCount)
+        {
+            file.seekg((streamoff)page * PAGE_BYTES);
+            file.read(frame.data.get(), PAGE_BYTES);
+            file.clear();
+            reads++;
+        }
+        recent.push_front(page);
+        frame.recent = recent.begin();
+        return frame.data.get();
+    }
+
+    void markDirty(uint32_t page) { frames[page].dirty = true; }
+
+    // Adds a zeroed page at the end of the file and returns its number
+    uint32_t allocate()
+    {
+        uint32_t page = pageCount;
+        fetch(page); // Past the end of the file, so nothing is read
+        pageCount++;
+        markDirty(page);
+        return page;
+    }
+
+    // Writes every changed page to the file
+    void flush()
+    {
+        for (auto &entry : frames)
+        {
+            if (entry.second.dirty)
+                writeBack(entry.first, entry.second);
+        }
+        file.flush();
+    }
+};
+
+// Class to keep sorted key/value pairs in a B+-tree of pages; leaves are chained so range scans read only the pages in range
+class BPlusTree
+{
+private:
+    // One page decoded: leaves hold keys and values, inner nodes hold keys and one more child than keys
+    struct Node
+    {
+        bool leaf = true;
+        uint32_t next = 0; // Next leaf in key order (0 = none)
+        vector<string> keys, values;
+        vector<uint32_t> children;
+    };
+
+    BufferPool &pool;
+    uint32_t &root; // Stored in the meta page by the owner (0 = empty tree)
+
+    static void put16(char *&out, size_t value)
+    {
+        *out++ = (char)(value & 0xFF);
+        *out++ = (char)(value >> 8);
+    }
+    static void put32(char *&out, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            *out++ = (char)(value >> (8 * i));
+    }
+    static size_t get16(const char *&in)
+    {
+        size_t value = (unsigned char)in[0] | (size_t)(unsigned char)in[1] << 8;
+        in += 2;
+        return value;
+    }
+    static uint32_t get32(const char *&in)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= (uint32_t)(unsigned char)in[i] << (8 * i);
+        in += 4;
+        return value;
+    }
+
+    // Page layout: [leaf][count][next] then leaf entries [key size][value size][key][value]
+    // or inner entries [first child] then [key size][key][child] per key
+    static size_t encodedSize(const Node &node)
+    {
+        size_t size = 7;
+        for (size_t i = 0; i < node.keys.size(); i++)
+            size += node.leaf ? 4 + node.keys[i].size() + node.values[i].size() : 6 + node.keys[i].size();
+        return node.leaf ? size : size + 4;
+    }
+
+    Node read(uint32_t page)
+    {
+        const char *in = pool.fetch(page);
+        Node node;
+        node.leaf = *in++ != 0;
+        size_t count = get16(in);
+        node.next = get32(in);
+        if (!node.leaf)
+            node.children.push_back(get32(in));
+        for (size_t i = 0; i < count; i++)
+        {
+            if (node.leaf)
+            {
+                size_t keySize = get16(in), valueSize = get16(in);
+                node.keys.emplace_back(in, keySize);
+                node.values.emplace_back(in + keySize, valueSize);
+                in += keySize + valueSize;
+            }
+            else
+            {
+                size_t keySize = get16(in);
+                node.keys.emplace_back(in, keySize);
+                in += keySize;
+                node.children.push_back(get32(in));
+            }
+        }
+        return node;
+    }
+
+    void write(uint32_t page, const Node &node)
+    {
+        char *out = pool.fetch(page);
+        *out++ = node.leaf ? 1 : 0;
+        put16(out, node.keys.size());
+        put32(out, node.next);
+        if (!node.leaf)
+            put32(out, node.children[0]);
+        for (size_t i = 0; i < node.keys.size(); i++)
+        {
+            put16(out, node.keys[i].size());
+            if (node.leaf)
+                put16(out, node.values[i].size());
+            memcpy(out, node.keys[i].data(), node.keys[i].size());
+            out += node.keys[i].size();
+            if (node.leaf)
+            {
+                memcpy(out, node.values[i].data(), node.values[i].size());
+                out += node.values[i].size();
+            }
+            else
+                put32(out, node.children[i + 1]);
+        }
+        pool.markDirty(page);
+    }
+
+    // Inserts into the subtree at page; if the page had to split, returns true with the separator key and the new right page
+    bool insertInto(uint32_t page, const string &key, const string &value, string &splitKey, uint32_t &splitPage)
+    {
+        Node node = read(page);
+        if (node.leaf)
+        {
+            size_t i = lower_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin();
+            if (i < node.keys.size() && node.keys[i] == key)
+                node.values[i] = value;
+            else
+            {
+                node.keys.insert(node.keys.begin() + i, key);
+                node.values.insert(node.values.begin() + i, value);
+            }
+        }
+        else
+        {
+            size_t i = upper_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin();
+            string childKey;
+            uint32_t childPage;
+            if (!insertInto(node.children[i], key, value, childKey, childPage))
+                return false;
+            node.keys.insert(node.keys.begin() + i, childKey);
+            node.children.insert(node.children.begin() + i + 1, childPage);
+        }
+
+        if (encodedSize(node) <= PAGE_BYTES)
+        {
+            write(page, node);
+            return false;
+        }
+
+        // Split where the bytes, not the entry counts, are halved
+        size_t half = encodedSize(node) / 2, used = 7, mid = 0;
+        while (mid + 1 < node.keys.size() && used < half)
+        {
+            used += node.leaf ? 4 + node.keys[mid].size() + node.values[mid].size() : 6 + node.keys[mid].size();
+            mid++;
+        }
+        Node right;
+        right.leaf = node.leaf;
+        if (node.leaf)
+        {
+            right.keys.assign(node.keys.begin() + mid, node.keys.end());
+            right.values.assign(node.values.begin() + mid, node.values.end());
+            node.keys.resize(mid);
+            node.values.resize(mid);
+            splitKey = right.keys[0];
+        }
+        else
+        {
+            splitKey = node.keys[mid];
+            right.keys.assign(node.keys.begin() + mid + 1, node.keys.end());
+            right.children.assign(node.children.begin() + mid + 1, node.children.end());
+            node.keys.resize(mid);
+            node.children.resize(mid + 1);
+        }
+        splitPage = pool.allocate();
+        if (node.leaf)
+        {
+            right.next = node.next;
+            node.next = splitPage;
+        }
+        write(splitPage, right);
+        write(page, node);
+        return true;
+    }
+
+    // Finds the leaf that holds key or would hold it
+    uint32_t findLeaf(const string &key)
+    {
+        uint32_t page = root;
+        while (true)
+        {
+            Node node = read(page);
+            if (node.leaf)
+                return page;
+            page = node.children[upper_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin()];
+        }
+    }
+
+public:
+    BPlusTree(BufferPool &bufferPool, uint32_t &rootPage) : pool(bufferPool), root(rootPage) {}
+
+    // Adds a pair or replaces the value of an existing key
+    void insert(const string &key, const string &value)
+    {
+        if (key.size() + value.size() > MAX_ENTRY_BYTES)
+            throw runtime_error("Entry too large for the reservation store.");
+        if (root == 0)
+        {
+            root = pool.allocate();
+            write(root, Node());
+        }
+        string splitKey;
+        uint32_t splitPage;
+        if (insertInto(root, key, value, splitKey, splitPage))
+        {
+            Node top;
+            top.leaf = false;
+            top.keys.push_back(splitKey);
+            top.children = {root, splitPage};
+            root = pool.allocate();
+            write(root, top);
+        }
+    }
+
+    // Builds an empty tree bottom-up from pairs sorted by key, filling each page before starting the next
+    void bulkLoad(const vector<pair<string, string>> &entries)
+    {
+        if (root != 0 || entries.empty())
+            return;
+
+        // Leaves first; each full leaf is linked to the one after it
+        vector<pair<string, uint32_t>> level; // First key and page of each node of the level being built
+        Node node;
+        uint32_t page = pool.allocate();
+        size_t size = 7;
+        for (const auto &entry : entries)
+        {
+            if (entry.first.size() + entry.second.size() > MAX_ENTRY_BYTES)
+                throw runtime_error("Entry too large for the reservation store.");
+            size_t entrySize = 4 + entry.first.size() + entry.second.size();
+            if (size + entrySize > PAGE_BYTES)
+            {
+                uint32_t next = pool.allocate();
+                node.next = next;
+                write(page, node);
+                level.emplace_back(node.keys[0], page);
+                node = Node();
+                page = next;
+                size = 7;
+            }
+            node.keys.push_back(entry.first);
+            node.values.push_back(entry.second);
+            size += entrySize;
+        }
+        write(page, node);
+        level.emplace_back(node.keys[0], page);
+
+        // Then inner levels until one node is left
+        while (level.size() > 1)
+        {
+            vector<pair<string, uint32_t>> parents;
+            for (size_t i = 0; i < level.size();)
+            {
+                Node inner;
+                inner.leaf = false;
+                inner.children.push_back(level[i].second);
+                string firstKey = level[i++].first;
+                size = 11;
+                while (i < level.size() && size + 6 + level[i].first.size() <= PAGE_BYTES)
+                {
+                    inner.keys.push_back(level[i].first);
+                    inner.children.push_back(level[i].second);
+                    size += 6 + level[i++].first.size();
+                }
+                uint32_t innerPage = pool.allocate();
+                write(innerPage, inner);
+                parents.emplace_back(firstKey, innerPage);
+            }
+            level.swap(parents);
+        }
+        root = level[0].second;
+    }
+
+    bool isEmpty() const { return root == 0; }
+
+    // Removes a key; pages are not merged, so a leaf may be left partly empty
+    void erase(const string &key)
+    {
+        if (root == 0)
+            return;
+        uint32_t page = findLeaf(key);
+        Node node = read(page);
+        auto it = lower_bound(node.keys.begin(), node.keys.end(), key);
+        if (it != node.keys.end() && *it == key)
+        {
+            node.values.erase(node.values.begin() + (it - node.keys.begin()));
+            node.keys.erase(it);
+            write(page, node);
+        }
+    }
+
+    // Visits the pairs with from <= key < to in key order until visit returns false
+    void scan(const string &from, const string &to, const function<bool(const string &key, const string &value)> &visit)
+    {
+        if (root == 0)
+            return;
+        for (uint32_t page = findLeaf(from); page != 0;)
+        {
+            Node node = read(page);
+            for (size_t i = lower_bound(node.keys.begin(), node.keys.end(), from) - node.keys.begin(); i < node.keys.size(); i++)
+            {
+                if (node.keys[i] >= to || !visit(node.keys[i], node.values[i]))
+                    return;
+            }
+            page = node.next;
+        }
+    }
+
+    bool find(const string &key, string &value)
+    {
+        bool found = false;
+        scan(key, key + '\0', [&](const string &, const string &match)
+             {
+                 value = match;
+                 found = true;
+                 return false; });
+        return found;
+    }
+};
+
+// Class to keep the reservation book on disk: a B+-tree clustered on (date, start time, ID) plus ID and username indexes.
+// It is an on-disk mirror, not a replacement for memory: the working copy still holds every reservation in the load window
+// (--window-days), and only availability, per-user lookups and rows outside the window are read through the pages. Changes
+// are written straight into the pages with no journal, so a crash in the middle of a flush can leave the tree damaged; keep
+// an exported reservations.txt as a backup. Emptied pages are never merged.
+class ReservationStore
+{
+private:
+    static constexpr char MAGIC[9] = "RSVSTOR1";
+    mutable mutex storeMutex; // The buffer pool changes even on reads
+    BufferPool pool;
+    bool opened = false;
+    uint32_t roots[3] = {0, 0, 0}; // By date, by ID, by username; kept in page 0
+    BPlusTree byDate{pool, roots[0]}, byID{pool, roots[1]}, byUser{pool, roots[2]};
+
+    // Date and start time are stored big-endian so the byte order of keys is their time order
+    static string dateKeyPrefix(int date, int minute)
+    {
+        string key(6, '\0');
+        uint32_t day = (uint32_t)max(date, 0);
+        for (int i = 0; i < 4; i++)
+            key[i] = (char)(day >> (24 - 8 * i));
+        key[4] = (char)((minute >> 8) & 0xFF);
+        key[5] = (char)(minute & 0xFF);
+        return key;
+    }
+    static string primaryKey(const Reservation &res)
+    {
+        return dateKeyPrefix(dateKey(res.getDate()), max(minutesOfDay(res.getStartTime()), 0)) + res.getID();
+    }
+
+    void saveMeta()
+    {
+        char *meta = pool.fetch(0);
+        memcpy(meta, MAGIC, 8);
+        for (int tree = 0; tree < 3; tree++)
+            memcpy(meta + 8 + 4 * tree, &roots[tree], 4);
+        pool.markDirty(0);
+    }
+
+public:
+    // Opens or creates the store file, returns false if it is missing or not a reservation store
+    bool open(const string &path)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        if (!pool.open(path))
+            return false;
+        if (pool.pages() == 0)
+        {
+            pool.allocate();
+            saveMeta();
+        }
+        else
+        {
+            const char *meta = pool.fetch(0);
+            if (memcmp(meta, MAGIC, 8) != 0)
+                return false;
+            for (int tree = 0; tree < 3; tree++)
+                memcpy(&roots[tree], meta + 8 + 4 * tree, 4);
+        }
+        opened = true;
+        return true;
+    }
+
+    bool isOpen() const { return opened; }
+
+    bool isEmpty() const { return roots[1] == 0; }
+
+    // Adds or replaces a reservation (matched by ID) in the tree and both indexes
+    void put(const Reservation &res)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        string oldKey, old;
+        if (byID.find(res.getID(), oldKey) && byDate.find(oldKey, old))
+        {
+            Reservation previous;
+            parseReservationLine(old, previous);
+            byDate.erase(oldKey);
+            byUser.erase(previous.getUsername() + '\0' + oldKey);
+        }
+        string key = primaryKey(res);
+        byDate.insert(key, formatReservationLine(res));
+        byID.insert(res.getID(), key);
+        byUser.insert(res.getUsername() + '\0' + key, "");
+        saveMeta();
+    }
+
+    // Adds many new reservations; each tree is filled in key order so inserts stay on the same few cached pages,
+    // and an empty tree is built directly from the sorted pairs
+    void putNew(const vector<const Reservation *> &batch)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        vector<pair<string, string>> dates, ids, users;
+        for (const Reservation *res : batch)
+        {
+            string key = primaryKey(*res);
+            dates.emplace_back(key, formatReservationLine(*res));
+            ids.emplace_back(res->getID(), key);
+            users.emplace_back(res->getUsername() + '\0' + key, "");
+        }
+        for (auto *entries : {&dates, &ids, &users})
+        {
+            sort(entries->begin(), entries->end());
+            BPlusTree &tree = entries == &dates ? byDate : entries == &ids ? byID : byUser;
+            if (tree.isEmpty())
+                tree.bulkLoad(*entries);
+            else
+            {
+                for (const auto &entry : *entries)
+                    tree.insert(entry.first, entry.second);
+            }
+        }
+        saveMeta();
+    }
+
+    // Removes a reservation by ID
+    void remove(const string &id)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        string key, line;
+        if (!byID.find(id, key))
+            return;
+        if (byDate.find(key, line))
+        {
+            Reservation res;
+            parseReservationLine(line, res);
+            byUser.erase(res.getUsername() + '\0' + key);
+            byDate.erase(key);
+        }
+        byID.erase(id);
+        saveMeta();
+    }
+
+    // Looks a reservation up by ID through the ID index
+    bool find(const string &id, Reservation &res)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        string key, line;
+        return byID.find(id, key) && byDate.find(key, line) && parseReservationLine(line, res);
+    }
+
+    // Visits the reservations dated within [fromDate, toDate] in date and start time order, reading only those pages
+    void scanDates(int fromDate, int toDate, const function<void(const Reservation &)> &visit)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        Reservation res;
+        byDate.scan(dateKeyPrefix(fromDate, 0), dateKeyPrefix(toDate + 1, 0), [&](const string &, const string &line)
+                    {
+                        if (parseReservationLine(line, res))
+                            visit(res);
+                        return true; });
+    }
+
+    // Visits a user's reservations in date order through the username index
+    void scanUser(const string &username, const function<void(const Reservation &)> &visit)
+    {
+        lock_guard<mutex> lock(storeMutex);
+        vector<string> keys;
+        byUser.scan(username + '\0', username + '\1', [&](const string &key, const string &)
+                    {
+                        keys.push_back(key.substr(username.size() + 1));
+                        return true; });
+        Reservation res;
+        string line;
+        for (const auto &key : keys)
+        {
+            if (byDate.find(key, line) && parseReservationLine(line, res))
+                visit(res);
+        }
+    }
+
+    // Writes every changed page to disk
+    void flush()
+    {
+        lock_guard<mutex> lock(storeMutex);
+        pool.flush();
+    }
+
+    string stats() const
+    {
+        lock_guard<mutex> lock(storeMutex);
+        return to_string(pool.pages()) + " pages, " + to_string(pool.reads) + " read, " + to_string(pool.writes) + " written, " +
+               to_string(pool.hits) + " buffer hits";
+    }
+};
+
+// Struct to hold tables in use per (date, hour) over a date range
+struct OccupancyReport
+{
+    static constexpr int MAX_DAYS = 366; // Longest range one report covers; it takes about 6 KB per day while it is built
+
+    int fromDate = 0, toDate = 0, days = 0;
+    vector<int> peak;      // Most tables in use at once during each hour, days * 24 entries
+    vector<double> average; // Average tables in use during each hour
+    int peakTables = 0, peakDay = 0, peakHour = 0;
+    double averageUtilization = 0; // Share of table-minutes in use over the whole range
+};
+
+// Struct to hold one stretch of a date during which more tables are booked than the restaurant has
+struct OverbookedInterval
+{
+    int date = 0;                        // YYYYMMDD
+    int startMinute = 0, endMinute = 0;  // [start, end) in minutes of that date
+    int peakTables = 0;                  // Most tables booked at once during the interval
+    vector<string> ids;                  // Reservations that overlap the interval
+};
+
+// Struct to hold the result of an overbooking audit
+struct OverbookingAudit
+{
+    vector<OverbookedInterval> intervals; // Ordered by date and start time
+    size_t scanned = 0, dates = 0;
+};
+
+// Struct to hold one line of a bulk import and what happened to it
+struct ImportRow
+{
+    size_t line = 0;
+    Reservation res;
+    string error; // Empty when the row is valid and accepted
+};
+
+// Struct to hold the per-row outcome of a bulk import
+struct ImportReport
+{
+    vector<ImportRow> rows;
+    size_t accepted = 0, rejected = 0;
+};
+
+// Struct to hold a customer's running totals over every reservation on record, archived ones included
+struct CustomerHistory
+{
+    size_t bookings = 0;          // Reservations on record; a cancelled one leaves the book and this count
+    size_t settled = 0, rejected = 0;
+    long long tablesConsumed = 0; // Tables of the settled reservations
+    int lastVisit = 0;            // YYYYMMDD of the latest settled reservation, 0 if none
+};
+
+// Struct to hold what the book's own arrays take up, to go with the heap use charged to reservations
+struct BookFootprint
+{
+    size_t rows = 0, rowCapacity = 0; // Reservations loaded, and room for them in the working copy
+    size_t slackBytes = 0;            // Reserved but unused bytes of the working copy and its slot arrays
+    size_t pooledStrings = 0;         // Distinct strings the reservations point to
+};
+
+// Function to split text into about parts pieces that each end at a newline, as [begin, end) offsets
+vector<pair<size_t, size_t>> splitIntoLineChunks(const string &data, size_t parts);
+
+// Function to read a whole file into data in one go, returns false if it cannot be read
+bool readFile(const string &filename, string &data);
+
+// Function to split data into newline-aligned chunks for parsing on several threads: one per core, but none smaller
+// than 64 KB, since small files are not worth the threads
+vector<pair<size_t, size_t>> splitForThreads(const string &data);
+
+// Function to run work(0) to work(count - 1) at once, each on its own thread except the first, which runs on the caller's
+void runOnThreads(size_t count, const function<void(size_t)> &work);
+
+// Function to call visit(line, offset) for each line of data[begin, end), without its line end
+template <typename Visit>
+void forEachLine(const string &data, size_t begin, size_t end, Visit visit)
+{
+    while (begin < end)
+    {
+        const char *newline = (const char *)memchr(data.data() + begin, '\n', end - begin);
+        size_t stop = newline ? (size_t)(newline - data.data()) : end;
+        string_view line(data.data() + begin, stop - begin);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        visit(line, begin);
+        begin = stop + 1;
+    }
+}
+
+// Function to split a line into comma-separated fields, returns how many fields it has (only maxFields are stored)
+size_t splitFields(string_view line, string_view *fields, size_t maxFields);
+
+// Function to parse and validate one import line in the reservations.txt schema; the ID is assigned later
+ImportRow parseImportLine(string_view line, size_t lineNo);
+
+// Function to parse an import file on several threads, one newline-aligned chunk per thread
+vector<ImportRow> parseImportData(const string &data);
+
+// Struct to refer to a reservation while it moves around the book; it stops resolving once the reservation is removed
+struct ReservationHandle
+{
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Struct to describe one change read from a primary's log: a reservation to add or replace, or the ID of one to remove
+struct LogChange
+{
+    Reservation res;
+    string removedID; // Set for removals
+};
+
+// Struct to describe a standing reservation: the same two-hour booking every week from fromDate until toDate
+struct StandingRule
+{
+    static constexpr int MAX_WEEKS = 52; // Longest run of one rule; every week is checked for tables when it is added
+
+    uint32_t id = 0; // Shown as S<id>
+    string username, name, phoneNo, status;
+    int tables = 0;
+    int startMinute = 0;
+    int fromDate = 0, toDate = 0; // YYYYMMDD, inclusive; the weekday is the one of fromDate
+    set<int> exceptions;           // Dates the rule no longer books because they were cancelled or materialized
+
+    int weekday() const { return (dayNumber(fromDate) + 4) % 7; } // 0 = Sunday (01-01-1970 was a Thursday)
+
+    // Checks if the rule books a table on a date
+    bool occursOn(int date) const
+    {
+        return date >= fromDate && date <= toDate && (dayNumber(date) - dayNumber(fromDate)) % 7 == 0 && !exceptions.count(date);
+    }
+};
+
+// Function to get the name of a weekday (0 = Sunday)
+string weekdayName(int weekday);
+
+// Function to format minutes since midnight as HH:MM
+string timeFromMinutes(int minutes);
+
+// Function to format a standing rule as a line of standing.txt: id,username,name,phone,tables,from,to,start,status,exception;exception...
+string formatStandingRule(const StandingRule &rule);
+
+// Function to parse a line of standing.txt, returns false if the line is incomplete or invalid
+bool parseStandingRule(const string &line, StandingRule &rule);
+
+// Events the timer wheel fires for a reservation
+enum class TimerKind : uint8_t
+{
+    Reminder, // Some hours before an approved booking starts
+    Expire,   // A booking still pending when it starts is rejected
+    NoShow,   // A booking still approved (never settled) when it ends
+};
+const int TIMER_KINDS = 3;
+
+// Handle of a scheduled timer: a node of the wheel's pool and its generation, so a stale handle cancels nothing
+struct TimerId
+{
+    uint32_t node = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// What a fired timer is about: the reservation's slot and generation, and the event
+struct TimerEvent
+{
+    uint32_t slot, generation;
+    TimerKind kind;
+};
+
+// Hierarchical timing wheel over whole minutes. Four levels of 64 slots reach about 32 years ahead; a timer sits in the
+// lowest level its distance fits, and moves one level down each time the slot above comes round, so scheduling and
+// cancelling are O(1) and advancing a minute only touches the timers due in it and the occasional upper slot.
+class TimingWheel
+{
+private:
+    static constexpr int LEVELS = 4, BITS = 6, SLOTS = 1 << BITS;
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr int OVERDUE = LEVELS * SLOTS; // List of timers already due when they were scheduled
+
+    // Timers are nodes of doubly linked lists, one list per slot
+    struct Node
+    {
+        long long expires;
+        uint32_t prev, next;
+        uint32_t generation;
+        int bucket; // -1 when the node is free
+        TimerEvent event;
+    };
+
+    vector<Node> nodes;
+    vector<uint32_t> freeNodes;
+    uint32_t heads[LEVELS * SLOTS + 1];
+    long long now; // Last minute advanced to
+    size_t live = 0;
+
+    // Slot of a minute not before now; a timer for now itself goes in the slot drained at the end of this tick
+    int bucketFor(long long expires) const
+    {
+        long long delta = expires - now;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1LL << (BITS * (level + 1))))
+            level++;
+        long long at = min(expires, now + (1LL << (BITS * LEVELS)) - 1); // Further out than the wheel reaches: parked at its edge
+        return level * SLOTS + (int)((at >> (BITS * level)) & (SLOTS - 1));
+    }
+
+    void link(uint32_t index, int bucket)
+    {
+        Node &node = nodes[index];
+        node.bucket = bucket;
+        node.prev = NONE;
+        node.next = heads[bucket];
+        if (node.next != NONE)
+            nodes[node.next].prev = index;
+        heads[bucket] = index;
+    }
+
+    void unlink(uint32_t index)
+    {
+        Node &node = nodes[index];
+        if (node.prev != NONE)
+            nodes[node.prev].next = node.next;
+        else
+            heads[node.bucket] = node.next;
+        if (node.next != NONE)
+            nodes[node.next].prev = node.prev;
+    }
+
+    // Moves every timer of a slot to where it belongs now
+    void cascade(int bucket)
+    {
+        uint32_t index = heads[bucket];
+        heads[bucket] = NONE;
+        while (index != NONE)
+        {
+            uint32_t next = nodes[index].next;
+            link(index, bucketFor(nodes[index].expires));
+            index = next;
+        }
+    }
+
+    // Hands the timers of a slot to due and frees their nodes
+    void drain(int bucket, vector<TimerEvent> &due)
+    {
+        uint32_t index = heads[bucket];
+        heads[bucket] = NONE;
+        while (index != NONE)
+        {
+            uint32_t next = nodes[index].next;
+            due.push_back(nodes[index].event);
+            release(index);
+            index = next;
+        }
+    }
+
+    void release(uint32_t index)
+    {
+        nodes[index].bucket = -1;
+        nodes[index].generation++;
+        freeNodes.push_back(index);
+        live--;
+    }
+
+public:
+    explicit TimingWheel(long long now) : now(now) { fill(begin(heads), end(heads), NONE); }
+
+    long long minute() const { return now; }
+    size_t size() const { return live; }
+
+    // Schedules an event for a minute; minutes already past fire on the next advance
+    TimerId schedule(long long expires, const TimerEvent &event)
+    {
+        uint32_t index;
+        if (!freeNodes.empty())
+        {
+            index = freeNodes.back();
+            freeNodes.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)nodes.size();
+            nodes.push_back(Node{0, NONE, NONE, 0, -1, event});
+        }
+        nodes[index].expires = expires;
+        nodes[index].event = event;
+        link(index, expires <= now ? OVERDUE : bucketFor(expires));
+        live++;
+        return {index, nodes[index].generation};
+    }
+
+    // Cancels a timer that has not fired yet
+    void cancel(TimerId id)
+    {
+        if (id.node >= nodes.size() || nodes[id.node].generation != id.generation || nodes[id.node].bucket < 0)
+            return;
+        unlink(id.node);
+        release(id.node);
+    }
+
+    // Drops every timer
+    void clear()
+    {
+        for (uint32_t index = 0; index < nodes.size(); index++)
+        {
+            if (nodes[index].bucket >= 0)
+            {
+                nodes[index].bucket = -1;
+                nodes[index].generation++;
+                freeNodes.push_back(index);
+            }
+        }
+        fill(begin(heads), end(heads), NONE);
+        live = 0;
+    }
+
+    // Moves the wheel forward to a minute and collects the events due by then
+    void advance(long long to, vector<TimerEvent> &due)
+    {
+        drain(OVERDUE, due);
+        while (now < to)
+        {
+            now++;
+            // When a level wraps, the next level's current slot is spread over the levels below
+            for (int level = 1; level < LEVELS && (now & ((1LL << (BITS * level)) - 1)) == 0; level++)
+                cascade(level * SLOTS + (int)((now >> (BITS * level)) & (SLOTS - 1)));
+            drain((int)(now & (SLOTS - 1)), due);
+        }
+    }
+};
+
+// Class to find reservations by approximate guest name or partial phone number. Every distinct name and phone number is one
+// entry (they are pooled, so a regular guest is indexed once however often they book) with an inverted list per trigram of
+// its normalized text. A query only scores the entries sharing its rarest trigrams, then lists the best entries' reservations;
+// reservations removed since are dropped from an entry's list as it is read. Built on first use.
+class GuestIndex
+{
+private:
+    static constexpr int SYMBOLS = 38; // Space, a-z, 0-9 and one code for every other byte
+
+    struct Entry
+    {
+        const string *text;     // Pooled name or phone number
+        string normalized;
+        vector<uint32_t> slots; // Slots indexed with this text; some may have been removed or changed since
+        size_t stale = 0;       // How many of them, roughly; the list is compacted once they are half of it
+    };
+
+    vector<Entry> entries;
+    unordered_map<const string *, uint32_t> entryOf;
+    vector<vector<uint32_t>> postings;           // Trigram -> entries that contain it
+    vector<array<const string *, 2>> fieldsOfSlot; // Name and phone each slot was indexed with
+    vector<bool> liveSlots;
+    vector<uint8_t> hitsOf;                       // Query trigrams each entry has, zero again after every search
+    vector<uint32_t> touched;                     // Entries with hits during the current search
+    bool built = false;
+
+    static int symbol(char c)
+    {
+        if (c == ' ')
+            return 0;
+        if (c >= 'a' && c <= 'z')
+            return 1 + (c - 'a');
+        if (c >= '0' && c <= '9')
+            return 27 + (c - '0');
+        return SYMBOLS - 1;
+    }
+
+    uint32_t entry(const string *text)
+    {
+        auto inserted = entryOf.try_emplace(text, (uint32_t)entries.size());
+        if (inserted.second)
+        {
+            entries.push_back({text, normalize(*text, true), {}});
+            vector<uint32_t> grams;
+            trigrams(entries.back().normalized, grams);
+            for (uint32_t gram : grams)
+                postings[gram].push_back(inserted.first->second);
+        }
+        return inserted.first->second;
+    }
+
+    // Drops the slots of an entry that were removed or now hold other text
+    void compact(Entry &entry)
+    {
+        size_t kept = 0;
+        for (uint32_t slot : entry.slots)
+        {
+            for (auto &field : fieldsOfSlot[slot])
+            {
+                if (field == entry.text && !liveSlots[slot])
+                    field = nullptr; // Re-adding the slot with this text has to list it again
+            }
+            if (liveSlots[slot] && (fieldsOfSlot[slot][0] == entry.text || fieldsOfSlot[slot][1] == entry.text))
+                entry.slots[kept++] = slot;
+        }
+        entry.slots.resize(kept);
+        entry.stale = 0;
+    }
+
+public:
+    // Lowercases letters and turns every run of other ASCII characters into one space; pad puts a space in front so the start
+    // of the first word is a trigram too
+    static string normalize(string_view text, bool pad)
+    {
+        string out = pad ? " " : "";
+        for (char c : text)
+        {
+            if (c >= 'A' && c <= 'Z')
+                c = (char)(c - 'A' + 'a');
+            bool kept = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (unsigned char)c >= 0x80;
+            if (kept)
+                out += c;
+            else if (!out.empty() && out.back() != ' ')
+                out += ' ';
+        }
+        while (!out.empty() && out.back() == ' ' && out.size() > (pad ? 1u : 0u))
+            out.pop_back();
+        return out;
+    }
+
+    // Collects the distinct trigrams of normalized text, sorted
+    static void trigrams(const string &normalized, vector<uint32_t> &grams)
+    {
+        grams.clear();
+        for (size_t i = 0; i + 3 <= normalized.size(); i++)
+            grams.push_back((uint32_t)((symbol(normalized[i]) * SYMBOLS + symbol(normalized[i + 1])) * SYMBOLS + symbol(normalized[i + 2])));
+        sort(grams.begin(), grams.end());
+        grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    bool isBuilt() const
+    {
+        return built;
+    }
+
+    // Forgets everything; the index is built again on its next use
+    void clear()
+    {
+        entries.clear();
+        entryOf.clear();
+        postings.clear();
+        fieldsOfSlot.clear();
+        liveSlots.clear();
+        hitsOf.clear();
+        built = false;
+    }
+
+    // Indexes the reservation in each position, owned by slotOfPosition[position]
+    void build(const vector<Reservation> &reservations, const vector<uint32_t> &slotOfPosition)
+    {
+        clear();
+        postings.resize(SYMBOLS * SYMBOLS * SYMBOLS);
+        built = true;
+        for (size_t position = 0; position < reservations.size(); position++)
+            add(slotOfPosition[position], reservations[position]);
+    }
+
+    // Indexes the reservation now in a slot (nothing to do until the index is built)
+    void add(uint32_t slot, const Reservation &res)
+    {
+        if (!built)
+            return;
+        if (slot >= fieldsOfSlot.size())
+        {
+            fieldsOfSlot.resize(slot + 1, {nullptr, nullptr});
+            liveSlots.resize(slot + 1, false);
+        }
+        array<const string *, 2> fields = {&res.getName(), &res.getPhoneNo()};
+        for (int k = 0; k < 2; k++)
+        {
+            const string *old = fieldsOfSlot[slot][k];
+            if (fields[k] == old) // The slot is still in that entry's list
+            {
+                if (!liveSlots[slot] && entries[entryOf[old]].stale > 0)
+                    entries[entryOf[old]].stale--;
+                continue;
+            }
+            if (old && liveSlots[slot])
+                entries[entryOf[old]].stale++;
+            entries[entry(fields[k])].slots.push_back(slot);
+        }
+        fieldsOfSlot[slot] = fields;
+        liveSlots[slot] = true;
+    }
+
+    void remove(uint32_t slot)
+    {
+        if (!built || slot >= liveSlots.size() || !liveSlots[slot])
+            return;
+        liveSlots[slot] = false;
+        for (const string *field : fieldsOfSlot[slot])
+        {
+            if (field)
+                entries[entryOf[field]].stale++;
+        }
+    }
+
+    // Finds the slots of the reservations best matching a name or partial phone number, best first. A query without
+    // letters must occur in the phone number as typed; otherwise an entry needs all but a third of the query's
+    // trigrams (all but one for two to five), so a misspelt name still matches. Entries sharing more trigrams rank first.
+    vector<uint32_t> search(const string &query, size_t limit)
+    {
+        vector<uint32_t> found;
+        bool letters = any_of(query.begin(), query.end(), [](char c)
+                              { return isalpha((unsigned char)c) || (unsigned char)c >= 0x80; });
+        string typed = normalize(query, letters);
+        vector<uint32_t> grams;
+        trigrams(typed, grams);
+        if (!built || grams.empty() || limit == 0)
+            return found;
+        grams.resize(min<size_t>(grams.size(), UINT8_MAX));
+
+        // Counts the hits of every entry by walking the trigram lists, rarest first; an entry with `need` of the
+        // query's trigrams is in at least one of the (size - need + 1) rarest lists, so only those add candidates
+        size_t need = letters ? grams.size() - max<size_t>(1, grams.size() / 3) + (grams.size() == 1) : grams.size();
+        sort(grams.begin(), grams.end(), [&](uint32_t a, uint32_t b)
+             { return postings[a].size() < postings[b].size(); });
+        hitsOf.resize(entries.size(), 0);
+        touched.clear();
+        for (size_t k = 0; k < grams.size(); k++)
+        {
+            if (k + need > grams.size())
+            {
+                for (uint32_t candidate : postings[grams[k]])
+                    hitsOf[candidate] += hitsOf[candidate] != 0;
+                continue;
+            }
+            for (uint32_t candidate : postings[grams[k]])
+            {
+                if (hitsOf[candidate]++ == 0)
+                    touched.push_back(candidate);
+            }
+        }
+
+        // Lists the live reservations of the entries with the most hits first, skipping slots whose reservation left or
+        // no longer has this text; a search usually stops within the first few entries of the top tier
+        for (size_t tier = grams.size(); tier >= need && found.size() < limit; tier--)
+        {
+            for (size_t i = 0; i < touched.size() && found.size() < limit; i++)
+            {
+                Entry &entry = entries[touched[i]];
+                if (hitsOf[touched[i]] != tier || (!letters && entry.normalized.find(typed) == string::npos))
+                    continue;
+                if (entry.stale * 2 > entry.slots.size())
+                    compact(entry);
+                for (size_t j = 0; j < entry.slots.size() && found.size() < limit; j++)
+                {
+                    uint32_t slot = entry.slots[j];
+                    bool current = fieldsOfSlot[slot][0] == entry.text || fieldsOfSlot[slot][1] == entry.text;
+                    if (current && liveSlots[slot] && find(found.begin(), found.end(), slot) == found.end())
+                        found.push_back(slot);
+                }
+            }
+        }
+        for (uint32_t candidate : touched)
+            hitsOf[candidate] = 0;
+        return found;
+    }
+
+    size_t entryCount() const
+    {
+        return entries.size();
+    }
+};
+
+// Class to remember what recent client requests did, so a retried request gets the first answer instead of running twice.
+// Keys expire ttl seconds after they were first seen, and once capacity keys are held the oldest one is dropped to make room.
+// Keys are kept in the order they arrived, which is also the order they expire, so expiring and evicting only ever look at
+// the front and every call is O(1) amortized.
+class RequestKeyCache
+{
+private:
+    struct Remembered
+    {
+        string result;
+        time_t expires;
+        uint64_t serial; // Which arrival this is, as a key seen again after it expired is remembered anew
+    };
+    struct Arrival
+    {
+        const string *key; // The key stored in byKey, which never moves while it is there
+        time_t expires;
+        uint64_t serial;
+    };
+
+    unordered_map<string, Remembered> byKey;
+    deque<Arrival> arrivals;
+    size_t capacity;
+    int ttl;
+    uint64_t nextSerial = 0;
+
+    // Drops the oldest arrival, and its key unless the key arrived again since
+    void dropOldest()
+    {
+        auto it = byKey.find(*arrivals.front().key);
+        if (it != byKey.end() && it->second.serial == arrivals.front().serial)
+            byKey.erase(it);
+        arrivals.pop_front();
+    }
+
+public:
+    RequestKeyCache(size_t maxKeys, int ttlSeconds) : capacity(max<size_t>(1, maxKeys)), ttl(ttlSeconds) {}
+
+    // Changes the limits; keys already held keep the expiry they were given
+    void setLimits(size_t maxKeys, int ttlSeconds)
+    {
+        capacity = max<size_t>(1, maxKeys);
+        ttl = ttlSeconds;
+        while (byKey.size() > capacity)
+            dropOldest();
+    }
+
+    // Finds what a key's request did, returns false if the key is new or has expired
+    bool find(const string &key, string &result) const
+    {
+        auto it = byKey.find(key);
+        if (it == byKey.end() || it->second.expires <= engineClock().now())
+            return false;
+        result = it->second.result;
+        return true;
+    }
+
+    // Remembers what a key's request did, for ttl seconds from now
+    void remember(const string &key, const string &result)
+    {
+        time_t now = engineClock().now();
+        while (!arrivals.empty() && arrivals.front().expires <= now)
+            dropOldest();
+        auto it = byKey.find(key);
+        if (it == byKey.end())
+        {
+            while (byKey.size() >= capacity)
+                dropOldest();
+            it = byKey.emplace(key, Remembered()).first;
+        }
+        it->second = {result, now + ttl, nextSerial++};
+        arrivals.push_back({&it->first, it->second.expires, it->second.serial});
+    }
+
+    size_t size() const
+    {
+        return byKey.size();
+    }
+};
+
+// Class to represent the reservation system
+class ReservationSystem
+{
+private:
+    vector<Reservation> reservations;               // Working copy, only touched by writers holding writeMutex; kept densely packed
+    vector<uint32_t> slotOfPosition;                // Slot that owns each position of reservations
+    vector<uint32_t> positionOfSlot;                // Position each slot points at
+    vector<uint32_t> generations;                   // Bumped when a slot is freed, so old handles stop resolving
+    vector<uint32_t> freeSlots;                     // Slots of removed reservations, reused before new ones
+    unordered_map<string_view, uint32_t> slotByID;  // Reservation ID -> slot; keys point into the string pool
+    int reservationCounter = 0;
+    unsigned long version = 0;                      // Incremented on every change to the reservations
+    mutable mutex writeMutex;                       // Serializes writers; readers never take it
+    mutable EpochManager epochs;                    // Frees old versions once no snapshot can see them
+    atomic<const ReservationVersion *> current{nullptr}; // Latest published version
+    mutable mutex columnsMutex;                     // Guards the cached projection
+    mutable ReservationColumns columns;             // Columnar projection used by queries
+    mutable unsigned long columnsVersion = (unsigned long)-1; // Version the projection was built from
+    ReservationArchive archive;                     // Past settled and rejected reservations
+    mutable ReservationStore store;                 // On-disk mirror of the book, written through on every change (--store)
+
+    // Where a reservation older than the load window sits in the book file, so it can be read in when needed
+    struct ColdReservation
+    {
+        int date;        // YYYYMMDD
+        uint32_t id;     // Numeric reservation ID (UINT32_MAX if it is not a number)
+        uint64_t offset; // Position of the line in bookFile
+        uint32_t length;
+    };
+    int loadedFrom = 0;              // Reservations dated before this are not all loaded (0 = everything is loaded)
+    string bookFile;                 // reservations.txt the cold reservations are read from
+    vector<ColdReservation> cold;    // Reservations of bookFile not loaded yet (the store is read through its indexes instead)
+    set<string> loadedUsers;         // Users whose older reservations have all been loaded
+    atomic<bool> partial{false};     // Some reservations are not loaded yet
+
+    vector<StandingRule> rules;      // Standing reservations; their occurrences are only stored once materialized
+    string rulesFile;                // standing.txt the rules were loaded from, rewritten on every change ("" = not saved)
+    vector<size_t> rulesByWeekday[7]; // Positions in rules of the rules that book each weekday
+    uint32_t nextRuleID = 1;
+    mutable mutex rulesMutex;        // Guards the rules; taken after writeMutex when both are needed
+
+    TimingWheel timers{currentMinute()};          // Reminders, expiry and no-show checks of every live reservation
+    vector<array<TimerId, TIMER_KINDS>> timersOfSlot; // Timers armed for each slot (guarded by writeMutex)
+    mutex timersMutex;                            // Guards timers; taken after writeMutex
+    condition_variable timersWake;
+    thread timerThread;
+    bool timersStopping = false;
+    int reminderLead = 24 * 60;                   // Minutes before the start a reminder fires
+
+    GuestIndex guests;                            // Name and phone search (guarded by writeMutex)
+    RequestKeyCache requestKeys{100000, 600};     // Results of recent keyed requests, for retries (guarded by writeMutex)
+
+    mutable mutex historyMutex;                   // Guards histories; taken after writeMutex
+    unordered_map<string, CustomerHistory> histories; // Totals per user, counted at load and kept up to date by every
+                                                  // booking, status change and cancellation after it
+
+    mutable mutex noticesMutex;
+    unordered_map<string, vector<string>> notices; // Messages for users, shown the next time they open their menu
+
+    function<void(const string &)> changeLog;     // Receives every change as a log record while replicas are fed (--ship);
+                                                  // called with writeMutex or rulesMutex held, so records keep their order
+
+    void commit(size_t from, size_t to);
+    ReservationHandle place(const Reservation &res);
+    void removeAt(size_t position);
+    void clearSlots();
+    size_t positionOf(const string &id) const;
+    size_t positionOf(ReservationHandle handle) const;
+    void persist(size_t position);
+    size_t faultIn(int fromDate, int toDate, const string &username);
+    size_t locate(const string &id);
+    void armTimers(uint32_t slot);
+    void disarmTimers(uint32_t slot);
+    void notify(const string &username, const string &message);
+    void indexRules();
+    void rulesChanged();
+    void writeRules(const string &filename) const;
+    StandingRule *findRule(uint32_t id, const string &username);
+    void recordHistory(const string &username, string_view status, int tables, int date, int sign);
+    void recordHistory(const Reservation &res, int sign);
+    void recordArchivedHistory();
+    void placeNew(const Reservation &res);
+    string addLocked(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date,
+                     const string &startTime, const string &requestKey, bool needTables);
+    void changeStatus(size_t position, const string &status);
+
+public:
+    ReservationSystem();
+    ~ReservationSystem();
+    ReservationSnapshot snapshot() const;
+    void startTimers(int reminderHours);
+    void stopTimers();
+    void fireTimers();
+    size_t timerCount();
+    vector<string> takeNotices(const string &username);
+
+    //  Reservation System methods
+    string generateID();
+    void logToFile(const string &logEntry);
+    void loadReservationsFromFile(const string &filename = "reservations.txt");
+    void saveReservationsToFile(const string &filename = "reservations.txt");
+    string addReservation(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date, const string &time,
+                          const string &requestKey = "");
+    string tryAddReservation(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date,
+                             const string &time, const string &requestKey = "");
+    int getAvailableTables(const string &date, const string &startTime, const string &endTime) const;
+    string updateReservation(const string &id, const string &username, const string &date, const string &startTime, int tablesReserved,
+                             bool reopen = false);
+    bool rejectReservation(const string &id);
+    bool cancelReservation(const string &id, const string &requestKey = "");
+    size_t displayAll(size_t offset = 0, size_t limit = ALL_ROWS);
+    bool hasStatus(const string &status) const;
+    bool hasUserReservationWithStatus(const string &status, const string &username) const;
+    size_t displayByStatus(const string &status, size_t offset = 0, size_t limit = ALL_ROWS);
+    size_t displayUserReservations(const string &username, size_t offset = 0, size_t limit = ALL_ROWS);
+    size_t displayUserReservationByStatus(const string &status, const string &username, size_t offset = 0, size_t limit = ALL_ROWS);
+    string getStatus(const string &id) const;
+    bool approveReservation(const string &id);
+    bool settlePayment(const string &id, const string &paymentType);
+    bool exists(const string &id);
+    bool existsForUser(const string &id, const string &username) const;
+    bool isEmpty() const;
+    bool isUserReservationEmpty(const string &username) const;
+    QueryResult runQuery(const ReservationQuery &query, bool includeArchived = false) const;
+    size_t displayQueryRows(const QueryResult &result, size_t offset = 0, size_t limit = ALL_ROWS) const;
+    void displayQueryGroups(const QueryResult &result, unsigned groupBy) const;
+    size_t archiveColdReservations(int today = todayKey());
+    vector<Reservation> loadArchived(int fromDate, int toDate) const;
+    size_t displayArchived(const vector<Reservation> &archived, size_t offset = 0, size_t limit = ALL_ROWS) const;
+    OccupancyReport occupancy(int fromDate, int toDate, bool includeArchived) const;
+    void displayOccupancy(const OccupancyReport &report) const;
+    bool exportOccupancy(const OccupancyReport &report, const string &filename = "occupancy_report.csv") const;
+    int reserveIDs(int count);
+    ImportReport bulkImport(const string &data);
+    ReservationHandle findHandle(const string &id) const;
+    bool resolve(ReservationHandle handle, Reservation &res) const;
+    bool openStore(const string &path);
+    void setLoadWindow(int days);
+    size_t loadDates(int fromDate, int toDate);
+    size_t loadUser(const string &username);
+    void loadStandingRules(const string &filename = "standing.txt");
+    void saveStandingRules(const string &filename = "standing.txt") const;
+    void forEachOccurrence(int fromDate, int toDate, const function<void(const Reservation &)> &visit) const;
+    string addStandingRule(const StandingRule &rule);
+    vector<StandingRule> standingRules(const string &username, const string &status) const;
+    bool reviewStandingRule(uint32_t id, const string &status);
+    bool endStandingRule(uint32_t id, const string &username, int fromDate);
+    bool cancelOccurrence(uint32_t id, const string &username, int date);
+    string materializeOccurrence(uint32_t id, const string &username, int date, const string &status);
+    bool usesStore() const;
+    string storeStats() const;
+    void setChangeLog(function<void(const string &)> sink);
+    string logSnapshot(const function<void()> &mark);
+    void applyChanges(const vector<LogChange> &changes);
+    void replaceReservations(const vector<Reservation> &rows);
+    void replaceStandingRules(vector<StandingRule> newRules);
+    vector<Reservation> searchGuests(const string &text, size_t limit = 10);
+    CustomerHistory customerHistory(const string &username) const;
+    void setRequestKeyLimits(size_t maxKeys, int ttlSeconds);
+    BookFootprint footprint() const;
+    OverbookingAudit auditOverbooking(bool includeArchived) const;
+    size_t displayAudit(const OverbookingAudit &audit, size_t offset = 0, size_t limit = ALL_ROWS) const;
+};
+
+// Function to check if text is exactly count digits
+bool isDigits(const string &text, size_t count);
+
+// Function to check a Maya or GCash account number (09XXXXXXXXX)
+bool isValidWalletAccount(const string &accountNo);
+
+// Function to check a card expiry date (MM/YYYY)
+bool isValidExpiry(const string &expiry);
+
+// Struct to hold the result of a payment strategy (messages are literals so nothing is allocated)
+struct PaymentResult
+{
+    bool accepted;
+    const char *message;
+};
+
+class Maya;
+class GCash;
+class Card;
+
+// Typed payment requests; each names the strategy that handles it
+struct MayaRequest
+{
+    using Strategy = Maya;
+    string accountNo, authCode;
+};
+
+struct GCashRequest
+{
+    using Strategy = GCash;
+    string accountNo, authCode;
+};
+
+struct CardRequest
+{
+    using Strategy = Card;
+    string cardNo, name, expiry, cvv;
+};
+
+// Closed set of payment methods; dispatch is resolved at compile time with std::visit
+using PaymentMethod = variant<MayaRequest, GCashRequest, CardRequest>;
+
+// Payment strategy for Maya
+class Maya
+{
+public:
+    static const char *label() { return "Maya"; }
+
+    PaymentResult paymentMethod(const MayaRequest &request) const
+    {
+        if (!isValidWalletAccount(request.accountNo))
+            return {false, "Invalid Maya account number."};
+        if (!isDigits(request.authCode, 6))
+            return {false, "Invalid Maya authentication code."};
+        return {true, "Payment successful via Maya."};
+    }
+};
+
+// Payment strategy for GCash
+class GCash
+{
+public:
+    static const char *label() { return "GCash"; }
+
+    PaymentResult paymentMethod(const GCashRequest &request) const
+    {
+        if (!isValidWalletAccount(request.accountNo))
+            return {false, "Invalid GCash account number."};
+        if (!isDigits(request.authCode, 6))
+            return {false, "Invalid GCash authentication code."};
+        return {true, "Payment successful via GCash."};
+    }
+};
+
+// Payment strategy for credit and debit cards
+class Card
+{
+public:
+    static const char *label() { return "Credit / Debit Card"; }
+
+    PaymentResult paymentMethod(const CardRequest &request) const
+    {
+        if (!isDigits(request.cardNo, 16))
+            return {false, "Invalid card number."};
+        if (request.name.empty())
+            return {false, "Cardholder's name cannot be empty."};
+        if (!isValidExpiry(request.expiry))
+            return {false, "Invalid expiry date."};
+        if (!isDigits(request.cvv, 3))
+            return {false, "Invalid CVV."};
+        return {true, "Payment successful via Credit/Debit Card."};
+    }
+};
+
+// Singleton class for payment processing; it holds no state, so any thread may use it
+class Payment
+{
+private:
+    Payment() {}
+
+public:
+    Payment(const Payment &) = delete;
+    Payment &operator=(const Payment &) = delete;
+
+    static Payment *getInstance()
+    {
+        static Payment instance; // Initialized once, safely, on first use
+        return &instance;
+    }
+
+    // Runs the strategy that matches the request type
+    PaymentResult executePayment(const PaymentMethod &method) const
+    {
+        return visit([](const auto &request)
+                     {
+                         using Strategy = typename decay_t<decltype(request)>::Strategy;
+                         return Strategy().paymentMethod(request); },
+                     method);
+    }
+
+    // Name of the payment method as written to settled_reservations.txt
+    static const char *label(const PaymentMethod &method)
+    {
+        return visit([](const auto &request)
+                     { return decay_t<decltype(request)>::Strategy::label(); },
+                     method);
+    }
+};
+
+// Struct to describe a payment that settles a reservation
+struct PaymentRequest
+{
+    string reservationId;
+    string username;
+    PaymentMethod method;
+    string idempotencyKey; // Requests with the same key are one payment
+};
+
+// Struct to hold how a payment ended
+struct PaymentOutcome
+{
+    string reservationId;
+    string username;
+    bool settled = false;
+    int attempts = 0;
+    string message;
+};
+
+// Replies a payment gateway can give to an authorization
+enum class GatewayReply
+{
+    Authorized,
+    Declined,    // Final: the payment was refused
+    Unavailable, // Transient: worth retrying
+    TimedOut     // Transient: no answer within the deadline
+};
+
+// Class to represent the payment gateway interface that authorizes payments. authorize runs on a payment worker and must
+// return by the deadline, with TimedOut if the gateway has not answered by then.
+class PaymentGateway
+{
+public:
+    virtual GatewayReply authorize(const PaymentRequest &request, chrono::steady_clock::time_point deadline) = 0;
+    virtual ~PaymentGateway() {}
+};
+
+// In-process stand-in for a real gateway with configurable latency and failure rates
+class MockPaymentGateway : public PaymentGateway
+{
+private:
+    int latencyMs, jitterMs;
+    double failureRate, declineRate;
+    mutex rngMutex;
+    mt19937 rng;
+
+public:
+    MockPaymentGateway(int latency, int jitter, double failure, double decline, unsigned seed = 12345)
+        : latencyMs(latency), jitterMs(jitter), failureRate(failure), declineRate(decline), rng(seed) {}
+
+    GatewayReply authorize(const PaymentRequest &, chrono::steady_clock::time_point deadline) override
+    {
+        int delay;
+        double roll;
+        {
+            lock_guard<mutex> lock(rngMutex);
+            delay = latencyMs + (jitterMs > 0 ? (int)(rng() % (unsigned)(jitterMs + 1)) : 0);
+            roll = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        }
+
+        if (chrono::steady_clock::now() + chrono::milliseconds(delay) > deadline)
+        {
+            this_thread::sleep_until(deadline);
+            return GatewayReply::TimedOut;
+        }
+        this_thread::sleep_for(chrono::milliseconds(delay));
+
+        if (roll < failureRate)
+            return GatewayReply::Unavailable;
+        if (roll < failureRate + declineRate)
+            return GatewayReply::Declined;
+        return GatewayReply::Authorized;
+    }
+};
+
+// Class to settle payments asynchronously: submit -> authorize with the gateway (with retries) -> commit the settlement.
+// Every attempt runs on one of the pool's workers, which shutdown (and the destructor) drains and joins, so the gateway only
+// has to outlive the pipeline.
+class PaymentPipeline
+{
+private:
+    struct Job
+    {
+        PaymentRequest request;
+        shared_ptr<promise<PaymentOutcome>> result;
+    };
+
+    PaymentGateway &gateway;
+    function<bool(const PaymentRequest &)> commitPayment;
+    size_t workerCount, queueCapacity;
+    int maxAttempts;
+    chrono::milliseconds attemptTimeout, baseBackoff;
+    int keySeconds;
+
+    mutex queueMutex;
+    condition_variable queueReady;
+    deque<Job> queue;
+    vector<thread> workers;
+    bool stopping = false;
+    unordered_map<string, shared_future<PaymentOutcome>> byKey; // In-flight and settled payments by idempotency key
+    deque<pair<time_t, string>> settledKeys; // When each settled key expires, oldest first
+
+    mutex noticesMutex;
+    vector<PaymentOutcome> notices; // Finished payments not yet shown to their user
+
+    // Authorizes a payment, retrying transient failures with exponential backoff
+    PaymentOutcome process(const PaymentRequest &request)
+    {
+        PaymentOutcome outcome;
+        outcome.reservationId = request.reservationId;
+        outcome.username = request.username;
+
+        PaymentResult checked = Payment::getInstance()->executePayment(request.method);
+        if (!checked.accepted)
+        {
+            outcome.message = "Payment for reservation ID " + request.reservationId + " was not accepted: " + checked.message;
+            return outcome;
+        }
+
+        chrono::milliseconds backoff = baseBackoff;
+        for (outcome.attempts = 1; outcome.attempts <= maxAttempts; outcome.attempts++)
+        {
+            GatewayReply reply = authorizeWithin(request);
+            if (reply == GatewayReply::Authorized)
+            {
+                outcome.settled = commitPayment(request);
+                outcome.message = outcome.settled ? "Payment for reservation ID " + request.reservationId + " has been settled successfully!"
+                                                  : "Payment for reservation ID " + request.reservationId + " was authorized, but the reservation is no longer approved.";
+                return outcome;
+            }
+            if (reply == GatewayReply::Declined)
+            {
+                outcome.message = "Payment for reservation ID " + request.reservationId + " was declined.";
+                return outcome;
+            }
+            if (outcome.attempts < maxAttempts)
+            {
+                this_thread::sleep_for(backoff);
+                backoff *= 2;
+            }
+        }
+        outcome.attempts = maxAttempts;
+        outcome.message = "Payment for reservation ID " + request.reservationId + " failed: the payment gateway did not respond. Please try again later.";
+        return outcome;
+    }
+
+    // Asks the gateway on this worker, giving it the attempt timeout as its deadline, so a slow gateway holds at most the
+    // pool's workers and never outlives shutdown
+    GatewayReply authorizeWithin(const PaymentRequest &request)
+    {
+        try
+        {
+            return gateway.authorize(request, chrono::steady_clock::now() + attemptTimeout);
+        }
+        catch (...)
+        {
+            return GatewayReply::Unavailable;
+        }
+    }
+
+    // Forgets settled keys older than keySeconds (caller holds queueMutex)
+    void expireKeys()
+    {
+        time_t now = engineClock().now();
+        while (!settledKeys.empty() && settledKeys.front().first <= now)
+        {
+            byKey.erase(settledKeys.front().second);
+            settledKeys.pop_front();
+        }
+    }
+
+    void workerLoop()
+    {
+        MemoryScope memory(MemoryTag::Payments);
+        while (true)
+        {
+            Job job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [&]
+                                { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return; // Stopping and drained
+                job = move(queue.front());
+                queue.pop_front();
+            }
+
+            PaymentOutcome outcome = process(job.request);
+            {
+                // Failed payments forget their key so the customer can try again; settled ones keep it for keySeconds
+                lock_guard<mutex> lock(queueMutex);
+                if (!outcome.settled)
+                    byKey.erase(job.request.idempotencyKey);
+                else
+                    settledKeys.emplace_back(engineClock().now() + keySeconds, job.request.idempotencyKey);
+            }
+            {
+                lock_guard<mutex> lock(noticesMutex);
+                notices.push_back(outcome);
+            }
+            job.result->set_value(outcome);
+        }
+    }
+
+public:
+    PaymentPipeline(PaymentGateway &gw, function<bool(const PaymentRequest &)> commit, size_t workersToStart = 4, size_t capacity = 256,
+                    int attempts = 4, chrono::milliseconds timeout = chrono::milliseconds(2000), chrono::milliseconds backoff = chrono::milliseconds(100),
+                    int keyLifetimeSeconds = 24 * 60 * 60)
+        : gateway(gw), commitPayment(move(commit)), workerCount(workersToStart), queueCapacity(capacity), maxAttempts(attempts),
+          attemptTimeout(timeout), baseBackoff(backoff), keySeconds(keyLifetimeSeconds) {}
+
+    ~PaymentPipeline() { shutdown(); }
+
+    // Queues a payment and returns its eventual outcome; a repeated idempotency key returns the original payment
+    shared_future<PaymentOutcome> submit(const PaymentRequest &request)
+    {
+        MemoryScope memory(MemoryTag::Payments);
+        lock_guard<mutex> lock(queueMutex);
+        expireKeys();
+        auto existing = byKey.find(request.idempotencyKey);
+        if (existing != byKey.end())
+            return existing->second;
+
+        if (stopping || queue.size() >= queueCapacity)
+        {
+            promise<PaymentOutcome> rejected;
+            rejected.set_value({request.reservationId, request.username, false, 0, "Payments are busy right now. Please try again later."});
+            return rejected.get_future().share();
+        }
+
+        if (workers.empty())
+        {
+            for (size_t i = 0; i < workerCount; i++)
+                workers.emplace_back(&PaymentPipeline::workerLoop, this);
+        }
+
+        Job job{request, make_shared<promise<PaymentOutcome>>()};
+        shared_future<PaymentOutcome> result = job.result->get_future().share();
+        byKey[request.idempotencyKey] = result;
+        queue.push_back(move(job));
+        queueReady.notify_one();
+        return result;
+    }
+
+    // Removes and returns the finished payments of a user
+    vector<PaymentOutcome> takeNotices(const string &username)
+    {
+        lock_guard<mutex> lock(noticesMutex);
+        vector<PaymentOutcome> mine;
+        auto others = stable_partition(notices.begin(), notices.end(), [&](const PaymentOutcome &outcome)
+                                       { return outcome.username == username; });
+        mine.assign(notices.begin(), others);
+        notices.erase(notices.begin(), others);
+        return mine;
+    }
+
+    // Finishes the queued payments and stops the workers
+    void shutdown()
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+        workers.clear();
+    }
+};
+
+// Reads a numeric setting from the environment, or returns fallback when it is not set
+double envSetting(const char *name, double fallback);
+
+} // namespace reserve_eat
+
+#endif // RESERVE_EAT_CORE_H
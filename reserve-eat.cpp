@@ -4,18 +4,42 @@
 Encapsulation, Inheritance, Polymorphism, and Abstraction. It also implements the Singleton and Strategy Pattern for the Payment class to ensure that only one
 instance of the payment method is created and used throughout the program. In generating reports, file handling is used for storing and retrieving settled reservation data. */
 
-#include <iostream>  // Used for input/output operations
-#include <vector>    // Used for dynamic array
-#include <string>    // Used for string manipulation
-#include <stdexcept> // Used for exception handling
-#include <iomanip>   // Used for formatting output
-#include <algorithm> // Used for various algorithmic operations
-#include <fstream>   // Used for file operations
-#include <ctime>     // Used for time-related functions
-#include <regex>     // Used for regular expressions and pattern matching within strings
-using namespace std; // Standard namespace
-
-const string STATUS[] = {"Pending", "Approved", "Settled", "Rejected"}; // 0, 1, 2, 3
+#include "reserve-eat-core.h" // Reservation engine, shared with the C interface
+#include <queue>              // Used for the simulator's event queue
+#ifndef _WIN32
+#define RESERVE_EAT_POSIX // UNIX domain sockets for --serve and for replicas (--ship, --replica)
+#include <poll.h>         // Used for the socket event loops
+#include <sys/socket.h>   // Used for the session and replication sockets
+#include <sys/un.h>       // Used for UNIX domain socket addresses
+#include <sys/resource.h> // Used for raising the open file limit
+#include <fcntl.h>        // Used for non-blocking sockets
+#include <unistd.h>       // Used for closing sockets
+#include <csignal>        // Used for stopping the servers
+#endif
+#if defined(__cpp_impl_coroutine) && defined(RESERVE_EAT_POSIX)
+#define RESERVE_EAT_SERVER // Session server for --serve; needs C++20 and POSIX sockets
+#include <coroutine>      // Used for session menus that suspend on input
+#include <utility>        // Used for handing over coroutine handles
+#endif
+using namespace std;         // Standard namespace
+using namespace reserve_eat; // Reservation engine
+
+#ifdef RESERVE_EAT_BENCH
+// Benchmark builds count every heap allocation so --bench can report allocations per operation
+atomic<size_t> allocationCount{0};
+
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void *memory = malloc(size ? size : 1))
+        return memory;
+    throw bad_alloc();
+}
+
+// Kept out of line so GCC does not pair inlined new-expressions with free() and warn
+[[gnu::noinline]] void operator delete(void *memory) noexcept { free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept { free(memory); }
+#endif
 
 // Struct to hold user information
 struct User
@@ -26,11 +50,15 @@ struct User
 
 vector<User> users; // Vector to hold user data
 
+// Accounts the load test logs in with; they live only as long as the server and are never written to users.txt
+const string TEST_ACCOUNT_PREFIX = "~LOADTEST";
+
 bool userExists(const string &username);                               // Function to check if a user exists
 bool authenticateUser(const string &username, const string &password); // Function to authenticate a user
 void registerUser(const string &username, const string &password);     // Function to register a new user
 void customerMenu(const string &username);                             // Function to display customer menu
 void adminMenu();
+string describeHistory(const string &username);                        // Function to summarize a user's booking history
 
 // Function to check if a user exists in the system
 bool userExists(const string &username)
@@ -61,6 +89,7 @@ bool authenticateUser(const string &username, const string &password)
 // Function to register a new user
 void registerUser(const string &username, const string &password)
 {
+    MemoryScope memory(MemoryTag::Users);
     users.push_back({username, password});
 }
 
@@ -68,21 +97,6 @@ void registerUser(const string &username, const string &password)
 void customerMenu(const string &username);
 void adminMenu();
 
-// Function to convert a string to uppercase
-string toUpperCase(string str)
-{
-    transform(str.begin(), str.end(), str.begin(), ::toupper);
-    return str;
-}
-
-// Function to convert a string to lowercase
-string toLowerCase(const string &str)
-{
-    string result = str;
-    transform(result.begin(), result.end(), result.begin(), ::tolower);
-    return result;
-}
-
 // Get a valid integer input
 int getValidInt(const string &prompt, int min, int max)
 {
@@ -122,856 +136,633 @@ int getValidInt(const string &prompt, int min, int max)
     return value;
 }
 
-// Function to check if a string contains only digits
-bool isAllDigits(const string &str)
+// Saves user information
+void saveUsersToFile(const string &filename = "users.txt")
 {
-    for (char c : str)
+    MemoryScope memory(MemoryTag::Users);
+    ofstream file(filename);
+    if (!file)
     {
-        if (!isdigit(c))
-            return false;
+        cerr << "Error opening file for writing users.\n";
+        return;
     }
-    return true;
-}
-
-// Function to check if a date is valid
-bool isValidDate(const string &date)
-{
-    if (date.length() != 10 || date[2] != '-' || date[5] != '-')
-        return false;
-
-    string mm = date.substr(0, 2);
-    string dd = date.substr(3, 2);
-    string yyyy = date.substr(6, 4);
-
-    if (!isAllDigits(mm) || !isAllDigits(dd) || !isAllDigits(yyyy))
-        return false;
-
-    int month = stoi(mm);
-    int day = stoi(dd);
-    int year = stoi(yyyy);
-
-    // Get current year
-    time_t t = time(nullptr);
-    tm *now = localtime(&t);
-    int currentYear = now->tm_year + 1900;
-
-    // Disallow years before the current year
-    if (year < currentYear)
-        return false;
 
-    if (month < 1 || month > 12)
-        return false;
+    for (const auto &user : users)
+    {
+        if (user.username.rfind(TEST_ACCOUNT_PREFIX, 0) != 0)
+            file << user.username << ',' << user.password << '\n';
+    }
 
-    if (day < 1 || day > 31)
-        return false;
+    file.close();
+}
 
-    int daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
-        daysInMonth[1] = 29;
+// Outputs users' information
+void loadUsersFromFile(const string &filename = "users.txt")
+{
+    MemoryScope memory(MemoryTag::Users);
+    string data;
+    if (!readFile(filename, data))
+    {
+        cerr << "No existing user data found.\n";
+        return;
+    }
 
-    if (day > daysInMonth[month - 1])
-        return false;
+    // Each thread splits one newline-aligned chunk into username,password pairs
+    vector<pair<size_t, size_t>> ranges = splitForThreads(data);
+    vector<vector<User>> chunks(ranges.size());
+    runOnThreads(ranges.size(), [&](size_t c)
+                 {
+                     MemoryScope memory(MemoryTag::Users);
+                     forEachLine(data, ranges[c].first, ranges[c].second, [&](string_view line, size_t)
+                                 {
+                                     size_t comma = line.find(',');
+                                     if (comma != string_view::npos && comma + 1 < line.size())
+                                         chunks[c].push_back({string(line.substr(0, comma)), string(line.substr(comma + 1))}); }); });
 
-    return true;
+    users.clear(); // Optional: ensure no duplicates
+    size_t total = 0;
+    for (const auto &chunk : chunks)
+        total += chunk.size();
+    users.reserve(total);
+    for (auto &chunk : chunks)
+        move(chunk.begin(), chunk.end(), back_inserter(users));
 }
 
-// Function to check if a time is valid
-bool isValidTime24(const string &time)
+// Function to get a valid payment method input
+int getValidPaymentMethodInput()
 {
-    if (time.length() != 5 || time[2] != ':')
-        return false;
-
-    string hh = time.substr(0, 2);
-    string mm = time.substr(3, 2);
-
-    int hour, minute;
-    try
+    string input;
+    while (true)
     {
-        hour = stoi(hh);
-        minute = stoi(mm);
+        cout << "Select Payment Method:\n1. Maya\n2. GCash\n3. Card\nEnter your choice (Maya, GCash, Card): ";
+        getline(cin, input);
+        input = toUpperCase(input);
+
+        if (input == "MAYA")
+            return 1;
+        else if (input == "GCASH")
+            return 2;
+        else if (input == "CARD")
+            return 3;
+        else
+            cout << "Invalid payment method! Please enter one of the following: Maya, GCash, or Card.\n\n";
     }
-    catch (...)
+}
+
+// Reads a line until it passes the check, re-prompting with retryPrompt
+string readCheckedLine(const string &prompt, const string &retryPrompt, const function<bool(const string &)> &isValid)
+{
+    string input;
+    cout << prompt;
+    getline(cin, input);
+    while (!isValid(input))
     {
-        return false;
+        cout << retryPrompt;
+        getline(cin, input);
     }
-
-    if (hour < 0 || hour > 23)
-        return false;
-    if (minute < 0 || minute > 59)
-        return false;
-
-    return true;
+    return input;
 }
 
-// Function to add two hours to a 24-hour format time
-string addTwoHours24(const string &startTime)
+// Prompts for the details of the chosen payment method (1 = Maya, 2 = GCash, 3 = Card)
+PaymentMethod readPaymentDetails(int method)
 {
-    int hour = stoi(startTime.substr(0, 2));
-    int minute = stoi(startTime.substr(3, 2));
+    MemoryScope memory(MemoryTag::Payments);
+    auto sixDigits = [](const string &text)
+    { return isDigits(text, 6); };
 
-    hour += 2;
-    if (hour >= 24)
+    if (method == 1 || method == 2)
     {
-        hour -= 24; // Wrap around to the next day if needed
+        string wallet = method == 1 ? "Maya" : "GCash";
+        string accountNo = readCheckedLine("Enter " + wallet + " Account Number (09XXXXXXXXX): ", "Invalid account number! Please try again: ", isValidWalletAccount);
+        string authCode = readCheckedLine("Enter " + wallet + " Authentication Code (6 digits): ", "Invalid authentication code! Please try again: ", sixDigits);
+        if (method == 1)
+            return MayaRequest{accountNo, authCode};
+        return GCashRequest{accountNo, authCode};
     }
 
-    // Format back to HH:MM
-    stringstream ss;
-    ss << setw(2) << setfill('0') << hour << ":"
-       << setw(2) << setfill('0') << minute;
-    return ss.str();
+    CardRequest card;
+    card.cardNo = readCheckedLine("Enter Card Number (16 digits): ", "Invalid card number! Please try again: ", [](const string &text)
+                                  { return isDigits(text, 16); });
+    card.name = readCheckedLine("Enter Cardholder's Name: ", "Name cannot be empty! Please try again: ", [](const string &text)
+                                { return !text.empty(); });
+    card.expiry = readCheckedLine("Enter Expiry Date (MM/YYYY): ", "Invalid expiry date! Please try again: ", isValidExpiry);
+    card.cvv = readCheckedLine("Enter CVV (3 digits): ", "Invalid CVV! Please try again: ", [](const string &text)
+                               { return isDigits(text, 3); });
+    return card;
 }
 
-// Class to represent a reservation
-class Reservation
-{
-private:
-    string id, username, name, phoneNo, date, startTime, endTime, status;
-    int tablesReserved;
-
-public:
-    Reservation() : tablesReserved(0) {}
-    Reservation(string id, string username, string name, string phoneNo, int tablesReserved, string date, string startTime, string endTime, string status) : id(id), username(username), name(name), phoneNo(phoneNo), tablesReserved(tablesReserved), date(date), startTime(startTime), endTime(endTime), status(status) {}
+ReservationSystem rs; // Global instance of ReservationSystem
 
-    // 
-    string getID() const { return id; }
-    string getUsername() const { return username; }
-    string getName() const { return name; }
-    string getPhoneNo() const { return phoneNo; }
-    string getStatus() const { return status; }
-    int getTablesReserved() const { return tablesReserved; }
-    string getDate() const { return date; }
-    string getStartTime() const { return startTime; }
-    string getEndTime() const { return endTime; }
-    void setStatus(const string &newStatus) { status = newStatus; }
+// Mock payment gateway, tunable with RESERVE_EAT_GATEWAY_LATENCY_MS, _JITTER_MS, _FAILURE_RATE and _DECLINE_RATE
+MockPaymentGateway gateway((int)envSetting("RESERVE_EAT_GATEWAY_LATENCY_MS", 300), (int)envSetting("RESERVE_EAT_GATEWAY_JITTER_MS", 200),
+                           envSetting("RESERVE_EAT_GATEWAY_FAILURE_RATE", 0.05), envSetting("RESERVE_EAT_GATEWAY_DECLINE_RATE", 0.0));
 
-    
-    void editReservation(int tReserved, string dt, string stm, string etm)
-    {
-        tablesReserved = tReserved;
-        date = dt;
-        startTime = stm;
-        endTime = etm;
-    }
+// Payments are authorized in the background and committed with settlePayment
+PaymentPipeline payments(gateway, [](const PaymentRequest &request)
+                         { return rs.settlePayment(request.reservationId, Payment::label(request.method)); });
 
-    void displayReservations() const
-    {
-        cout << left << setw(20) << id << setw(30) << name << setw(20) << phoneNo
-             << setw(20) << tablesReserved << setw(15) << date << setw(15) << startTime
-             << setw(15) << endTime << setw(15) << status << endl;
-        cout << "==============================================================================================================================================================\n";
-    }
+// Kinds of customer requests that are metered per user
+enum class RequestKind
+{
+    Lookup,  // Availability checks and listings
+    Booking, // New reservations
 };
 
-// Class to represent the reservation system
-class ReservationSystem
+// Queues of the session server; admin requests go first and have slots kept back for them
+enum class Lane
 {
-private:
-    vector<Reservation> reservations;
-    int reservationCounter = 0;
+    Admin,
+    Customer,
+};
 
-public:
-    //  Reservation System methods
-    string generateID();
-    void logToFile(const string &logEntry);
-    void loadReservationsFromFile(const string &filename = "reservations.txt");
-    void saveReservationsToFile(const string &filename = "reservations.txt") const;
-    void addReservation(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date, const string &time);
-    int getAvailableTables(const string &date, const string &startTime, const string &endTime) const;
-    void editReservation(const string &id, const string &username);
-    void rejectReservation(const string &id);
-    void cancelReservation(const string &id);
-    void displayAll();
-    bool hasStatus(const string &status) const;
-    bool hasUserReservationWithStatus(const string &status, const string &username) const;
-    void displayByStatus(const string &status);
-    void displayUserReservations(const string &username);
-    void displayUserReservationByStatus(const string &status, const string &username);
-    string getStatus(const string &id) const;
-    void approveReservation(const string &id);
-    void settlePayment(const string &id, const string &paymentType);
-    bool exists(const string &id);
-    bool existsForUser(const string &id, const string &username) const;
-    bool isEmpty() const;
-    bool isUserReservationEmpty(const string &username) const;
+// Whether a request may run now; if not, the client should try again after retryAfterMs
+struct Admission
+{
+    bool admitted = true;
+    int retryAfterMs = 0;
 };
 
-// Saves user information
-void saveUsersToFile(const string &filename = "users.txt")
+// Admission control for the customer menus: a token bucket per user and kind of request, and a bounded count of
+// queued requests shared by everyone. Whatever does not fit is turned away with a retry time instead of waiting.
+// Only the menus ask it: before a customer's lookups, bookings and new standing reservations, and for a queue slot in the
+// admin lane before each admin action. The engine does not, so cancellations, edits, bulk imports and every call through
+// the C interface are not metered; a program embedding the engine limits its own callers.
+class AdmissionControl
 {
-    ofstream file(filename);
-    if (!file)
+private:
+    // Holds up to burst tokens and gains rate tokens per second
+    struct Bucket
     {
-        cerr << "Error opening file for writing users.\n";
-        return;
-    }
+        double tokens;
+        chrono::steady_clock::time_point refilled;
+    };
 
-    for (const auto &user : users)
+    struct Limit
     {
-        file << user.username << ',' << user.password << '\n';
-    }
+        double rate, burst;
+    };
 
-    file.close();
-}
+    mutex lock;
+    unordered_map<string, Bucket> buckets[2]; // Indexed by RequestKind
+    Limit limits[2];
+    size_t queueLimit, adminReserve;
+    size_t queued[2] = {0, 0}; // Indexed by Lane
+    size_t shed = 0, throttled = 0;
 
-// Outputs users' information
-void loadUsersFromFile(const string &filename = "users.txt")
-{
-    ifstream file(filename);
-    if (!file)
-    {
-        cerr << "No existing user data found.\n";
-        return;
-    }
+public:
+    AdmissionControl(double lookupsPerSecond, double lookupBurst, double bookingsPerMinute, double bookingBurst, size_t queueLimit, size_t adminReserve)
+        : limits{{lookupsPerSecond, lookupBurst}, {bookingsPerMinute / 60.0, bookingBurst}}, queueLimit(queueLimit), adminReserve(min(adminReserve, queueLimit)) {}
 
-    users.clear(); // Optional: ensure no duplicates
-    string line;
-    while (getline(file, line))
+    // Takes a token from the user's bucket for this kind of request
+    Admission throttle(const string &username, RequestKind kind)
     {
-        stringstream ss(line);
-        string username, password;
-        if (getline(ss, username, ',') && getline(ss, password))
+        lock_guard<mutex> guard(lock);
+        const Limit &limit = limits[(int)kind];
+        auto now = chrono::steady_clock::now();
+        auto it = buckets[(int)kind].try_emplace(username, Bucket{limit.burst, now}).first;
+        Bucket &bucket = it->second;
+        bucket.tokens = min(limit.burst, bucket.tokens + chrono::duration<double>(now - bucket.refilled).count() * limit.rate);
+        bucket.refilled = now;
+        if (bucket.tokens >= 1.0)
         {
-            users.push_back({username, password});
+            bucket.tokens -= 1.0;
+            return {};
         }
+        throttled++;
+        return {false, limit.rate > 0 ? (int)ceil((1.0 - bucket.tokens) / limit.rate * 1000.0) : 60000};
     }
 
-    file.close();
-}
-
-// Saves reservations 
-void ReservationSystem::saveReservationsToFile(const string &filename) const
-{
-    ofstream file(filename);
-    if (!file)
-    {
-        cerr << "Error opening reservation file for writing.\n";
-        return;
-    }
-
-    for (const auto &res : reservations)
+    // Takes a queue slot; customers cannot use the last adminReserve slots
+    Admission enqueue(Lane lane)
     {
-        file << res.getID() << ',' << res.getUsername() << ',' << res.getName() << ','
-             << res.getPhoneNo() << ',' << res.getTablesReserved() << ',' << res.getDate() << ','
-             << res.getStartTime() << ',' << res.getEndTime() << ',' << res.getStatus() << '\n';
+        lock_guard<mutex> guard(lock);
+        size_t total = queued[0] + queued[1];
+        if (total < (lane == Lane::Admin ? queueLimit : queueLimit - adminReserve))
+        {
+            queued[(int)lane]++;
+            return {};
+        }
+        shed++;
+        return {false, 50 + (int)(total / 16)}; // Roughly how long the queue ahead takes to drain
     }
 
-    file.close();
-}
-
-// Outputs reservation details
-void ReservationSystem::loadReservationsFromFile(const string &filename)
-{
-    ifstream file(filename);
-    if (!file)
+    // Gives back a slot taken by enqueue
+    void dequeue(Lane lane)
     {
-        cerr << "No existing reservation data found.\n";
-        return;
+        lock_guard<mutex> guard(lock);
+        queued[(int)lane]--;
     }
 
-    reservations.clear();
-    string line;
-    while (getline(file, line))
+    // Drops the buckets of users that have been quiet long enough to be full again
+    void forgetIdle()
     {
-        stringstream ss(line);
-        string id, username, name, phoneNo, date, startTime, endTime, status;
-        int tablesReserved;
-
-        string tablesStr;
-        if (getline(ss, id, ',') && getline(ss, username, ',') &&
-            getline(ss, name, ',') && getline(ss, phoneNo, ',') &&
-            getline(ss, tablesStr, ',') && getline(ss, date, ',') &&
-            getline(ss, startTime, ',') && getline(ss, endTime, ',') &&
-            getline(ss, status))
+        lock_guard<mutex> guard(lock);
+        auto now = chrono::steady_clock::now();
+        for (int kind = 0; kind < 2; kind++)
         {
-            tablesReserved = stoi(tablesStr);
-            reservations.emplace_back(id, username, name, phoneNo, tablesReserved, date, startTime, endTime, status);
+            double refillSeconds = limits[kind].rate > 0 ? limits[kind].burst / limits[kind].rate : 0;
+            for (auto it = buckets[kind].begin(); it != buckets[kind].end();)
+            {
+                if (limits[kind].rate > 0 && chrono::duration<double>(now - it->second.refilled).count() >= refillSeconds)
+                    it = buckets[kind].erase(it);
+                else
+                    ++it;
+            }
         }
     }
 
-    file.close();
-}
-
-// Implementation of generateID method
-string ReservationSystem::generateID()
-{
-    // Load counter from file
-    ifstream inFile("counter.txt");
-    if (inFile.is_open())
-    {
-        inFile >> reservationCounter;
-        inFile.close();
-    }
-
-    reservationCounter++; // Increment counter
-
-    // Save updated counter to file
-    ofstream outFile("counter.txt");
-    if (outFile.is_open())
+    // Counts of requests turned away, for the log
+    string stats()
     {
-        outFile << reservationCounter;
-        outFile.close();
+        lock_guard<mutex> guard(lock);
+        return to_string(throttled) + " throttled, " + to_string(shed) + " shed";
     }
+};
 
-    return to_string(reservationCounter);
-}
-
-// Implementation of recording logs to file
-void ReservationSystem::logToFile(const string &logEntry)
+// Message telling the user when to try again
+string retryLater(const Admission &admission)
 {
-    ofstream log("reservation_log.txt", ios::app); // Append mode
-    if (log.is_open())
-    {
-        time_t now = time(0);
-        string timestamp = ctime(&now);
-        timestamp.pop_back(); // Remove trailing newline
-        log << "[" << timestamp << "] " << logEntry << "\n";
-        log.close();
-    }
+    return "Too many requests right now. Please try again in " + to_string((admission.retryAfterMs + 999) / 1000) + " second(s).\n";
 }
 
-// Adds a reservation to the system
-void ReservationSystem::addReservation(const string &username, const string &name, const string &phoneNo, int tablesReserved, const string &date, const string &startTime)
-{
-    string endTime = addTwoHours24(startTime);
-    string id = generateID();
-    reservations.emplace_back(id, username, name, phoneNo, tablesReserved, date, startTime, endTime, STATUS[0]);
-    cout << "Reservation made successfully! Reservation ID: " << id << endl;
-}
+// Per-user limits and the server queue bound, tunable with RESERVE_EAT_LOOKUPS_PER_SECOND, _LOOKUP_BURST, _BOOKINGS_PER_MINUTE,
+// _BOOKING_BURST, _QUEUE_LIMIT and _ADMIN_RESERVE
+AdmissionControl admission(envSetting("RESERVE_EAT_LOOKUPS_PER_SECOND", 5), envSetting("RESERVE_EAT_LOOKUP_BURST", 20),
+                           envSetting("RESERVE_EAT_BOOKINGS_PER_MINUTE", 6), envSetting("RESERVE_EAT_BOOKING_BURST", 10),
+                           (size_t)envSetting("RESERVE_EAT_QUEUE_LIMIT", 1024), (size_t)envSetting("RESERVE_EAT_ADMIN_RESERVE", 64));
 
-// Available tables 
-int ReservationSystem::getAvailableTables(const string &date, const string &startTime, const string &endTime) const
+// Holds one of a lane's queue slots for as long as it lives; the console admin menu takes one per action, as the session
+// server does for every line it answers
+class LaneSlot
 {
-    int totalTables = 10;
-    int bookedTables = 0;
+private:
+    Lane lane;
+    Admission admitted;
 
-    for (const auto &res : reservations)
+public:
+    explicit LaneSlot(Lane lane) : lane(lane), admitted(admission.enqueue(lane)) {}
+    ~LaneSlot()
     {
-        if (res.getDate() == date && (res.getStatus() == STATUS[0] || res.getStatus() == STATUS[1] || res.getStatus() == STATUS[2]))
-        {
-            // Check for time overlap
-            if (!(endTime <= res.getStartTime() || startTime >= res.getEndTime()))
-            {
-                bookedTables += res.getTablesReserved();
-            }
-        }
+        if (admitted.admitted)
+            admission.dequeue(lane);
     }
+    LaneSlot(const LaneSlot &) = delete;
+    LaneSlot &operator=(const LaneSlot &) = delete;
 
-    return totalTables - bookedTables;
-}
+    const Admission &result() const { return admitted; }
+};
 
-// Enables the user to edit their reservation
-void ReservationSystem::editReservation(const string &id, const string &username)
+// Shows a listing one page at a time; showPage renders the page at the given offset and returns the total number of rows
+void browsePages(const function<size_t(size_t offset, size_t limit)> &showPage, const string &noun = "reservations")
 {
-    for (auto &res : reservations)
+    size_t offset = 0;
+    while (true)
     {
-        if (res.getID() == id && res.getUsername() == username)
-        {
-            // Only allow editing if status is "Pending"
-            if (res.getStatus() != "Pending")
-            {
-                cout << "Only reservations with 'Pending' status can be edited.\n";
-                return;
-            }
-
-            string newDate, newStartTime, newTR;
-            int newTablesReserved = res.getTablesReserved();
-            bool validTR = false;
-
-            do
-            {
-                cout << "Enter new date (MM-DD-YYYY): ";
-                getline(cin, newDate);
-                if (newDate.empty())
-                {
-                    cout << "Date cannot be empty! Please enter a valid date.\n";
-                }
-                else if (!isValidDate(newDate))
-                {
-                    cout << "Invalid date format or value! Please follow MM-DD-YYYY.\n";
-                    newDate.clear(); // Clear invalid input to retry
-                }
-            } while (newDate.empty() || !isValidDate(newDate));
-
-            if (newDate.empty())
-                newDate = res.getDate();
-
-            do
-            {
-                cout << "Enter new time (HH:MM | 24 hour format): ";
-                getline(cin, newStartTime);
-                if (newStartTime.empty())
-                {
-                    cout << "Time cannot be empty! Please enter a valid time.\n";
-                }
-                else if (!isValidTime24(newStartTime))
-                {
-                    cout << "Invalid time format or value! Please follow HH:MM | 24 hour format.\n";
-                    newStartTime.clear(); // Clear invalid input to retry
-                }
-            } while (newStartTime.empty() || !isValidTime24(newStartTime));
-            if (newStartTime.empty())
-                newStartTime = res.getStartTime();
+        size_t total = showPage(offset, PAGE_SIZE);
+        if (total <= PAGE_SIZE)
+            return;
 
-            string newEndTime = addTwoHours24(newStartTime);
-            int availableTablesForNewTime = getAvailableTables(newDate, newStartTime, newEndTime) + res.getTablesReserved();
+        size_t last = min(offset + PAGE_SIZE, total);
+        cout << "Showing " << offset + 1 << "-" << last << " of " << total << " " << noun << ".\n";
 
-            do
-            {
-                cout << "Enter new number of tables: ";
-                getline(cin, newTR);
-                if (newTR.empty())
-                {
-                    validTR = true; // Keep the existing value
-                }
-                else
-                {
-                    bool isValidNum = true;
-                    for (char c : newTR)
-                    {
-                        if (!isdigit(c))
-                        {
-                            isValidNum = false;
-                            break;
-                        }
-                    }
-                    if (!isValidNum)
-                    {
-                        cout << "Invalid input. Please enter a number.\n";
-                        continue;
-                    }
-                    int tempTables = stoi(newTR);
-                    if (tempTables > 0 && tempTables <= 10 && tempTables <= availableTablesForNewTime)
-                    {
-                        newTablesReserved = tempTables;
-                        validTR = true;
-                    }
-                    else
-                    {
-                        cout << "Invalid number of tables. Please enter a value between 1 and " << min(10, availableTablesForNewTime) << ".\n";
-                    }
-                }
-            } while (!validTR);
+        string input;
+        cout << "[N] Next page  [P] Previous page  [Q] Done: ";
+        getline(cin, input);
+        input = toUpperCase(input);
 
-            res.editReservation(newTablesReserved, newDate, newStartTime, newEndTime);
-            cout << "Reservation updated successfully!\n";
+        if (input == "N" && last < total)
+            offset += PAGE_SIZE;
+        else if (input == "P" && offset >= PAGE_SIZE)
+            offset -= PAGE_SIZE;
+        else if (input == "Q" || input.empty())
             return;
-        }
+        else
+            cout << "No more pages in that direction.\n";
     }
-
-    cout << "Reservation ID not found.\n";
 }
 
-// Identifies if a reservation with a specific status exists
-bool ReservationSystem::hasStatus(const string &status) const
+int getOptionalDateKey(const string &prompt, int fallback); // Defined with the query menu
+
+// Lets a user move their pending reservation to another date, time and number of tables; with reopen an approved one may
+// be moved too, and is only sent back for approval once the move is saved
+void editReservationMenu(const string &id, const string &username, bool reopen = false)
 {
-    for (const auto &res : reservations)
+    // Prompts run against a copy so writers are not held up while the user types; updateReservation checks it again
+    Reservation res;
+    if (!rs.resolve(rs.findHandle(id), res) || res.getUsername() != username)
     {
-        if (res.getStatus() == status)
-        {
-            return true;
-        }
+        cout << "Reservation ID not found.\n";
+        return;
+    }
+    if (res.getStatus() != STATUS[0] && !(reopen && res.getStatus() == STATUS[1]))
+    {
+        cout << "Only reservations with 'Pending' status can be edited.\n";
+        return;
     }
-    return false;
-}
 
-// Identifies if a user has a reservation with a specific status
-bool ReservationSystem::hasUserReservationWithStatus(const string &status, const string &username) const
-{
-    for (const auto &res : reservations)
+    string newDate, newStartTime, newTR;
+    int newTablesReserved = res.getTablesReserved();
+    bool validTR = false;
+
+    do
     {
-        if (res.getStatus() == status && res.getUsername() == username)
+        cout << "Enter new date (MM-DD-YYYY): ";
+        getline(cin, newDate);
+        if (newDate.empty())
         {
-            return true;
+            cout << "Date cannot be empty! Please enter a valid date.\n";
         }
-    }
-    return false;
-}
+        else if (!isValidDate(newDate))
+        {
+            cout << "Invalid date format or value! Please follow MM-DD-YYYY.\n";
+            newDate.clear(); // Clear invalid input to retry
+        }
+    } while (newDate.empty() || !isValidDate(newDate));
 
-// Displays all reservations with a specific status
-void ReservationSystem::displayByStatus(const string &status)
-{
-    cout << "ALL " << toUpperCase(status) << " RESERVATIONS" << endl;
-    cout << "==============================================================================================================================================================\n";
-    cout << left << setw(20) << "Reservation ID" << setw(30) << "Name" << setw(20) << "Phone Number"
-         << setw(20) << "Reserved Table" << setw(15) << "Date" << setw(15) << "Start Time"
-         << setw(15) << "End Time" << setw(15) << "Status" << endl;
-    cout << "--------------------------------------------------------------------------------------------------------------------------------------------------------------\n";
-    for (const auto &res : reservations)
+    do
     {
-        if (res.getStatus() == status)
+        cout << "Enter new time (HH:MM | 24 hour format): ";
+        getline(cin, newStartTime);
+        if (newStartTime.empty())
         {
-            res.displayReservations();
+            cout << "Time cannot be empty! Please enter a valid time.\n";
         }
-    }
-}
+        else if (!isValidTime24(newStartTime))
+        {
+            cout << "Invalid time format or value! Please follow HH:MM | 24 hour format.\n";
+            newStartTime.clear(); // Clear invalid input to retry
+        }
+    } while (newStartTime.empty() || !isValidTime24(newStartTime));
 
-// Displays all reservations for a specific user
-void ReservationSystem::displayUserReservations(const string &username)
-{
-    cout << "User: " << username << endl;
-    cout << "======================================================================== RESERVATIONS ========================================================================\n";
-    cout << left << setw(20) << "Reservation ID" << setw(30) << "Name" << setw(20) << "Phone Number"
-         << setw(20) << "Reserved Table" << setw(15) << "Date" << setw(15) << "Start Time"
-         << setw(15) << "End Time" << setw(15) << "Status" << endl;
-    cout << "--------------------------------------------------------------------------------------------------------------------------------------------------------------\n";
+    int newDay = dayNumber(dateKey(newDate));
+    rs.loadDates(keyFromDayNumber(newDay - 1), keyFromDayNumber(newDay + 1));
+    int availableTablesForNewTime = rs.getAvailableTables(newDate, newStartTime, addTwoHours24(newStartTime)) + res.getTablesReserved();
 
-    for (const auto &res : reservations)
+    do
     {
-        if (res.getUsername() == username)
-            res.displayReservations();
-    }
+        cout << "Enter new number of tables: ";
+        getline(cin, newTR);
+        if (newTR.empty())
+        {
+            validTR = true; // Keep the existing value
+        }
+        else if (!isAllDigits(newTR))
+        {
+            cout << "Invalid input. Please enter a number.\n";
+        }
+        else
+        {
+            int tempTables = stoi(newTR);
+            if (tempTables > 0 && tempTables <= 10 && tempTables <= availableTablesForNewTime)
+            {
+                newTablesReserved = tempTables;
+                validTR = true;
+            }
+            else
+            {
+                cout << "Invalid number of tables. Please enter a value between 1 and " << min(10, availableTablesForNewTime) << ".\n";
+            }
+        }
+    } while (!validTR);
+
+    string error = rs.updateReservation(id, username, newDate, newStartTime, newTablesReserved, reopen);
+    if (!error.empty())
+        cout << error << "\n";
+    else if (res.getStatus() == STATUS[1])
+        cout << "Reservation updated successfully! It is pending again until the new time is approved.\n";
+    else
+        cout << "Reservation updated successfully!\n";
 }
 
-// Displays all reservations for a specific user with a specific status
-void ReservationSystem::displayUserReservationByStatus(const string &status, const string &username)
+// Shows standing reservations with their next few dates
+void displayStandingRules(const vector<StandingRule> &rules)
 {
-    cout << "User: " << username << endl;
-    cout << "ALL " << toUpperCase(status) << " RESERVATIONS" << endl;
-    cout << "==============================================================================================================================================================\n";
-    cout << left << setw(20) << "Reservation ID" << setw(30) << "Name" << setw(20) << "Phone Number"
-         << setw(20) << "Reserved Table" << setw(15) << "Date" << setw(15) << "Start Time"
-         << setw(15) << "End Time" << setw(15) << "Status" << endl;
-    cout << "--------------------------------------------------------------------------------------------------------------------------------------------------------------\n";
-    for (const auto &res : reservations)
+    int today = todayKey();
+    for (const auto &rule : rules)
     {
-        if (res.getUsername() == username && res.getStatus() == status)
+        cout << "S" << rule.id << " | " << rule.username << " | " << rule.name << " | " << rule.phoneNo << " | " << rule.tables
+             << " table(s) every " << weekdayName(rule.weekday()) << " " << timeFromMinutes(rule.startMinute) << " - "
+             << timeFromMinutes(rule.startMinute + 120) << " from " << dateFromKey(rule.fromDate) << " to " << dateFromKey(rule.toDate)
+             << " | " << rule.status << "\n";
+
+        string upcoming;
+        int shown = 0;
+        for (int day = dayNumber(rule.fromDate); day <= dayNumber(rule.toDate) && shown < 4; day += 7)
         {
-            res.displayReservations();
+            int date = keyFromDayNumber(day);
+            if (date >= today && rule.occursOn(date))
+            {
+                upcoming += (shown++ ? ", " : "") + dateFromKey(date);
+            }
         }
+        cout << "    Next dates: " << (upcoming.empty() ? "none" : upcoming) << "\n";
     }
 }
 
-// Retrieves the status of a reservation by ID
-string ReservationSystem::getStatus(const string &id) const
+// Reads a standing reservation ID (S<n> or n) from the listed rules; returns 0 if the user cancels
+uint32_t getStandingRuleID(const vector<StandingRule> &rules)
 {
-    for (const auto &res : reservations)
+    string input;
+    while (true)
     {
-        if (res.getID() == id)
+        cout << "Enter Standing Reservation ID (or type 'cancel' to go back): ";
+        getline(cin, input);
+        if (toUpperCase(input) == "CANCEL")
+            return 0;
+        if (!input.empty() && toupper((unsigned char)input[0]) == 'S')
+            input.erase(0, 1);
+        uint32_t id = 0;
+        from_chars(input.data(), input.data() + input.size(), id);
+        for (const auto &rule : rules)
         {
-            return res.getStatus();
+            if (rule.id == id)
+                return id;
         }
+        cout << "Standing reservation does not exist! Please enter one of the IDs above.\n";
     }
-    return "";
 }
 
-// Displays all reservations in the system
-void ReservationSystem::displayAll()
+// Reads a date that a standing reservation still books
+int getOccurrenceDate(const StandingRule &rule)
 {
-    cout << "\n====================================================================== ALL RESERVATIONS ======================================================================\n";
-    cout << left << setw(20) << "Reservation ID" << setw(30) << "Name" << setw(20) << "Phone Number"
-         << setw(20) << "Reserved Table" << setw(15) << "Date" << setw(15) << "Start Time"
-         << setw(15) << "End Time" << setw(15) << "Status" << endl;
-    cout << "--------------------------------------------------------------------------------------------------------------------------------------------------------------\n";
-    for (const auto &res : reservations)
+    string date;
+    while (true)
     {
-        res.displayReservations();
+        cout << "Date (MM-DD-YYYY): ";
+        getline(cin, date);
+        if (isValidDate(date) && rule.occursOn(dateKey(date)))
+            return dateKey(date);
+        cout << "S" << rule.id << " does not book a table on that date! Please enter one of its dates.\n";
     }
 }
 
-// Enables the admin to approve a reservation
-void ReservationSystem::approveReservation(const string &id)
+// Standing reservations: the same booking every week, kept as one rule until a single date is changed
+void standingMenu(const string &username)
 {
-    for (auto &res : reservations)
+    while (true)
     {
-        if (res.getID() == id && res.getStatus() == STATUS[0]) // STATUS[0] = "Pending"
-        {
-            res.editReservation(res.getTablesReserved(), res.getDate(), res.getStartTime(), res.getEndTime()); // optional update
-            res.setStatus(STATUS[1]);                                                                          // STATUS[1] = "Approved"
+        cout << "\n======== STANDING RESERVATIONS ========\n[1] Create standing reservation\n[2] View standing reservations\n[3] Edit one date\n[4] Cancel one date\n[5] Pay for one date\n[6] End standing reservation\n[7] Back\n";
+        cout << "=======================================\n";
+        int choice = getValidInt("Enter choice: ", 1, 7);
+        cout << "\n";
+        if (choice == 7)
             return;
-        }
-    }
-    cout << "Reservation either not found or not pending.\n";
-}
-
-// Enables the admin to reject a reservation
-void ReservationSystem::rejectReservation(const string &id)
-{
-    for (auto &res : reservations)
-    {
-        if (res.getID() == id && res.getStatus() == STATUS[0]) // STATUS[0] = "Pending"
-        {
-            res.setStatus(STATUS[3]); // STATUS[3] = "Rejected"
-            return;
-        }
-    }
-    cout << "Reservation either not found or not pending.\n";
-}
 
-// Enables the user to settle payment for a reservation
-void ReservationSystem::settlePayment(const string &id, const string &paymentType)
-{
-    for (auto &res : reservations)
-    {
-        if (res.getID() == id && res.getStatus() == STATUS[1]) // STATUS[1] = "Approved"
+        if (choice == 1)
         {
-            res.setStatus(STATUS[2]); // STATUS[2] = "Settled"
-
-            // Log the settled reservation
-            ofstream logFile("settled_reservations.txt", ios::app);
-            if (logFile.is_open())
+            StandingRule rule;
+            rule.username = username;
+            string date, startTime;
+            do
             {
-                time_t now = time(0);
-                string dt = ctime(&now);
-                dt.pop_back(); // remove newline
-
-                logFile << "RESERVATION ID: " << res.getID()
-                        << " | Name: " << res.getName()
-                        << " | Phone: " << res.getPhoneNo()
-                        << " | Reserved Table: " << res.getTablesReserved()
-                        << " | Date: " << res.getDate()
-                        << " | Start Time: " << res.getStartTime()
-                        << " | End Time: " << res.getEndTime()
-                        << " | Status: Settled"
-                        << " | Payment Method: " << paymentType
-                        << " | Settled At: " << dt << endl;
-                logFile.close();
+                cout << "Name: ";
+                getline(cin, rule.name);
+                if (rule.name.empty())
+                    cout << "Input cannot be empty! Please enter a valid name.\n";
+                else if (!isValidName(rule.name))
+                    cout << "Invalid name! Please use at most " << MAX_NAME_LENGTH << " characters and no commas.\n";
+            } while (!isValidName(rule.name));
+            do
+            {
+                cout << "Phone Number (09XXXXXXXXX): ";
+                getline(cin, rule.phoneNo);
+                if (!isValidPhoneNo(rule.phoneNo))
+                    cout << "Invalid Contact Number! Please enter a valid contact number.\n";
+            } while (!isValidPhoneNo(rule.phoneNo));
+            do
+            {
+                cout << "First Date (MM-DD-YYYY): ";
+                getline(cin, date);
+                if (!isValidDate(date))
+                    cout << "Invalid date format or value! Please follow MM-DD-YYYY.\n";
+            } while (!isValidDate(date));
+            do
+            {
+                cout << "Start Time (HH:MM | 24 hour format): ";
+                getline(cin, startTime);
+                if (!isValidTime24(startTime))
+                    cout << "Invalid time format or value! Please follow HH:MM | 24 hour format.\n";
+            } while (!isValidTime24(startTime));
+            int weeks = getValidInt("Number of weeks: ", 1, StandingRule::MAX_WEEKS);
+            rule.tables = getValidInt("Number of Tables to reserve: ", 1, 10);
+            rule.fromDate = dateKey(date);
+            rule.toDate = keyFromDayNumber(dayNumber(rule.fromDate) + 7 * (weeks - 1));
+            rule.startMinute = minutesOfDay(startTime);
+
+            Admission booking = admission.throttle(username, RequestKind::Booking);
+            if (!booking.admitted)
+            {
+                cout << retryLater(booking);
+                continue;
             }
-
-            return;
-        }
-    }
-
-    cout << "Reservation must be approved before settling payment.\n";
-}
-
-// Enables the user to cancel a reservation
-void ReservationSystem::cancelReservation(const string &id)
-{
-    for (auto it = reservations.begin(); it != reservations.end(); ++it)
-    {
-        if (it->getID() == id)
-        {
-            reservations.erase(it);
-            return;
-        }
-    }
-}
-
-// Checks if a reservation with a specific ID exists
-bool ReservationSystem::exists(const string &id)
-{
-    for (const auto &res : reservations)
-    {
-        if (res.getID() == id)
-            return true;
-    }
-    return false;
-}
-
-// Checks if a reservation with a specific ID exists for a specific user
-bool ReservationSystem::existsForUser(const string &id, const string &username) const
-{
-    for (const auto &res : reservations)
-    {
-        if (res.getID() == id && res.getUsername() == username)
-            return true;
-    }
-    return false;
-}
-
-// Checks if the reservation system is empty
-bool ReservationSystem::isEmpty() const
-{
-    return reservations.empty();
-}
-
-// Checks if a user has any reservations
-bool ReservationSystem::isUserReservationEmpty(const string &username) const
-{
-    for (const auto &res : reservations)
-    {
-        if (res.getUsername() == username)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-// Class to represent the payment method strategy
-class PaymentMethod
-{
-public:
-    virtual void paymentMethod() = 0;
-    virtual ~PaymentMethod() {}
-};
-
-// Derived classes for different payment methods
-class Maya : public PaymentMethod
-{
-public:
-    void paymentMethod() override
-    {
-        string accountNo, authCode;
-        regex accRegex("^09\\d{9}$");
-        regex authRegex("^\\d{6}$");
-        cout << "Enter Maya Account Number (09XXXXXXXXX): ";
-        getline(cin, accountNo);
-        while (!regex_match(accountNo, accRegex))
-        {
-            cout << "Invalid account number! Please try again: ";
-            getline(cin, accountNo);
+            string error = rs.addStandingRule(rule);
+            if (!error.empty())
+                cout << error << " The standing reservation was not made.\n";
+            else
+                cout << "Standing reservation made every " << weekdayName(rule.weekday()) << " until " << dateFromKey(rule.toDate) << ". It is pending approval.\n";
+            continue;
         }
 
-        cout << "Enter Maya Authentication Code (6 digits): ";
-        getline(cin, authCode);
-        while (!regex_match(authCode, authRegex))
+        vector<StandingRule> rules = rs.standingRules(username, "");
+        if (rules.empty())
         {
-            cout << "Invalid authentication code! Please try again: ";
-            getline(cin, authCode);
+            cout << "No standing reservations.\n";
+            continue;
         }
+        displayStandingRules(rules);
+        if (choice == 2)
+            continue;
 
-        cout << "Payment successful via Maya.\n";
-    }
-};
-
-// Derived class for GCash payment method
-class GCash : public PaymentMethod
-{
-public:
-    void paymentMethod() override
-    {
-        string accountNo, authCode;
-        regex accRegex("^09\\d{9}$");
-        regex authRegex("^\\d{6}$");
-        cout << "Enter GCash Account Number (09XXXXXXXXX): ";
-        getline(cin, accountNo);
-        while (!regex_match(accountNo, accRegex))
+        uint32_t id = getStandingRuleID(rules);
+        if (id == 0)
         {
-            cout << "Invalid account number! Please try again: ";
-            getline(cin, accountNo);
+            cout << "Back to menu...\n";
+            continue;
         }
+        const StandingRule &rule = *find_if(rules.begin(), rules.end(), [&](const StandingRule &r)
+                                            { return r.id == id; });
 
-        cout << "Enter GCash Authentication Code (6 digits): ";
-        getline(cin, authCode);
-        while (!regex_match(authCode, authRegex))
+        if (choice == 6)
         {
-            cout << "Invalid authentication code! Please try again: ";
-            getline(cin, authCode);
+            int from = getOptionalDateKey("Stop booking from date (MM-DD-YYYY, blank for today): ", todayKey());
+            if (rs.endStandingRule(id, username, from))
+                cout << "S" << id << " no longer books tables from " << dateFromKey(from) << ".\n";
+            continue;
         }
 
-        cout << "Payment successful via GCash.\n";
-    }
-};
-
-// Derived class for Card payment method
-class Card : public PaymentMethod
-{
-public:
-    void paymentMethod() override
-    {
-        string cardNo, name, expiry, cvv;
-        regex cardRegex("^\\d{16}$");
-        regex expiryRegex("^(0[1-9]|1[0-2])/\\d{4}$");
-        regex cvvRegex("^\\d{3}$");
-
-        cout << "Enter Card Number (16 digits): ";
-        getline(cin, cardNo);
-        while (!regex_match(cardNo, cardRegex))
+        if (rule.status == STATUS[3])
         {
-            cout << "Invalid card number! Please try again: ";
-            getline(cin, cardNo);
+            cout << "S" << id << " was rejected.\n";
+            continue;
         }
+        int date = getOccurrenceDate(rule);
 
-        cout << "Enter Cardholder's Name: ";
-        getline(cin, name);
-        while (name.empty())
+        if (choice == 3)
         {
-            cout << "Name cannot be empty! Please try again: ";
-            getline(cin, name);
+            // The date becomes a regular reservation with the rule's status; it only goes back to Pending if the edit is saved
+            string reservationID;
+            try
+            {
+                reservationID = rs.materializeOccurrence(id, username, date, rule.status);
+            }
+            catch (const exception &e)
+            {
+                cout << "The booking could not be saved: " << e.what() << endl;
+                continue;
+            }
+            if (reservationID.empty())
+                cout << "That date can no longer be edited.\n";
+            else
+            {
+                cout << "The booking on " << dateFromKey(date) << " is now reservation ID " << reservationID << ".\n";
+                editReservationMenu(reservationID, username, true);
+            }
         }
-
-        cout << "Enter Expiry Date (MM/YYYY): ";
-        getline(cin, expiry);
-        while (!regex_match(expiry, expiryRegex))
+        else if (choice == 4)
         {
-            cout << "Invalid expiry date! Please try again: ";
-            getline(cin, expiry);
+            if (rs.cancelOccurrence(id, username, date))
+                cout << "S" << id << " will not book a table on " << dateFromKey(date) << ".\n";
         }
-
-        cout << "Enter CVV (3 digits): ";
-        getline(cin, cvv);
-        while (!regex_match(cvv, cvvRegex))
+        else if (choice == 5)
         {
-            cout << "Invalid CVV! Please try again: ";
-            getline(cin, cvv);
+            if (rule.status != STATUS[1])
+            {
+                cout << "S" << id << " is not approved yet.\n";
+                continue;
+            }
+            string reservationID;
+            try
+            {
+                reservationID = rs.materializeOccurrence(id, username, date, STATUS[1]);
+            }
+            catch (const exception &e)
+            {
+                cout << "The booking could not be saved: " << e.what() << endl;
+                continue;
+            }
+            if (!reservationID.empty())
+                cout << "The booking on " << dateFromKey(date) << " is now reservation ID " << reservationID << ". Settle it with [5] Settle Payment.\n";
         }
-
-        cout << "Payment successful via Credit/Debit Card.\n";
-    }
-};
-
-// Singleton class for payment processing
-class Payment
-{
-private:
-    static Payment *instance;
-    PaymentMethod *strategy;
-
-    Payment() : strategy(nullptr) {}
-    ~Payment() { delete strategy; }
-
-public:
-    static Payment *getInstance()
-    {
-        if (!instance)
-            instance = new Payment();
-        return instance;
-    }
-
-    void setStrategy(PaymentMethod *method)
-    {
-        if (strategy != nullptr)
-            delete strategy;
-        strategy = method;
-    }
-
-    void executePayment()
-    {
-        if (strategy)
-            return strategy->paymentMethod();
-        else
-            cout << "No payment method selected.";
-    }
-};
-
-Payment *Payment::instance = nullptr; // Singleton instance
-
-// Function to get a valid payment method input
-int getValidPaymentMethodInput()
-{
-    string input;
-    while (true)
-    {
-        cout << "Select Payment Method:\n1. Maya\n2. GCash\n3. Card\nEnter your choice (Maya, GCash, Card): ";
-        getline(cin, input);
-        input = toUpperCase(input);
-
-        if (input == "MAYA")
-            return 1;
-        else if (input == "GCASH")
-            return 2;
-        else if (input == "CARD")
-            return 3;
-        else
-            cout << "Invalid payment method! Please enter one of the following: Maya, GCash, or Card.\n\n";
     }
 }
 
-ReservationSystem rs; // Global instance of ReservationSystem
-
 // Customer Menu
 void customerMenu(const string &username)
 {
     int choice;
     bool condition = true;
+    rs.loadUser(username); // Older reservations of this user are read in once
 
     while (condition)
     {
-        cout << "\n=========== CUSTOMER MENU ===========\n[1] Make reservation\n[2] Edit reservation\n[3] View Reservation\n[4] Cancel reservation\n[5] Settle Payment\n[6] Log out\n";
+        for (const auto &outcome : payments.takeNotices(username))
+            cout << "\n" << outcome.message << "\n";
+        for (const auto &message : rs.takeNotices(username))
+            cout << "\n" << message << "\n";
+
+        cout << "\n=========== CUSTOMER MENU ===========\n[1] Make reservation\n[2] Edit reservation\n[3] View Reservation\n[4] Cancel reservation\n[5] Settle Payment\n[6] Standing Reservations\n[7] Log out\n";
         cout << "=====================================\n";
-        choice = getValidInt("Enter choice: ", 1, 6);
+        choice = getValidInt("Enter choice: ", 1, 7);
         cout << "\n";
 
         switch (choice)
@@ -980,7 +771,7 @@ void customerMenu(const string &username)
         case 1:
         {
             string name, phoneNo, date, startTime, confirm;
-            bool isValidPhoneNo = false, isValidGC = false;
+            bool validPhoneNo = false, isValidGC = false;
             int tablesNeeded;
 
             cout << "\n=========================== MAKE RESERVATION ===========================\n";
@@ -1023,7 +814,11 @@ void customerMenu(const string &username)
                 {
                     cout << "Input cannot be empty! Please enter a valid name.\n";
                 }
-            } while (name.empty());
+                else if (!isValidName(name))
+                {
+                    cout << "Invalid name! Please use at most " << MAX_NAME_LENGTH << " characters and no commas.\n";
+                }
+            } while (!isValidName(name));
 
             do
             {
@@ -1033,15 +828,15 @@ void customerMenu(const string &username)
                 {
                     cout << "Input cannot be empty! Please enter a valid contact number.\n";
                 }
-                else if (phoneNo.length() != 11 || phoneNo[0] != '0' || phoneNo[1] != '9')
+                else if (!isValidPhoneNo(phoneNo))
                 {
                     cout << "Invalid Contact Number! Please enter a valid contact number.\n";
                 }
                 else
                 {
-                    isValidPhoneNo = true;
+                    validPhoneNo = true;
                 }
-            } while (!isValidPhoneNo);
+            } while (!validPhoneNo);
 
             do
             {
@@ -1073,6 +868,14 @@ void customerMenu(const string &username)
                 }
             } while (startTime.empty() || !isValidTime24(startTime));
 
+            Admission lookup = admission.throttle(username, RequestKind::Lookup);
+            if (!lookup.admitted)
+            {
+                cout << retryLater(lookup);
+                break;
+            }
+            int day = dayNumber(dateKey(date));
+            rs.loadDates(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1));
             int availableTables = rs.getAvailableTables(date, startTime, addTwoHours24(startTime)); // We need to implement this
 
             cout << "\nAvailable tables for " << date << " at " << startTime << " - " << addTwoHours24(startTime) << ": " << availableTables << " / 10\n";
@@ -1106,7 +909,25 @@ void customerMenu(const string &username)
                     } while (!validNumber);
 
                     cout << "========================================================================\n";
-                    rs.addReservation(username, name, phoneNo, tablesNeeded, date, startTime);
+                    Admission booking = admission.throttle(username, RequestKind::Booking);
+                    if (booking.admitted)
+                    {
+                        try
+                        {
+                            // The tables are counted again as the booking is made; a timer or replica feed may have taken them meanwhile
+                            string id = rs.tryAddReservation(username, name, phoneNo, tablesNeeded, date, startTime);
+                            if (id.empty())
+                                cout << "Sorry, those tables were just reserved by someone else. Please try again.\n";
+                            else
+                                cout << "Reservation made successfully! Reservation ID: " << id << endl;
+                        }
+                        catch (const exception &e)
+                        {
+                            cout << "The reservation could not be saved: " << e.what() << endl;
+                        }
+                    }
+                    else
+                        cout << retryLater(booking);
                 }
                 else if (cont.empty())
                 {
@@ -1176,7 +997,7 @@ void customerMenu(const string &username)
                 confirm = toUpperCase(confirm);
                 if (confirm == "Y")
                 {
-                    rs.editReservation(id, username);
+                    editReservationMenu(id, username);
                 }
                 else if (confirm == "N")
                 {
@@ -1203,7 +1024,9 @@ void customerMenu(const string &username)
                 cout << "No reservations to display.\n";
                 break;
             }
-            rs.displayUserReservations(username);
+            browsePages([&](size_t offset, size_t limit)
+                        { return rs.displayUserReservations(username, offset, limit); });
+            cout << describeHistory(username) << "\n";
             break;
         }
 
@@ -1351,40 +1174,17 @@ void customerMenu(const string &username)
                 if (confirm == "Y")
                 {
                     int method = getValidPaymentMethodInput();
-                    Payment *payment = Payment::getInstance();
+                    PaymentMethod details = readPaymentDetails(method);
 
-                    switch (method)
-                    {
-                    case 1:
-                        payment->setStrategy(new Maya());
-                        break;
-                    case 2:
-                        payment->setStrategy(new GCash());
-                        break;
-                    case 3:
-                        payment->setStrategy(new Card());
-                        break;
-                    }
                     cout << "Payment Processing...\n";
-                    payment->executePayment();
-                    cout << "\n";
-
-                    string paymentType;
-                    switch (method)
-                    {
-                    case 1:
-                        paymentType = "Maya";
-                        break;
-                    case 2:
-                        paymentType = "GCash";
-                        break;
-                    case 3:
-                        paymentType = "Credit / Debit Card";
+                    PaymentResult result = Payment::getInstance()->executePayment(details);
+                    cout << result.message << "\n\n";
+                    if (!result.accepted)
                         break;
 
-                        cout << "Payment for reservation ID " << id << " has been settled successfully!\n";
-                    }
-                    rs.settlePayment(id, paymentType);
+                    // Authorization continues in the background; the outcome is shown on the customer menu
+                    payments.submit({id, username, move(details), "settle-" + id});
+                    cout << "Payment for reservation ID " << id << " has been submitted. It will be marked Settled once the payment is authorized.\n";
                 }
 
                 else if (confirm == "N")
@@ -1405,7 +1205,14 @@ void customerMenu(const string &username)
             break;
         }
 
+        // Weekly bookings
         case 6:
+        {
+            standingMenu(username);
+            break;
+        }
+
+        case 7:
         {
             cout << "Logging out...\n\n";
             condition = false;
@@ -1415,155 +1222,2593 @@ void customerMenu(const string &username)
     }
 }
 
-// Admin menu
-void adminMenu()
+// Reads an optional MM-DD-YYYY date and returns its YYYYMMDD key, or fallback when left blank
+int getOptionalDateKey(const string &prompt, int fallback)
 {
-    int choice;
-    bool condition = true;
+    string input;
+    while (true)
+    {
+        cout << prompt;
+        getline(cin, input);
+        if (input.empty())
+            return fallback;
+        int key = dateKey(input);
+        if (isCalendarDate(key))
+            return key;
+        cout << "Invalid date! Please follow MM-DD-YYYY or leave it blank.\n";
+    }
+}
 
-    while (condition)
+// Reads an optional whole number, or returns fallback when left blank
+int getOptionalInt(const string &prompt, int fallback)
+{
+    string input;
+    while (true)
     {
-        cout << "\n================ ADMIN MENU ================\n[1] View All Reservations\n[2] Review Reservations \n[3] Log out\n";
-        cout << "============================================\n";
-        choice = getValidInt("Enter choice: ", 1, 3);
-        cout << "\n";
+        cout << prompt;
+        getline(cin, input);
+        if (input.empty())
+            return fallback;
+        if (input.size() <= 9 && isAllDigits(input))
+            return stoi(input);
+        cout << "Invalid input! Please enter a whole number or leave it blank.\n";
+    }
+}
 
-        switch (choice)
-        {
-            // View reservations
-        case 1:
+// Lets the admin filter, sort, group and count reservations
+void queryMenu()
+{
+    ReservationQuery query;
+    string input;
+
+    cout << "========================== QUERY RESERVATIONS ==========================\n";
+    cout << "Leave a field blank to match everything.\n";
+    query.fromDate = getOptionalDateKey("From date (MM-DD-YYYY): ", query.fromDate);
+    query.toDate = getOptionalDateKey("To date (MM-DD-YYYY): ", query.toDate);
+
+    while (true)
+    {
+        cout << "Statuses (e.g. Pending,Approved): ";
+        getline(cin, input);
+        if (input.empty())
+            break;
+
+        unsigned mask = 0;
+        bool valid = true;
+        stringstream ss(input);
+        string part;
+        while (getline(ss, part, ','))
         {
-            if (rs.isEmpty())
+            part.erase(remove(part.begin(), part.end(), ' '), part.end());
+            int code = -1;
+            for (int i = 0; i < 4; i++)
             {
-                cout << "No reservations to display.\n";
-                break;
+                if (toUpperCase(STATUS[i]) == toUpperCase(part))
+                    code = i;
             }
-            rs.displayAll();
+            if (code < 0)
+                valid = false;
+            else
+                mask |= 1u << code;
+        }
+        if (valid && mask != 0)
+        {
+            query.statusMask = mask;
             break;
         }
+        cout << "Invalid status! Use Pending, Approved, Settled or Rejected.\n";
+    }
 
-        // View pending & approve reservations
-        case 2:
+    cout << "Username: ";
+    getline(cin, query.username);
+    query.username = toUpperCase(query.username);
+    cout << "Name contains: ";
+    getline(cin, query.nameContains);
+    cout << "Phone number contains: ";
+    getline(cin, query.phoneContains);
+    query.minTables = getOptionalInt("Minimum tables reserved: ", query.minTables);
+    query.maxTables = getOptionalInt("Maximum tables reserved: ", query.maxTables);
+
+    while (true)
+    {
+        cout << "Group by (any of Date,Hour,User,Status): ";
+        getline(cin, input);
+        unsigned groupBy = 0;
+        bool valid = true;
+        stringstream ss(toUpperCase(input));
+        string part;
+        while (getline(ss, part, ','))
         {
-            if (rs.isEmpty())
-            {
-                cout << "No reservations to display.\n";
-                break;
-            }
+            part.erase(remove(part.begin(), part.end(), ' '), part.end());
+            if (part == "DATE")
+                groupBy |= GROUP_DATE;
+            else if (part == "HOUR")
+                groupBy |= GROUP_HOUR;
+            else if (part == "USER")
+                groupBy |= GROUP_USER;
+            else if (part == "STATUS")
+                groupBy |= GROUP_STATUS;
+            else if (!part.empty())
+                valid = false;
+        }
+        if (valid)
+        {
+            query.groupBy = groupBy;
+            break;
+        }
+        cout << "Invalid grouping! Use Date, Hour, User or Status.\n";
+    }
 
-            if (!rs.hasStatus(STATUS[0])) // STATUS[0] = "Pending"
+    if (query.groupBy == 0)
+    {
+        while (true)
+        {
+            cout << "Sort by (Date, Tables, Name, ID; add ' desc' for descending): ";
+            getline(cin, input);
+            input = toUpperCase(input);
+            query.descending = input.size() > 5 && input.compare(input.size() - 5, 5, " DESC") == 0;
+            if (query.descending)
+                input.erase(input.size() - 5);
+
+            if (input.empty() || input == "DATE")
+                query.sortBy = QuerySort::Date;
+            else if (input == "TABLES")
+                query.sortBy = QuerySort::Tables;
+            else if (input == "NAME")
+                query.sortBy = QuerySort::Name;
+            else if (input == "ID")
+                query.sortBy = QuerySort::ID;
+            else
             {
-                cout << "No pending reservations to display.\n";
-                break;
+                cout << "Invalid sort order! Use Date, Tables, Name or ID.\n";
+                continue;
             }
+            break;
+        }
+    }
 
-            rs.displayByStatus(STATUS[0]);
-
-            string id, action, confirm;
-            condition = true;
+    bool includeArchived = false;
+    while (true)
+    {
+        cout << "Include archived reservations? (Y/N): ";
+        getline(cin, input);
+        input = toUpperCase(input);
+        if (input == "Y" || input == "N")
+        {
+            includeArchived = input == "Y";
+            break;
+        }
+        cout << "Invalid input! Please enter Y or N only.\n";
+    }
 
+    rs.loadDates(query.fromDate, query.toDate);
+    QueryResult result = rs.runQuery(query, includeArchived);
+    if (result.matched == 0)
+    {
+        cout << "No reservations match the query.\n";
+        return;
+    }
+
+    if (query.groupBy != 0)
+    {
+        rs.displayQueryGroups(result, query.groupBy);
+        return;
+    }
+
+    browsePages([&](size_t offset, size_t limit)
+                { return rs.displayQueryRows(result, offset, limit); });
+    cout << result.matched << " matching reservation(s).\n";
+}
+
+// Imports reservations from a CSV file in the reservations.txt schema and writes a per-row report
+void importMenu()
+{
+    string filename;
+    do
+    {
+        cout << "CSV file to import (or type 'cancel' to go back): ";
+        getline(cin, filename);
+        if (filename.empty())
+            cout << "File name cannot be empty!\n";
+    } while (filename.empty());
+
+    if (toUpperCase(filename) == "CANCEL")
+    {
+        cout << "Import cancelled.\n";
+        return;
+    }
+
+    string data;
+    if (!readFile(filename, data))
+    {
+        cout << "Cannot open " << filename << ".\n";
+        return;
+    }
+
+    auto started = chrono::steady_clock::now();
+    ImportReport report = rs.bulkImport(data);
+    long long elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+
+    string out;
+    for (const auto &row : report.rows)
+    {
+        out += "Line " + to_string(row.line) + ": ";
+        out += row.error.empty() ? "ACCEPTED as reservation ID " + row.res.getID() : "REJECTED - " + row.error;
+        out += '\n';
+    }
+    ofstream reportFile("import_report.txt");
+    reportFile.write(out.data(), out.size());
+    reportFile.close();
+
+    ReservationRenderer renderer;
+    size_t shown = 0;
+    for (const auto &row : report.rows)
+    {
+        if (!row.error.empty() && shown++ < PAGE_SIZE)
+            renderer.appendLine("Line " + to_string(row.line) + ": REJECTED - " + row.error);
+    }
+    if (shown > PAGE_SIZE)
+        renderer.appendLine("... and " + to_string(shown - PAGE_SIZE) + " more rejected line(s).");
+    renderer.appendLine("Imported " + to_string(report.accepted) + " reservation(s), rejected " + to_string(report.rejected) +
+                        " in " + to_string(elapsed) + " ms. Full report written to import_report.txt.");
+    rs.logToFile("Bulk import from " + filename + ": " + to_string(report.accepted) + " accepted, " + to_string(report.rejected) + " rejected");
+}
+
+// Lets the admin approve or reject pending standing reservations
+void reviewStandingMenu()
+{
+    vector<StandingRule> rules = rs.standingRules("", STATUS[0]);
+    if (rules.empty())
+    {
+        cout << "No pending standing reservations to display.\n";
+        return;
+    }
+    displayStandingRules(rules);
+
+    uint32_t id = getStandingRuleID(rules);
+    if (id == 0)
+    {
+        cout << "Review cancelled. Returning to previous menu...\n";
+        return;
+    }
+
+    string action;
+    do
+    {
+        cout << "Approve or Reject S" << id << "? (A/R): ";
+        getline(cin, action);
+        action = toUpperCase(action);
+        if (action != "A" && action != "R")
+            cout << "Invalid input! Please enter A or R only.\n";
+    } while (action != "A" && action != "R");
+
+    if (rs.reviewStandingRule(id, action == "A" ? STATUS[1] : STATUS[3]))
+        cout << "Standing reservation S" << id << " has been " << (action == "A" ? "approved" : "rejected") << ".\n";
+}
+
+// Summarizes the booking history of a user in one line
+string describeHistory(const string &username)
+{
+    CustomerHistory history = rs.customerHistory(username);
+    string text = username + ": " + to_string(history.bookings) + " booking(s), " + to_string(history.settled) + " settled (" +
+                  to_string(history.tablesConsumed) + " table(s)), " + to_string(history.rejected) + " rejected, last visit ";
+    return text + (history.lastVisit ? dateFromKey(history.lastVisit) : "none");
+}
+
+// Lets the admin look guests up by part of their name, even misspelt, or part of their phone number, one query at a time
+void searchGuestsMenu()
+{
+    rs.loadDates(0, 99999999);
+    while (true)
+    {
+        string query;
+        cout << "Search name or phone number (blank to go back): ";
+        getline(cin, query);
+        if (query.empty())
+            return;
+
+        auto started = chrono::steady_clock::now();
+        vector<Reservation> matches = rs.searchGuests(query, PAGE_SIZE);
+        long long elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+
+        ReservationRenderer renderer;
+        if (matches.empty())
+        {
+            renderer.appendLine("No guests match \"" + query + "\".");
+            continue;
+        }
+        renderer.appendHeader();
+        set<string> usernames;
+        for (const auto &res : matches)
+        {
+            renderer.appendRow(res);
+            usernames.insert(res.getUsername());
+        }
+        for (const auto &username : usernames)
+            renderer.appendLine(describeHistory(username));
+        renderer.appendLine(to_string(matches.size()) + " best match(es) in " + to_string(elapsed) + " us.");
+    }
+}
+
+// Admin menu
+void adminMenu()
+{
+    int choice;
+    bool condition = true;
+
+    while (condition)
+    {
+        cout << "\n================ ADMIN MENU ================\n[1] View All Reservations\n[2] Review Reservations \n[3] Query Reservations\n[4] View Archived Reservations\n[5] Occupancy Report\n[6] Bulk Import Reservations\n[7] Overbooking Audit\n[8] Review Standing Reservations\n[9] Search Guests\n[10] Log out\n";
+        cout << "============================================\n";
+        choice = getValidInt("Enter choice: ", 1, 10);
+        cout << "\n";
+        LaneSlot slot(Lane::Admin);
+        if (!slot.result().admitted)
+        {
+            cout << retryLater(slot.result());
+            continue;
+        }
+
+        switch (choice)
+        {
+            // View reservations
+        case 1:
+        {
+            rs.loadDates(0, 99999999);
+            if (rs.isEmpty())
+            {
+                cout << "No reservations to display.\n";
+                break;
+            }
+            browsePages([](size_t offset, size_t limit)
+                        { return rs.displayAll(offset, limit); });
+            break;
+        }
+
+        // View pending & approve reservations
+        case 2:
+        {
+            rs.loadDates(0, 99999999);
+            if (rs.isEmpty())
+            {
+                cout << "No reservations to display.\n";
+                break;
+            }
+
+            if (!rs.hasStatus(STATUS[0])) // STATUS[0] = "Pending"
+            {
+                cout << "No pending reservations to display.\n";
+                break;
+            }
+
+            rs.displayByStatus(STATUS[0]);
+
+            string id, action, confirm;
+            condition = true;
+
+            do
+            {
+                cout << "Enter Reservation ID to review (or type 'cancel' to go back): ";
+                getline(cin, id);
+
+                if (id.empty())
+                {
+                    cout << "Reservation ID cannot be empty! Please enter a valid ID.\n";
+                }
+
+            } while (id.empty());
+
+            if (toUpperCase(id) == "CANCEL")
+            {
+                cout << "Review cancelled. Returning to previous menu...\n";
+                break;
+            }
+
+            if (!rs.exists(id))
+            {
+                cout << "Reservation with ID " << id << " does not exist.\n";
+                break;
+            }
+
+            if (rs.getStatus(id) != STATUS[0]) // Check if the status is "Pending"
+            {
+                cout << "Reservation ID " << id << " status is already updated.\n";
+                break;
+            }
+
+            do
+            {
+                cout << "Approve or Reject reservation ID " << id << "? : "; // Enter "Approve" or "Reject"
+                getline(cin, action);
+                action = toUpperCase(action);
+
+                if (action.empty())
+                {
+                    cout << "Review option cannot be empty! Please enter Approve or Reject.\n";
+                }
+                else if (action == "APPROVE" || action == "REJECT")
+                {
+                    do
+                    {
+                        cout << "Are you sure you want to " << toLowerCase(action) << " reservation ID " << id << "? (Y/N): ";
+                        getline(cin, confirm);
+                        confirm = toUpperCase(confirm);
+
+                        if (confirm == "Y")
+                        {
+                            if (!(action == "APPROVE" ? rs.approveReservation(id) : rs.rejectReservation(id)))
+                                cout << "Reservation either not found or not pending.\n";
+                            else if (action == "APPROVE")
+                                cout << "Reservation ID " << id << " has been approved successfully!\n";
+                            else
+                                cout << "Reservation ID " << id << " has been rejected.\n";
+                            break;
+                        }
+                        else if (confirm == "N")
+                        {
+                            cout << action << " cancelled.\n";
+                            break;
+                        }
+                        else
+                        {
+                            cout << "Invalid input! Please enter Y or N only.\n";
+                        }
+                    } while (confirm != "Y" && confirm != "N");
+
+                    break;
+                }
+                else
+                {
+                    cout << "Invalid input! Please enter Approve or Reject only.\n";
+                }
+
+            } while (condition);
+            break;
+        }
+
+        // Filter, sort, group and count reservations
+        case 3:
+        {
+            if (rs.isEmpty())
+            {
+                cout << "No reservations to query.\n";
+                break;
+            }
+            queryMenu();
+            break;
+        }
+
+        // View past settled and rejected reservations
+        case 4:
+        {
+            int fromDate = getOptionalDateKey("From date (MM-DD-YYYY, blank for earliest): ", 0);
+            int toDate = getOptionalDateKey("To date (MM-DD-YYYY, blank for latest): ", 99999999);
+            vector<Reservation> archived = rs.loadArchived(fromDate, toDate);
+            if (archived.empty())
+            {
+                cout << "No archived reservations in that range.\n";
+                break;
+            }
+            browsePages([&](size_t offset, size_t limit)
+                        { return rs.displayArchived(archived, offset, limit); });
+            break;
+        }
+
+        // Tables in use per date and hour
+        case 5:
+        {
+            int today = todayKey();
+            int fromDate = getOptionalDateKey("From date (MM-DD-YYYY, blank for today): ", today);
+            int toDate = getOptionalDateKey("To date (MM-DD-YYYY, blank for 30 days later): ", keyFromDayNumber(dayNumber(fromDate) + 30));
+            if (toDate < fromDate)
+            {
+                cout << "The end date must not be before the start date.\n";
+                break;
+            }
+            if (dayNumber(toDate) - dayNumber(fromDate) >= OccupancyReport::MAX_DAYS)
+            {
+                cout << "The report covers at most " << OccupancyReport::MAX_DAYS << " days. Please choose a shorter range.\n";
+                break;
+            }
+
+            rs.loadDates(keyFromDayNumber(dayNumber(fromDate) - 1), toDate); // The day before can run past midnight into the range
+            OccupancyReport report = rs.occupancy(fromDate, toDate, fromDate < today);
+            rs.displayOccupancy(report);
+
+            string confirm;
+            do
+            {
+                cout << "Export to occupancy_report.csv? (Y/N): ";
+                getline(cin, confirm);
+                confirm = toUpperCase(confirm);
+                if (confirm == "Y")
+                {
+                    if (rs.exportOccupancy(report))
+                        cout << "Occupancy report exported to occupancy_report.csv.\n";
+                    else
+                        cerr << "Error opening occupancy report for writing.\n";
+                }
+                else if (confirm != "Y" && confirm != "N")
+                    cout << "Invalid input! Please enter Y or N only.\n";
+            } while (confirm != "Y" && confirm != "N");
+            break;
+        }
+
+        // Import many reservations from a CSV file
+        case 6:
+        {
+            importMenu();
+            break;
+        }
+
+        // Find every time more tables are booked than the restaurant has
+        case 7:
+        {
+            string confirm;
             do
             {
-                cout << "Enter Reservation ID to review (or type 'cancel' to go back): ";
-                getline(cin, id);
+                cout << "Include archived reservations? (Y/N): ";
+                getline(cin, confirm);
+                confirm = toUpperCase(confirm);
+                if (confirm != "Y" && confirm != "N")
+                    cout << "Invalid input! Please enter Y or N only.\n";
+            } while (confirm != "Y" && confirm != "N");
+
+            auto started = chrono::steady_clock::now();
+            rs.loadDates(0, 99999999);
+            OverbookingAudit audit = rs.auditOverbooking(confirm == "Y");
+            long long elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+
+            cout << "Audited " << audit.scanned << " reservation(s) over " << audit.dates << " date(s) in " << elapsed << " ms.\n";
+            rs.logToFile("Overbooking audit: " + to_string(audit.intervals.size()) + " overbooked interval(s) in " + to_string(audit.scanned) + " reservation(s)");
+            if (audit.intervals.empty())
+            {
+                cout << "No overbooked intervals found.\n";
+                break;
+            }
+            browsePages([&](size_t offset, size_t limit)
+                        { return rs.displayAudit(audit, offset, limit); },
+                        "overbooked intervals");
+            cout << audit.intervals.size() << " overbooked interval(s) found.\n";
+            break;
+        }
+
+        // Approve or reject weekly bookings
+        case 8:
+        {
+            reviewStandingMenu();
+            break;
+        }
+
+        // Find guests by name or phone number
+        case 9:
+        {
+            searchGuestsMenu();
+            break;
+        }
+
+        // Back to main menu
+        case 10:
+        {
+            cout << "Logging out...\n\n";
+            condition = false;
+            return;
+        }
+        }
+    }
+}
+
+#ifdef RESERVE_EAT_BENCH
+// Measures time and heap allocations per call of the reservation scans on a synthetic book
+void runBenchmark(int count)
+{
+    string path = (filesystem::temp_directory_path() / "reserve-eat-bench.txt").string();
+    {
+        ofstream file(path);
+        const char *names[] = {"Katherine Anne Liwanag", "Zurinee Irish Belo", "Jane Allyson Paray", "Jhenelle Alonzo"};
+        for (int i = 1; i <= count; i++)
+        {
+            Reservation res(to_string(i), "WALKIN_CUSTOMER_" + to_string(i % 1000), names[i % 4], "09123456789", 1 + i % 3,
+                            dateFromKey(20300101 + i % 28), (i % 2 ? "18:00" : "20:00"), (i % 2 ? "20:00" : "22:00"), STATUS[i % 2 ? 0 : 1]);
+            file << formatReservationLine(res) << '\n';
+        }
+    }
+    ReservationSystem bench;
+    bench.loadReservationsFromFile(path);
+    filesystem::remove(path);
+
+    string lastID = to_string(count), user = "WALKIN_CUSTOMER_999", date = dateFromKey(20300115);
+    auto measure = [](const char *label, const function<void()> &operation)
+    {
+        const int rounds = 20;
+        size_t before = allocationCount.load();
+        auto started = chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++)
+            operation();
+        double elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count();
+        printf("%-32s %10.1f us/op %8.1f allocations/op\n", label, elapsed / rounds, (double)(allocationCount.load() - before) / rounds);
+    };
+
+    printf("%d reservations\n", count);
+    volatile long long sink = 0;
+    measure("hasStatus", [&]
+            { sink += bench.hasStatus(STATUS[2]); });
+    measure("hasUserReservationWithStatus", [&]
+            { sink += bench.hasUserReservationWithStatus(STATUS[2], user); });
+    measure("getStatus", [&]
+            { sink += bench.getStatus(lastID).size(); });
+    measure("exists", [&]
+            { sink += bench.exists(lastID); });
+    measure("existsForUser", [&]
+            { sink += bench.existsForUser(lastID, user); });
+    measure("isUserReservationEmpty", [&]
+            { sink += bench.isUserReservationEmpty("NOBODY"); });
+    measure("getAvailableTables", [&]
+            { sink += bench.getAvailableTables(date, "19:00", "21:00"); });
+    sink += bench.searchGuests("").size(); // Builds the guest index outside the measurement
+    measure("searchGuests (misspelt name)", [&]
+            { sink += bench.searchGuests("liwanog").size(); });
+    measure("searchGuests (partial phone)", [&]
+            { sink += bench.searchGuests("2345").size(); });
+}
+#endif
+
+#ifdef RESERVE_EAT_MEMPROFILE
+// Loads a book and its users and reports what they take up on the heap, per subsystem and per record
+void runMemoryReport(const string &reservationsPath, const string &usersPath)
+{
+    loadUsersFromFile(usersPath);
+    auto started = chrono::steady_clock::now();
+    rs.loadReservationsFromFile(reservationsPath);
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    BookFootprint book = rs.footprint();
+
+    printf("Loaded %zu reservation(s) from %s in %.0f ms and %zu user(s) from %s\n\n", book.rows, reservationsPath.c_str(), elapsed,
+           users.size(), usersPath.c_str());
+    printf("%-14s %14s %12s %14s %14s\n", "Subsystem", "Live bytes", "Live allocs", "Peak bytes", "Allocations");
+    for (int tag = 0; tag < MEMORY_TAGS; tag++)
+    {
+        MemoryUsage usage = memoryUsage((MemoryTag)tag);
+        printf("%-14s %14zu %12zu %14zu %14zu\n", memoryTagName((MemoryTag)tag), usage.liveBytes, usage.liveAllocations, usage.peakBytes,
+               usage.allocations);
+    }
+
+    MemoryUsage reservationsUse = memoryUsage(MemoryTag::Reservations), usersUse = memoryUsage(MemoryTag::Users);
+    if (book.rows > 0)
+    {
+        printf("\nPer reservation: %.1f bytes in %.2f live allocations (a row is %zu bytes; its eight strings point into %zu pooled strings)\n",
+               (double)reservationsUse.liveBytes / book.rows, (double)reservationsUse.liveAllocations / book.rows, sizeof(Reservation),
+               book.pooledStrings);
+        printf("Working copy: %zu of %zu rows used, %zu bytes reserved but unused across it and its slot arrays\n", book.rows,
+               book.rowCapacity, book.slackBytes);
+    }
+    if (!users.empty())
+        printf("Per user: %.1f bytes in %.2f live allocations (a User is %zu bytes; %zu bytes of the vector are unused)\n",
+               (double)usersUse.liveBytes / users.size(), (double)usersUse.liveAllocations / users.size(), sizeof(User),
+               (users.capacity() - users.size()) * sizeof(User));
+#ifdef RESERVE_EAT_POSIX
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("Peak RSS: %ld KB\n", (long)usage.ru_maxrss); // Kilobytes on Linux, bytes on macOS
+#endif
+}
+#endif
+
+// Kinds of events in a simulated year
+enum class SimEventKind
+{
+    Arrival, // A customer asks for a table
+    Edit,    // The customer moves a pending booking by an hour
+    Cancel,  // The customer calls it off
+    Review,  // The admin approves or rejects it
+    Visit,   // The party finishes dinner and pays, or never showed up
+    Night,   // Nightly archiving
+};
+
+// Struct to hold one scheduled event; ties in time go in the order they were scheduled, so runs repeat exactly
+struct SimEvent
+{
+    time_t at;
+    uint64_t sequence;
+    SimEventKind kind;
+    string id;       // Reservation the event is about, if any
+    string username;
+    bool outcome;    // Approve rather than reject, or pay rather than not show up
+
+    bool operator>(const SimEvent &other) const
+    {
+        return tie(at, sequence) > tie(other.at, other.sequence);
+    }
+};
+
+// Runs a virtual stretch of days of arrivals, edits, cancellations, reviews and visits through a fresh engine on a
+// virtual clock, as fast as the CPU allows, and reports throughput, occupancy and per-operation latency. The same seed
+// always makes the same bookings, so two builds or settings can be compared; the book and its logs live in a temporary
+// directory that is removed afterwards.
+void runSimulation(int days, unsigned seed, double arrivalsPerDay)
+{
+    filesystem::path previousDirectory = filesystem::current_path();
+    filesystem::path directory = filesystem::temp_directory_path() / ("reserve-eat-sim-" + to_string(seed));
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    filesystem::current_path(directory);
+
+    auto keyOf = [](time_t time)
+    {
+        tm local = localTime(time);
+        return (local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 + local.tm_mday;
+    };
+    auto timeAt = [](int key, int minute)
+    {
+        tm local{};
+        local.tm_year = key / 10000 - 1900;
+        local.tm_mon = key / 100 % 100 - 1;
+        local.tm_mday = key % 100;
+        local.tm_min = minute;
+        local.tm_isdst = -1;
+        return mktime(&local);
+    };
+    const int firstDate = 20300101;
+    time_t start = timeAt(firstDate, 0), end = timeAt(keyFromDayNumber(dayNumber(firstDate) + days), 0);
+    ManualClock clock(start);
+    setEngineClock(&clock);
+
+    mt19937_64 rng(seed);
+    auto chance = [&](double p)
+    { return uniform_real_distribution<double>(0, 1)(rng) < p; };
+    exponential_distribution<double> nextArrival(arrivalsPerDay / 86400.0);
+    exponential_distribution<double> leadDays(1.0 / 7);
+    exponential_distribution<double> reviewDelay(1.0 / (3 * 3600));
+    discrete_distribution<int> startHour({0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 5, 4, 2, 1, 1, 2, 5, 8, 6, 3}); // 11:00 to 21:00
+    discrete_distribution<int> partyTables({0, 50, 35, 15});
+
+    priority_queue<SimEvent, vector<SimEvent>, greater<SimEvent>> events;
+    uint64_t sequence = 0;
+    auto schedule = [&](time_t at, SimEventKind kind, const string &id = "", const string &username = "", bool outcome = false)
+    { events.push({at, sequence++, kind, id, username, outcome}); };
+    schedule(start + (time_t)nextArrival(rng), SimEventKind::Arrival);
+    for (int day = 0; day < days; day++)
+        schedule(timeAt(keyFromDayNumber(dayNumber(firstDate) + day), 3 * 60), SimEventKind::Night);
+
+    map<string, vector<double>> latencies; // Operation -> microseconds per call
+    map<string, size_t> counts;
+    auto timed = [&](const char *operation, const function<void()> &call)
+    {
+        auto started = chrono::steady_clock::now();
+        call();
+        latencies[operation].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - started).count());
+    };
+
+    size_t processed = 0;
+    auto started = chrono::steady_clock::now();
+    {
+        ReservationSystem book;
+        while (!events.empty() && events.top().at < end)
+        {
+            SimEvent event = events.top();
+            events.pop();
+            clock.set(event.at);
+            timed("timers", [&]
+                  { book.fireTimers(); });
+            processed++;
+
+            switch (event.kind)
+            {
+            case SimEventKind::Arrival:
+            {
+                schedule(event.at + 1 + (time_t)nextArrival(rng), SimEventKind::Arrival);
+                counts["arrivals"]++;
+                string username = "GUEST" + to_string(rng() % 2000);
+                int hour = startHour(rng), tables = partyTables(rng);
+                string startTime = (hour < 10 ? "0" : "") + to_string(hour) + (chance(0.5) ? ":00" : ":30");
+                int key = keyFromDayNumber(dayNumber(keyOf(event.at)) + (int)min(60.0, leadDays(rng)));
+                time_t when = timeAt(key, minutesOfDay(startTime));
+                if (when < event.at + 3600)
+                {
+                    key = keyFromDayNumber(dayNumber(key) + 1); // Too late for that day
+                    when = timeAt(key, minutesOfDay(startTime));
+                }
+                string date = dateFromKey(key);
+
+                int available = 0;
+                timed("availability", [&]
+                      { available = book.getAvailableTables(date, startTime, addTwoHours24(startTime)); });
+                if (available < tables)
+                {
+                    counts["turned away"]++;
+                    break;
+                }
+                string id;
+                timed("book", [&]
+                      { id = book.addReservation(username, "Guest " + username.substr(5), "09" + to_string(100000000 + rng() % 900000000), tables, date, startTime); });
+                counts["booked"]++;
+                timed("history", [&]
+                      { book.customerHistory(username); });
+
+                time_t until = when - event.at;
+                if (chance(0.10))
+                    schedule(event.at + (time_t)(until * uniform_real_distribution<double>(0, 0.5)(rng)), SimEventKind::Edit, id, username);
+                if (chance(0.08))
+                    schedule(event.at + (time_t)(until * uniform_real_distribution<double>(0, 1)(rng)), SimEventKind::Cancel, id, username);
+                schedule(event.at + (time_t)reviewDelay(rng), SimEventKind::Review, id, username, chance(0.92));
+                schedule(when + 2 * 3600 - 600, SimEventKind::Visit, id, username, chance(0.93));
+                break;
+            }
+            case SimEventKind::Edit:
+            {
+                Reservation res;
+                if (!book.resolve(book.findHandle(event.id), res))
+                    break;
+                int minutes = minutesOfDay(res.getStartTime()) + (chance(0.5) ? 60 : -60);
+                string error;
+                timed("edit", [&]
+                      { error = book.updateReservation(event.id, event.username, res.getDate(), timeFromMinutes(minutes), res.getTablesReserved()); });
+                counts[error.empty() ? "edited" : "edits refused"]++;
+                break;
+            }
+            case SimEventKind::Cancel:
+            {
+                bool cancelled = false;
+                timed("cancel", [&]
+                      { cancelled = book.cancelReservation(event.id); });
+                if (cancelled)
+                    counts["cancelled"]++;
+                break;
+            }
+            case SimEventKind::Review:
+            {
+                bool done = false;
+                timed("review", [&]
+                      { done = event.outcome ? book.approveReservation(event.id) : book.rejectReservation(event.id); });
+                counts[!done ? "not pending at review" : event.outcome ? "approved" : "rejected"]++;
+                break;
+            }
+            case SimEventKind::Visit:
+            {
+                if (!event.outcome)
+                {
+                    counts["no-shows"] += book.getStatus(event.id) == STATUS[1];
+                    break;
+                }
+                bool settled = false;
+                timed("settle", [&]
+                      { settled = book.settlePayment(event.id, "Cash"); });
+                if (settled)
+                    counts["settled"]++;
+                break;
+            }
+            case SimEventKind::Night:
+            {
+                timed("archive", [&]
+                      { book.archiveColdReservations(); });
+                break;
+            }
+            }
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        OccupancyReport occupancy = book.occupancy(firstDate, keyFromDayNumber(dayNumber(firstDate) + days - 1), true);
+        printf("Simulated %d day(s) from %s (seed %u, %.0f arrivals a day): %zu events in %.2f s, %.0f events/s\n", days,
+               dateFromKey(firstDate).c_str(), seed, arrivalsPerDay, processed, elapsed, processed / max(elapsed, 1e-9));
+        for (const auto &count : counts)
+            printf("  %-22s %8zu\n", count.first.c_str(), count.second);
+        printf("Occupancy: %.1f%% of table-hours in use, peak %d of %d table(s) on %s at %02d:00\n", occupancy.averageUtilization * 100,
+               occupancy.peakTables, TOTAL_TABLES, dateFromKey(keyFromDayNumber(dayNumber(firstDate) + occupancy.peakDay)).c_str(), occupancy.peakHour);
+        printf("\n%-14s %10s %10s %10s %10s %10s\n", "Operation", "Calls", "p50 us", "p99 us", "p99.9 us", "Max us");
+        for (auto &entry : latencies)
+        {
+            vector<double> &values = entry.second;
+            sort(values.begin(), values.end());
+            printf("%-14s %10zu %10.1f %10.1f %10.1f %10.1f\n", entry.first.c_str(), values.size(), values[values.size() / 2],
+                   values[values.size() * 99 / 100], values[values.size() * 999 / 1000], values.back());
+        }
+    }
+
+    setEngineClock(nullptr);
+    filesystem::current_path(previousDirectory);
+    filesystem::remove_all(directory);
+}
+
+// Runs regression checks of the engine against a book in a temporary directory and reports each one; returns false if
+// any failed. Each check is a case that once lost or corrupted reservations.
+bool runSelfTest()
+{
+    filesystem::path previousDirectory = filesystem::current_path();
+    filesystem::path directory = filesystem::temp_directory_path() / "reserve-eat-selftest";
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    filesystem::current_path(directory);
+    bool passed = true;
+    auto check = [&](const char *what, bool ok)
+    {
+        printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+        passed = passed && ok;
+    };
+
+    // Archiving rewrites the book while reservations older than the load window are still unloaded; they must be
+    // found again at their new place in the file
+    {
+        int today = todayKey();
+        auto line = [&](int id, const char *username, int days, const char *status)
+        {
+            return to_string(id) + ',' + username + ",Guest " + username + ",0917123456" + to_string(id) + ",2," +
+                   dateFromKey(keyFromDayNumber(dayNumber(today) + days)) + ",10:00,12:00," + status;
+        };
+        vector<string> rows = {line(1, "ALICE", -30, "Approved"), line(2, "BOB", -20, "Pending"), line(3, "CAROL", -2, "Settled"),
+                               line(4, "DAVE", 5, "Pending")};
+        {
+            ofstream file("reservations.txt");
+            for (const auto &row : rows)
+                file << row << '\n';
+        }
+        {
+            ReservationSystem book;
+            book.setLoadWindow(7);
+            book.loadReservationsFromFile("reservations.txt");
+            check("archiving moves the one settled reservation", book.archiveColdReservations(today) == 1);
+            check("an unloaded reservation can be approved after archiving", book.approveReservation("2"));
+            book.saveReservationsToFile("reservations.txt");
+        }
+        ReservationSystem reloaded;
+        reloaded.loadReservationsFromFile("reservations.txt");
+        vector<string> saved;
+        ReservationSnapshot snap = reloaded.snapshot();
+        for (const auto &res : snap)
+            saved.push_back(formatReservationLine(res));
+        sort(saved.begin(), saved.end());
+        vector<string> expected = {rows[0], line(2, "BOB", -20, "Approved"), rows[3]};
+        check("the saved book holds every other reservation once and intact", saved == expected);
+    }
+
+    filesystem::current_path(previousDirectory);
+    filesystem::remove_all(directory);
+    return passed;
+}
+
+#ifdef RESERVE_EAT_POSIX
+// Makes a socket return instead of blocking
+void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+// Lets the process hold as many sockets as the system allows
+void raiseFileLimit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Function to fill in the address of a UNIX domain socket, returns false if the path is too long
+bool unixAddress(const string &path, sockaddr_un &address)
+{
+    address = sockaddr_un{};
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Binds a non-blocking listening socket, replacing one left behind by an earlier run; returns -1 on failure
+int listenUnix(const string &path)
+{
+    sockaddr_un address;
+    if (!unixAddress(path, address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    unlink(path.c_str());
+    if (::bind(fd, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+// Connects a blocking socket to a listening one; returns -1 on failure
+int connectUnix(const string &path)
+{
+    sockaddr_un address;
+    if (!unixAddress(path, address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Function to get a monotonic time in milliseconds, for measuring how stale a replica is
+long long steadyMilliseconds()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+atomic<bool> serverStopping{false}; // Set by SIGINT/SIGTERM
+
+// Streams the change log of the book to read replicas (--ship). A replica that connects is sent a snapshot of the book,
+// then every change after it in order, each prefixed with its log sequence number (LSN):
+//   SNAPSHOT <lsn> <reservations> <rules>, then that many reservations.txt and standing.txt lines
+//   <lsn> PUT <reservations.txt line> | <lsn> DEL <id> | <lsn> RULES <count>, then that many standing.txt lines
+//   BEAT <sent> <latest>: everything up to LSN <sent> has been sent and the primary is at <latest>
+// One thread does all the sending, so writers only pay for formatting a record; a replica that falls more than
+// RESERVE_EAT_REPLICA_BACKLOG records behind is disconnected and starts over from a new snapshot when it reconnects.
+class LogShipper
+{
+private:
+    static const int HEARTBEAT_MS = 100;
+    static const size_t BATCH_BYTES = 256 * 1024; // Records copied to a replica's buffer at a time
+
+    struct Replica
+    {
+        int fd;
+        uint64_t next; // LSN of the first record not yet copied to out
+        string out;
+        size_t sent = 0;
+    };
+
+    ReservationSystem *book = nullptr;
+    mutex logMutex;              // Guards log, first, next and wakePending; taken after the book's locks
+    deque<string> log;           // Records some replica still needs; log.front() has LSN first
+    uint64_t first = 1, next = 1;
+    size_t backlogLimit = (size_t)envSetting("RESERVE_EAT_REPLICA_BACKLOG", 1 << 20);
+    bool wakePending = false;
+    atomic<size_t> connected{0}; // Records are only kept while a replica is connected
+    int listener = -1, wake[2] = {-1, -1};
+    string path;
+    vector<Replica> replicas;    // Only touched by the shipping thread
+    thread worker;
+    atomic<bool> stopping{false};
+
+    // Accepts a replica and queues the snapshot it starts from
+    void admit(int fd)
+    {
+        setNonBlocking(fd);
+        connected++;
+        uint64_t from = 0;
+        string snapshot = book->logSnapshot([&]()
+                                            {
+                                                lock_guard<mutex> lock(logMutex);
+                                                from = next;
+                                                if (log.empty())
+                                                    first = next; });
+        replicas.push_back({fd, from, "SNAPSHOT " + to_string(from - 1) + ' ' + snapshot});
+    }
+
+    void drop(size_t index)
+    {
+        close(replicas[index].fd);
+        replicas.erase(replicas.begin() + index);
+        connected--;
+    }
+
+    // Refills the buffers of replicas that sent everything they had and forgets records every replica has
+    void refill(bool beat)
+    {
+        lock_guard<mutex> lock(logMutex);
+        for (size_t i = replicas.size(); i-- > 0;)
+        {
+            Replica &replica = replicas[i];
+            if (replica.sent < replica.out.size())
+                continue;
+            if (replica.next < first)
+            {
+                drop(i); // The records it needs are gone
+                continue;
+            }
+            replica.out.clear();
+            replica.sent = 0;
+            bool copied = false;
+            while (replica.next < next && replica.out.size() < BATCH_BYTES)
+            {
+                replica.out += log[replica.next - first];
+                replica.next++;
+                copied = true;
+            }
+            if (copied || beat)
+                replica.out += "BEAT " + to_string(replica.next - 1) + ' ' + to_string(next - 1) + '\n';
+        }
+
+        uint64_t needed = next;
+        for (const auto &replica : replicas)
+            needed = min(needed, replica.next);
+        while (!log.empty() && (first < needed || log.size() > backlogLimit))
+        {
+            log.pop_front();
+            first++;
+        }
+    }
+
+    // Sends buffered records until every replica is done or its socket is full
+    void run()
+    {
+        vector<pollfd> fds;
+        long long lastBeat = steadyMilliseconds();
+        while (!stopping)
+        {
+            fds.assign({{listener, POLLIN, 0}, {wake[0], POLLIN, 0}});
+            for (const auto &replica : replicas)
+                fds.push_back({replica.fd, (short)(POLLIN | (replica.sent < replica.out.size() ? POLLOUT : 0)), 0});
+            poll(fds.data(), fds.size(), HEARTBEAT_MS);
+
+            if (fds[1].revents & POLLIN)
+            {
+                char drain[256];
+                while (read(wake[0], drain, sizeof(drain)) > 0)
+                    ;
+                lock_guard<mutex> lock(logMutex);
+                wakePending = false;
+            }
+            for (size_t i = replicas.size(); i-- > 0;)
+            {
+                // Replicas never send anything, so a readable socket means the replica hung up
+                char discard[256];
+                if ((fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) && read(replicas[i].fd, discard, sizeof(discard)) <= 0)
+                    drop(i);
+            }
+            if (fds[0].revents & POLLIN)
+            {
+                int fd;
+                while ((fd = accept(listener, nullptr, nullptr)) >= 0)
+                    admit(fd);
+            }
+
+            long long now = steadyMilliseconds();
+            bool beat = now - lastBeat >= HEARTBEAT_MS;
+            if (beat)
+                lastBeat = now;
+            refill(beat);
+            for (size_t i = replicas.size(); i-- > 0;)
+            {
+                Replica &replica = replicas[i];
+                while (replica.sent < replica.out.size())
+                {
+                    ssize_t written = write(replica.fd, replica.out.data() + replica.sent, replica.out.size() - replica.sent);
+                    if (written <= 0)
+                    {
+                        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                            drop(i);
+                        break;
+                    }
+                    replica.sent += written;
+                }
+            }
+        }
+    }
+
+public:
+    ~LogShipper()
+    {
+        stop();
+    }
+
+    // Listens for replicas and starts sending them every change made to rs from now on
+    bool start(const string &socketPath, ReservationSystem &rs)
+    {
+        listener = listenUnix(socketPath);
+        if (listener < 0 || pipe(wake) != 0)
+            return false;
+        setNonBlocking(wake[0]);
+        setNonBlocking(wake[1]);
+        path = socketPath;
+        book = &rs;
+        rs.setChangeLog([this](const string &record)
+                        { append(record); });
+        worker = thread(&LogShipper::run, this);
+        return true;
+    }
+
+    // Numbers a record and queues it for the replicas (called with the book's writeMutex or rulesMutex held)
+    void append(const string &record)
+    {
+        lock_guard<mutex> lock(logMutex);
+        if (log.empty())
+            first = next;
+        if (connected > 0)
+            log.push_back(to_string(next) + ' ' + record + '\n');
+        next++;
+        if (!wakePending)
+        {
+            wakePending = true;
+            if (write(wake[1], "!", 1) < 0)
+                wakePending = false;
+        }
+    }
+
+    // Stops shipping; replicas keep serving what they have until they count as stale
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        book->setChangeLog(nullptr);
+        stopping = true;
+        worker.join();
+        while (!replicas.empty())
+            drop(replicas.size() - 1);
+        close(listener);
+        close(wake[0]);
+        close(wake[1]);
+        unlink(path.c_str());
+    }
+
+    size_t replicaCount() const
+    {
+        return connected;
+    }
+};
+
+// Keeps a read-only copy of a primary's book (--replica): loads the snapshot the primary's log shipper sends and applies
+// each change after it, reconnecting and starting over from a new snapshot whenever the connection drops
+class LogFollower
+{
+private:
+    ReservationSystem *book = nullptr;
+    string primaryPath;
+    thread worker;
+    atomic<bool> stopping{false};
+    atomic<uint64_t> applied{0};      // LSN of the last change applied
+    atomic<long long> currentAt{-1};  // When the replica last had every change the primary had (-1 before the first snapshot)
+    size_t pendingRows = 0, pendingRules = 0; // Lines still to come of a snapshot or RULES record (reader thread only)
+    bool loadingSnapshot = false, rulesOnly = false;
+    vector<Reservation> snapshotRows;
+    vector<StandingRule> snapshotRules;
+
+    // Applies the complete lines of buffer and removes them; changes are batched into one version per read
+    void apply(string &buffer)
+    {
+        vector<LogChange> changes;
+        uint64_t last = applied;
+        auto flush = [&]()
+        {
+            if (!changes.empty())
+                book->applyChanges(changes);
+            changes.clear();
+            applied = last;
+        };
+
+        size_t start = 0, end;
+        while ((end = buffer.find('\n', start)) != string::npos)
+        {
+            string line = buffer.substr(start, end - start);
+            start = end + 1;
+            if (pendingRules > 0 || pendingRows > 0)
+            {
+                if (pendingRows > 0)
+                {
+                    snapshotRows.emplace_back();
+                    if (!parseReservationLine(line, snapshotRows.back()))
+                        snapshotRows.pop_back();
+                    pendingRows--;
+                }
+                else
+                {
+                    StandingRule rule;
+                    if (parseStandingRule(line, rule))
+                        snapshotRules.push_back(move(rule));
+                    pendingRules--;
+                }
+                if (pendingRows == 0 && pendingRules == 0)
+                    finishSnapshot();
+                continue;
+            }
+
+            istringstream fields(line);
+            string first, kind;
+            fields >> first;
+            if (first == "SNAPSHOT")
+            {
+                flush();
+                fields >> last >> pendingRows >> pendingRules;
+                loadingSnapshot = true;
+                snapshotRows.clear();
+                snapshotRules.clear();
+                rulesOnly = false;
+                if (pendingRows == 0 && pendingRules == 0)
+                    finishSnapshot();
+                continue;
+            }
+            if (first == "BEAT")
+            {
+                uint64_t sent = 0, latest = 0;
+                fields >> sent >> latest;
+                flush();
+                if (sent == latest && !loadingSnapshot)
+                    currentAt = steadyMilliseconds();
+                continue;
+            }
+
+            fields >> kind;
+            from_chars(first.data(), first.data() + first.size(), last);
+            size_t rest = first.size() + kind.size() + 2;
+            if (kind == "PUT")
+            {
+                changes.emplace_back();
+                if (rest > line.size() || !parseReservationLine(line.substr(rest), changes.back().res))
+                    changes.pop_back();
+            }
+            else if (kind == "DEL" && rest <= line.size())
+                changes.push_back({Reservation(), line.substr(rest)});
+            else if (kind == "RULES")
+            {
+                flush();
+                fields >> pendingRules;
+                rulesOnly = true;
+                snapshotRules.clear();
+                if (pendingRules == 0)
+                    finishSnapshot();
+            }
+        }
+        buffer.erase(0, start);
+        flush();
+    }
+
+    // Installs a snapshot, or the rule set of a RULES record, once all of its lines have arrived
+    void finishSnapshot()
+    {
+        if (!rulesOnly)
+            book->replaceReservations(snapshotRows);
+        book->replaceStandingRules(move(snapshotRules));
+        snapshotRows.clear();
+        snapshotRules.clear();
+        loadingSnapshot = rulesOnly = false;
+    }
+
+    void run()
+    {
+        string buffer;
+        char chunk[64 * 1024];
+        while (!stopping)
+        {
+            int fd = connectUnix(primaryPath);
+            if (fd < 0)
+            {
+                this_thread::sleep_for(chrono::milliseconds(500));
+                continue;
+            }
+            buffer.clear();
+            pendingRows = pendingRules = 0;
+            loadingSnapshot = rulesOnly = false;
+            while (!stopping)
+            {
+                pollfd pfd{fd, POLLIN, 0};
+                if (poll(&pfd, 1, 100) <= 0)
+                    continue;
+                ssize_t got = read(fd, chunk, sizeof(chunk));
+                if (got <= 0)
+                    break;
+                buffer.append(chunk, got);
+                apply(buffer);
+            }
+            close(fd);
+        }
+    }
+
+public:
+    ~LogFollower()
+    {
+        stop();
+    }
+
+    void start(const string &path, ReservationSystem &rs)
+    {
+        primaryPath = path;
+        book = &rs;
+        worker = thread(&LogFollower::run, this);
+    }
+
+    void stop()
+    {
+        stopping = true;
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // Milliseconds since the replica last had every change the primary had, or -1 if it has never loaded a snapshot
+    long long staleness() const
+    {
+        long long at = currentAt;
+        return at < 0 ? -1 : steadyMilliseconds() - at;
+    }
+
+    uint64_t position() const
+    {
+        return applied;
+    }
+};
+
+LogFollower replicaLog; // Feeds rs from the primary in --replica mode
+
+// Answers availability and listing queries from a replica's copy of the book (--replica), one line per request:
+//   AVAIL <MM-DD-YYYY> <HH:MM>  ->  OK <available tables> <staleness ms>
+//   LIST <username>             ->  OK <count> <staleness ms>, then that many reservations.txt lines
+// A replica more than RESERVE_EAT_MAX_STALENESS_MS behind answers STALE <staleness ms> instead, so the client can go to another
+// replica or the primary. Queries read snapshots, so applying the log never waits for them; throughput grows with replicas.
+class ReplicaServer
+{
+private:
+    struct Client
+    {
+        int fd;
+        string in, out;
+        size_t sent = 0;
+    };
+
+    const ReservationSystem &book;
+    const LogFollower &follower;
+    long long maxStaleness = (long long)envSetting("RESERVE_EAT_MAX_STALENESS_MS", 1000);
+    int listener = -1;
+    string path;
+    vector<Client> clients;
+
+    // Answers one request line
+    void answer(const string &line, string &out)
+    {
+        long long staleness = follower.staleness();
+        if (staleness < 0 || staleness > maxStaleness)
+        {
+            out += "STALE " + to_string(staleness) + '\n';
+            return;
+        }
+
+        istringstream fields(line);
+        string command, first, second;
+        fields >> command >> first >> second;
+        command = toUpperCase(command);
+        if (command == "AVAIL" && dateKey(first) >= 0 && minutesOfDay(second) >= 0)
+            out += "OK " + to_string(book.getAvailableTables(first, second, addTwoHours24(second))) + ' ' + to_string(staleness) + '\n';
+        else if (command == "LIST" && !first.empty())
+        {
+            first = toUpperCase(first);
+            string rows;
+            size_t count = 0;
+            ReservationSnapshot snap = book.snapshot();
+            for (const auto &res : snap)
+            {
+                if (res.getUsername() == first)
+                {
+                    (rows += formatReservationLine(res)) += '\n';
+                    count++;
+                }
+            }
+            out += "OK " + to_string(count) + ' ' + to_string(staleness) + '\n' + rows;
+        }
+        else
+            out += "ERR expected AVAIL <MM-DD-YYYY> <HH:MM> or LIST <username>\n";
+    }
+
+public:
+    ReplicaServer(const ReservationSystem &rs, const LogFollower &log) : book(rs), follower(log) {}
+
+    ~ReplicaServer()
+    {
+        for (auto &client : clients)
+            close(client.fd);
+        if (listener >= 0)
+        {
+            close(listener);
+            unlink(path.c_str());
+        }
+    }
+
+    bool listen(const string &socketPath)
+    {
+        listener = listenUnix(socketPath);
+        if (listener < 0)
+            return false;
+        path = socketPath;
+        raiseFileLimit();
+        return true;
+    }
+
+    // Serves queries until serverStopping is set
+    void run()
+    {
+        vector<pollfd> fds;
+        char chunk[16 * 1024];
+        while (!serverStopping)
+        {
+            fds.assign({{listener, POLLIN, 0}});
+            for (const auto &client : clients)
+                fds.push_back({client.fd, (short)(client.sent < client.out.size() ? POLLOUT : POLLIN), 0});
+            if (poll(fds.data(), fds.size(), 200) <= 0)
+                continue;
+
+            for (size_t i = clients.size(); i-- > 0;)
+            {
+                Client &client = clients[i];
+                short events = fds[i + 1].revents;
+                bool closed = events & (POLLHUP | POLLERR);
+                if (events & POLLIN)
+                {
+                    ssize_t got = read(client.fd, chunk, sizeof(chunk));
+                    closed = got <= 0;
+                    if (got > 0)
+                    {
+                        client.in.append(chunk, got);
+                        size_t start = 0, end;
+                        while ((end = client.in.find('\n', start)) != string::npos)
+                        {
+                            answer(client.in.substr(start, end - start), client.out);
+                            start = end + 1;
+                        }
+                        client.in.erase(0, start);
+                    }
+                }
+                while (!closed && client.sent < client.out.size())
+                {
+                    ssize_t written = write(client.fd, client.out.data() + client.sent, client.out.size() - client.sent);
+                    if (written <= 0)
+                    {
+                        closed = written < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+                        break;
+                    }
+                    client.sent += written;
+                }
+                if (client.sent == client.out.size())
+                {
+                    client.out.clear();
+                    client.sent = 0;
+                }
+                if (closed)
+                {
+                    close(client.fd);
+                    clients.erase(clients.begin() + i);
+                }
+            }
+
+            if (fds[0].revents & POLLIN)
+            {
+                int fd;
+                while ((fd = accept(listener, nullptr, nullptr)) >= 0)
+                {
+                    setNonBlocking(fd);
+                    clients.push_back({fd, "", ""});
+                }
+            }
+        }
+    }
+};
+
+// Sends availability queries to one or more replicas (comma-separated sockets) from several connections each for some
+// seconds and reports the queries answered per second
+void runReadTest(const string &socketList, int seconds, int connections)
+{
+    vector<string> paths;
+    stringstream list(socketList);
+    for (string path; getline(list, path, ',');)
+        paths.push_back(path);
+
+    vector<atomic<long long>> answered(paths.size()), stale(paths.size());
+    vector<thread> clients;
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        for (int c = 0; c < connections; c++)
+        {
+            clients.emplace_back([&, p, c]()
+                                 {
+                                     int fd = connectUnix(paths[p]);
+                                     if (fd < 0)
+                                     {
+                                         cerr << "Cannot connect to " << paths[p] << ".\n";
+                                         return;
+                                     }
+                                     mt19937 random((unsigned)(p * 1000 + c));
+                                     int today = dayNumber(todayKey());
+                                     string reply;
+                                     char chunk[4096];
+                                     while (chrono::steady_clock::now() < deadline)
+                                     {
+                                         string request = "AVAIL " + dateFromKey(keyFromDayNumber(today + (int)(random() % 30))) + ' ' +
+                                                          timeFromMinutes((int)(random() % 48) * 30) + '\n';
+                                         if (write(fd, request.data(), request.size()) != (ssize_t)request.size())
+                                             break;
+                                         reply.clear();
+                                         while (reply.find('\n') == string::npos)
+                                         {
+                                             ssize_t got = read(fd, chunk, sizeof(chunk));
+                                             if (got <= 0)
+                                                 break;
+                                             reply.append(chunk, got);
+                                         }
+                                         if (reply.compare(0, 3, "OK ") == 0)
+                                             answered[p]++;
+                                         else if (reply.compare(0, 6, "STALE ") == 0)
+                                             stale[p]++;
+                                         else
+                                             break;
+                                     }
+                                     close(fd); });
+        }
+    }
+    for (auto &client : clients)
+        client.join();
+
+    long long total = 0;
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        cout << paths[p] << ": " << answered[p] / max(1, seconds) << " queries/s, " << stale[p] << " answered STALE.\n";
+        total += answered[p];
+    }
+    cout << "Total: " << total / max(1, seconds) << " queries/s from " << paths.size() << " replica(s).\n";
+}
+
+// Runs a read replica of the primary shipping its log on primaryPath until SIGINT/SIGTERM; nothing is loaded from or saved to
+// disk and no timers run, so the copy only ever changes through the log
+int runReplica(const string &primaryPath, const string &servePath)
+{
+    ReplicaServer server(rs, replicaLog);
+    if (servePath.empty() || !server.listen(servePath))
+    {
+        cerr << "Cannot listen on " << (servePath.empty() ? "(no socket given)" : servePath) << ".\n";
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, [](int) { serverStopping = true; });
+    signal(SIGTERM, [](int) { serverStopping = true; });
+    replicaLog.start(primaryPath, rs);
+    cerr << "Replica of " << primaryPath << " answering queries on " << servePath << ". Press Ctrl+C to stop.\n";
+    server.run();
+    replicaLog.stop();
+    cerr << "Stopped at LSN " << replicaLog.position() << ".\n";
+    return 0;
+}
+#endif
+
+#ifdef RESERVE_EAT_SERVER
+// Thrown out of a session's pending read when its client hangs up
+struct SessionClosed
+{
+};
+
+// What a finished Task hands back to the coroutine awaiting it
+template <typename T>
+struct TaskResult
+{
+    T value{};
+    void return_value(T result) { value = move(result); }
+    T take() { return move(value); }
+};
+
+template <>
+struct TaskResult<void>
+{
+    void return_void() {}
+    void take() {}
+};
+
+// Lazily started coroutine; awaiting it runs it and resumes the awaiting coroutine when it finishes
+template <typename T = void>
+class Task
+{
+public:
+    struct promise_type : TaskResult<T>
+    {
+        coroutine_handle<> continuation; // Resumed when this task finishes
+        exception_ptr error;
+
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept
+        {
+            struct ResumeCaller
+            {
+                bool await_ready() noexcept { return false; }
+                coroutine_handle<> await_suspend(coroutine_handle<promise_type> finished) noexcept
+                {
+                    coroutine_handle<> next = finished.promise().continuation;
+                    return next ? next : noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return ResumeCaller{};
+        }
+        void unhandled_exception() { error = current_exception(); }
+    };
+
+    Task() = default;
+    explicit Task(coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task &&other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        if (handle)
+            handle.destroy(); // Also destroys the tasks it was awaiting
+    }
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> caller) noexcept
+    {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    T await_resume()
+    {
+        if (handle.promise().error)
+            rethrow_exception(handle.promise().error);
+        return handle.promise().take();
+    }
+
+    coroutine_handle<promise_type> handle;
+};
+
+// One connected client: its unread input, the output not yet written to its socket and the coroutine parked on its next line
+struct Session
+{
+    int fd = -1;
+    string input, output;
+    string prompt;              // Last incomplete line printed, shown again when a request is turned away
+    stringbuf printed;          // Takes cout while this session's coroutine runs
+    coroutine_handle<> waiting; // Suspended until a full line arrives
+    bool hungUp = false;
+    bool queued = false;        // Waiting in the server's run queue
+    bool answered = false;      // Took a line in the current turn; the next line waits for another turn
+    Lane lane = Lane::Customer;
+    Task<> task;
+
+    // Awaitable for the next line of input; throws SessionClosed if the client is gone
+    struct Line
+    {
+        Session &session;
+        bool await_ready() const { return session.hungUp || (!session.answered && session.input.find('\n') != string::npos); }
+        void await_suspend(coroutine_handle<> handle) { session.waiting = handle; }
+        string await_resume()
+        {
+            size_t newline = session.input.find('\n');
+            if (newline == string::npos)
+                throw SessionClosed();
+            session.answered = true;
+            string text = session.input.substr(0, newline);
+            session.input.erase(0, newline + 1);
+            if (!text.empty() && text.back() == '\r')
+                text.pop_back();
+            return text;
+        }
+    };
+    Line line() { return Line{*this}; }
+};
+
+// Arguments of the session coroutines below are plain pointers and references into the awaiting coroutine's frame:
+// GCC 12 can destroy class-type temporaries of a co_await expression twice
+
+// Session version of getValidInt
+Task<int> sessionInt(Session &session, const char *prompt, int min, int max)
+{
+    while (true)
+    {
+        cout << prompt;
+        string input = co_await session.line();
+        if (input.empty())
+            cout << "Error: Input cannot be empty! Please enter a valid whole number.\n";
+        else if (!isAllDigits(input) || input.length() > 9)
+            cout << "Error: Invalid input! Please enter a valid whole number.\n";
+        else if (stoi(input) < min || stoi(input) > max)
+            cout << "Error: Input out of range! Please try again.\n";
+        else
+            co_return stoi(input);
+    }
+}
+
+using FieldCheck = const char *(*)(const string &input); // Returns an error message, or "" if the input is fine
+
+// Asks for a line until check accepts it
+Task<string> sessionField(Session &session, const char *prompt, FieldCheck check)
+{
+    while (true)
+    {
+        cout << prompt;
+        string input = co_await session.line();
+        const char *error = check(input);
+        if (!*error)
+            co_return input;
+        cout << error << "\n";
+    }
+}
+
+// Asks a Y/N question and returns true for Y
+Task<bool> sessionConfirm(Session &session, const char *prompt)
+{
+    string answer = co_await sessionField(session, prompt, [](const string &input)
+                                          { return toUpperCase(input) == "Y" || toUpperCase(input) == "N" ? "" : "Invalid input! Please enter Y or N only."; });
+    co_return toUpperCase(answer) == "Y";
+}
+
+// Session version of browsePages
+Task<> sessionBrowse(Session &session, const function<size_t(size_t offset, size_t limit)> &showPage)
+{
+    size_t offset = 0;
+    while (true)
+    {
+        size_t total = showPage(offset, PAGE_SIZE);
+        if (total <= PAGE_SIZE)
+            co_return;
+
+        size_t last = min(offset + PAGE_SIZE, total);
+        cout << "Showing " << offset + 1 << "-" << last << " of " << total << " reservations.\n";
+        cout << "[N] Next page  [P] Previous page  [Q] Done: ";
+        string input = co_await session.line();
+        input = toUpperCase(input);
+        if (input == "N" && last < total)
+            offset += PAGE_SIZE;
+        else if (input == "P" && offset >= PAGE_SIZE)
+            offset -= PAGE_SIZE;
+        else if (input == "Q" || input.empty())
+            co_return;
+        else
+            cout << "No more pages in that direction.\n";
+    }
+}
+
+// Make reservation, as in customerMenu
+Task<> sessionMakeReservation(Session &session, const string &username)
+{
+    string name = co_await sessionField(session, "Name: ", [](const string &input)
+                                        { return input.empty()          ? "Input cannot be empty! Please enter a valid name."
+                                                 : !isValidName(input) ? "Invalid name! Please use at most 100 characters and no commas."
+                                                                       : ""; });
+    string phoneNo = co_await sessionField(session, "Phone Number (09XXXXXXXXX): ", [](const string &input)
+                                           { return isValidPhoneNo(input) ? "" : "Invalid Contact Number! Please enter a valid contact number."; });
+    string date = co_await sessionField(session, "Date (MM-DD-YYYY): ", [](const string &input)
+                                        { return isValidDate(input) ? "" : "Invalid date format or value! Please follow MM-DD-YYYY."; });
+    string startTime = co_await sessionField(session, "Start Time (HH:MM | 24 hour format): ", [](const string &input)
+                                             { return isValidTime24(input) ? "" : "Invalid time format or value! Please follow HH:MM | 24 hour format."; });
+
+    Admission lookup = admission.throttle(username, RequestKind::Lookup);
+    if (!lookup.admitted)
+    {
+        cout << retryLater(lookup);
+        co_return;
+    }
+    int day = dayNumber(dateKey(date));
+    rs.loadDates(keyFromDayNumber(day - 1), keyFromDayNumber(day + 1));
+    int availableTables = rs.getAvailableTables(date, startTime, addTwoHours24(startTime));
+    cout << "\nAvailable tables for " << date << " at " << startTime << " - " << addTwoHours24(startTime) << ": " << availableTables << " / 10\n";
+    if (availableTables <= 0)
+    {
+        cout << "Sorry, there are no tables available at this time. Please try a different time or date.\n";
+        co_return;
+    }
+    if (!co_await sessionConfirm(session, "Continue with reservation? (Y/N): "))
+    {
+        cout << "Back to menu...\n";
+        co_return;
+    }
+
+    int tablesNeeded = co_await sessionInt(session, "Number of Tables to reserve: ", 1, min(10, availableTables));
+    Admission booking = admission.throttle(username, RequestKind::Booking);
+    if (!booking.admitted)
+    {
+        cout << retryLater(booking);
+        co_return;
+    }
+    try
+    {
+        // Tables may have been taken by another session while this one was typing; they are counted again as it books
+        string id = rs.tryAddReservation(username, name, phoneNo, tablesNeeded, date, startTime);
+        if (id.empty())
+            cout << "Sorry, those tables were just reserved by someone else. Please try again.\n";
+        else
+            cout << "Reservation made successfully! Reservation ID: " << id << endl;
+    }
+    catch (const exception &e)
+    {
+        cout << "The reservation could not be saved: " << e.what() << endl;
+    }
+}
+
+// Cancel reservation, as in customerMenu
+Task<> sessionCancelReservation(Session &session, const string &username)
+{
+    bool pending = rs.hasUserReservationWithStatus(STATUS[0], username), approved = rs.hasUserReservationWithStatus(STATUS[1], username);
+    if (!pending && !approved)
+    {
+        cout << "No cancellable reservations found.\n";
+        co_return;
+    }
+    if (pending)
+        rs.displayUserReservationByStatus(STATUS[0], username);
+    if (approved)
+        rs.displayUserReservationByStatus(STATUS[1], username);
+
+    string id = co_await sessionField(session, "Enter Reservation ID to cancel (or type 'cancel' to go back): ", [](const string &input)
+                                      { return input.empty() ? "Reservation ID cannot be empty! Please enter a valid ID." : ""; });
+    if (toUpperCase(id) == "CANCEL")
+    {
+        cout << "Cancellation Revoked.\n";
+        co_return;
+    }
+    if (!rs.existsForUser(id, username))
+    {
+        cout << "Reservation with ID " << id << " does not exist.\n";
+        co_return;
+    }
+    if (rs.getStatus(id) == STATUS[2] || rs.getStatus(id) == STATUS[3])
+    {
+        cout << "Settled or Rejected Reservation cannot be cancelled.\n";
+        co_return;
+    }
+    string question = "Are you sure you want to cancel reservation ID " + id + "? (Y/N): ";
+    if (co_await sessionConfirm(session, question.c_str()))
+    {
+        rs.cancelReservation(id);
+        cout << "Reservation ID " << id << " has been cancelled successfully.\n";
+    }
+    else
+        cout << "Cancellation aborted.\n";
+}
+
+// Admin over the socket, in the admin lane: reviews pending reservations
+Task<> adminSession(Session &session)
+{
+    function<size_t(size_t, size_t)> showPage = [](size_t offset, size_t limit)
+    { return rs.displayByStatus(STATUS[0], offset, limit); };
+    while (true)
+    {
+        cout << "\n================ ADMIN MENU ================\n[1] Review Reservations\n[2] Log out\n";
+        cout << "============================================\n";
+        int choice = co_await sessionInt(session, "Enter choice: ", 1, 2);
+        cout << "\n";
+        if (choice == 2)
+        {
+            cout << "Logging out...\n";
+            co_return;
+        }
+
+        rs.loadDates(0, 99999999);
+        if (!rs.hasStatus(STATUS[0]))
+        {
+            cout << "No pending reservations to display.\n";
+            continue;
+        }
+        co_await sessionBrowse(session, showPage);
+        string id = co_await sessionField(session, "Enter Reservation ID to review (or type 'cancel' to go back): ", [](const string &input)
+                                          { return input.empty() ? "Reservation ID cannot be empty! Please enter a valid ID." : ""; });
+        if (toUpperCase(id) == "CANCEL")
+            continue;
+        if (!rs.exists(id) || rs.getStatus(id) != STATUS[0])
+        {
+            cout << "Reservation ID " << id << " does not exist or is already reviewed.\n";
+            continue;
+        }
+        string action = co_await sessionField(session, "Approve or Reject? : ", [](const string &input)
+                                              { return toUpperCase(input) == "APPROVE" || toUpperCase(input) == "REJECT" ? "" : "Invalid input! Please enter Approve or Reject only."; });
+        bool approve = toUpperCase(action) == "APPROVE";
+        if (!(approve ? rs.approveReservation(id) : rs.rejectReservation(id)))
+            cout << "Reservation either not found or not pending.\n";
+        else if (approve)
+            cout << "Reservation ID " << id << " has been approved successfully!\n";
+        else
+            cout << "Reservation ID " << id << " has been rejected.\n";
+    }
+}
+
+// A customer's whole visit over the socket: log in (or register), then the customer menu until they log out.
+// Editing, payments and standing reservations keep their console prompts and are not offered here.
+// Logging in as ADMIN with the password in RESERVE_EAT_ADMIN_PASSWORD opens the admin menu instead.
+Task<> customerSession(Session &session)
+{
+    cout << "Welcome to Reserve Eat!\n========== CUSTOMER LOG IN ==========\n";
+    string username = co_await sessionField(session, "Username: ", [](const string &input)
+                                            { return input.empty()              ? "Input cannot be empty! Please enter a valid username."
+                                                     : !isValidUsername(input) ? "Invalid username! Please use at most 32 characters and no commas."
+                                                                               : ""; });
+    username = toUpperCase(username);
+    string password = co_await sessionField(session, "Password: ", [](const string &input)
+                                            { return input.length() < 8 ? "Invalid input! Password must be at least 8 characters long." : ""; });
+    const char *adminPassword = getenv("RESERVE_EAT_ADMIN_PASSWORD");
+    if (username == "ADMIN" && adminPassword && *adminPassword)
+    {
+        if (password != adminPassword)
+        {
+            cout << "Incorrect password! Please try again.\n";
+            co_return;
+        }
+        session.lane = Lane::Admin;
+        co_await adminSession(session);
+        co_return;
+    }
+    if (!userExists(username))
+    {
+        registerUser(username, password);
+        cout << "New user registered successfully!\n";
+    }
+    else if (!authenticateUser(username, password))
+    {
+        cout << "Incorrect password! Please try again.\n";
+        co_return;
+    }
+    else
+        cout << "Login successful!\n";
+
+    rs.loadUser(username);
+    function<size_t(size_t, size_t)> showPage = [&username](size_t offset, size_t limit)
+    { return rs.displayUserReservations(username, offset, limit); };
+    while (true)
+    {
+        for (const auto &outcome : payments.takeNotices(username))
+            cout << "\n" << outcome.message << "\n";
+        for (const auto &message : rs.takeNotices(username))
+            cout << "\n" << message << "\n";
+
+        cout << "\n=========== CUSTOMER MENU ===========\n[1] Make reservation\n[2] View Reservations\n[3] Cancel reservation\n[4] Log out\n";
+        cout << "=====================================\n";
+        int choice = co_await sessionInt(session, "Enter choice: ", 1, 4);
+        cout << "\n";
+        if (choice == 1)
+            co_await sessionMakeReservation(session, username);
+        else if (choice == 2)
+        {
+            Admission lookup = admission.throttle(username, RequestKind::Lookup);
+            if (!lookup.admitted)
+                cout << retryLater(lookup);
+            else if (rs.isUserReservationEmpty(username))
+                cout << "No reservations to display.\n";
+            else
+                co_await sessionBrowse(session, showPage);
+        }
+        else if (choice == 3)
+            co_await sessionCancelReservation(session, username);
+        else
+        {
+            cout << "Logging out...\n";
+            co_return;
+        }
+    }
+}
+
+// Serves customer sessions on a UNIX domain socket. Every session runs on this one thread: a session's coroutine is
+// resumed when a line arrives for it and suspends again at its next prompt, so idle sessions cost a socket and a coroutine frame.
+// A session with a line to answer waits in its lane's run queue and is answered one line per turn, admin lane first;
+// when the queue is full the line is dropped and the client is told when to retry.
+class SessionServer
+{
+private:
+    static constexpr size_t TURNS_PER_POLL = 256;       // Sockets are read again after this many answers
+    static constexpr size_t MAX_PENDING_OUTPUT = 1 << 20; // A client leaving this much unread is not reading; it is dropped
+
+    int listener = -1;
+    string path;
+    vector<unique_ptr<Session>> sessions;
+    deque<Session *> ready[2]; // Run queues, indexed by Lane
+    size_t served = 0, peak = 0;
+
+    // Runs a session until it waits for input again; whatever it prints goes to its socket
+    void resume(Session &session, coroutine_handle<> handle)
+    {
+        streambuf *console = cout.rdbuf(&session.printed);
+        session.answered = false;
+        handle.resume();
+        cout.rdbuf(console);
+        string printed = session.printed.str();
+        session.printed.str("");
+        if (!printed.empty())
+            session.prompt = printed.substr(printed.rfind('\n') == string::npos ? 0 : printed.rfind('\n') + 1);
+        session.output += printed;
+        if (session.task.handle.done() && session.task.handle.promise().error)
+        {
+            try
+            {
+                rethrow_exception(session.task.handle.promise().error);
+            }
+            catch (const SessionClosed &)
+            {
+            }
+            catch (const exception &e)
+            {
+                rs.logToFile(string("Session ended by an error: ") + e.what());
+            }
+            session.task.handle.promise().error = nullptr;
+        }
+        flush(session);
+        schedule(session); // Lines sent ahead wait for the next turn
+    }
 
-                if (id.empty())
+    // Queues a session that has a full line to answer, or turns the line away if the queue is full
+    void schedule(Session &session)
+    {
+        if (!session.waiting || session.queued)
+            return;
+        if (session.hungUp)
+        {
+            resume(session, exchange(session.waiting, nullptr)); // Lets the menu unwind
+            return;
+        }
+        size_t newline = session.input.rfind('\n');
+        if (newline == string::npos)
+            return;
+
+        Admission admitted = admission.enqueue(session.lane);
+        if (admitted.admitted)
+        {
+            session.queued = true;
+            ready[(int)session.lane].push_back(&session);
+            return;
+        }
+        session.input.erase(0, newline + 1); // Everything sent so far is dropped; the client asks again later
+        session.output += retryLater(admitted) + session.prompt;
+        flush(session);
+    }
+
+    // Writes as much pending output as the socket takes, and drops a client that has stopped reading its answers
+    void flush(Session &session)
+    {
+        while (!session.output.empty())
+        {
+            ssize_t written = write(session.fd, session.output.data(), session.output.size());
+            if (written < 0)
+            {
+                bool stalled = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+                if (!stalled || session.output.size() > MAX_PENDING_OUTPUT)
                 {
-                    cout << "Reservation ID cannot be empty! Please enter a valid ID.\n";
+                    if (stalled)
+                        rs.logToFile("Session dropped: " + to_string(session.output.size()) + " bytes of output left unread.");
+                    session.hungUp = true;
+                    session.input.clear(); // Lines sent ahead are not answered either
+                    session.output.clear();
                 }
+                return;
+            }
+            session.output.erase(0, (size_t)written);
+        }
+    }
 
-            } while (id.empty());
+    // Reads what has arrived and wakes the session if a full line is there
+    void receive(Session &session)
+    {
+        char buffer[4096];
+        while (true)
+        {
+            ssize_t count = read(session.fd, buffer, sizeof(buffer));
+            if (count > 0)
+            {
+                session.input.append(buffer, (size_t)count);
+                continue;
+            }
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (count < 0 && errno == EINTR)
+                continue;
+            session.hungUp = true;
+            break;
+        }
+        if (session.input.size() > 65536 && session.input.find('\n') == string::npos)
+            session.hungUp = true; // Not a menu client
+        schedule(session);
+    }
 
-            if (toUpperCase(id) == "CANCEL")
+    // Takes every waiting connection and starts its session
+    void acceptAll()
+    {
+        while (true)
+        {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0)
+                return;
+            setNonBlocking(fd);
+            auto session = make_unique<Session>();
+            session->fd = fd;
+            session->task = customerSession(*session);
+            sessions.push_back(move(session));
+            resume(*sessions.back(), sessions.back()->task.handle);
+            served++;
+            peak = max(peak, sessions.size());
+        }
+    }
+
+public:
+    ~SessionServer()
+    {
+        for (auto &session : sessions)
+            close(session->fd);
+        if (listener >= 0)
+        {
+            close(listener);
+            unlink(path.c_str());
+        }
+    }
+
+    // Binds the socket, replacing one left behind by an earlier run
+    bool listen(const string &socketPath)
+    {
+        listener = listenUnix(socketPath);
+        if (listener < 0)
+            return false;
+        path = socketPath;
+        raiseFileLimit();
+        return true;
+    }
+
+    // Serves sessions until serverStopping is set
+    void run()
+    {
+        vector<pollfd> fds;
+        auto lastSweep = chrono::steady_clock::now();
+        while (!serverStopping)
+        {
+            fds.clear();
+            fds.push_back({listener, POLLIN, 0});
+            for (const auto &session : sessions)
+                fds.push_back({session->fd, (short)(POLLIN | (session->output.empty() ? 0 : POLLOUT)), 0});
+            bool busy = !ready[0].empty() || !ready[1].empty();
+            if (poll(fds.data(), fds.size(), busy ? 0 : 500) < 0)
             {
-                cout << "Review cancelled. Returning to previous menu...\n";
+                if (errno == EINTR)
+                    continue;
                 break;
             }
 
-            if (!rs.exists(id))
+            for (size_t i = 0; i + 1 < fds.size(); i++)
             {
-                cout << "Reservation with ID " << id << " does not exist.\n";
-                break;
+                if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+                    receive(*sessions[i]);
+                if (fds[i + 1].revents & POLLOUT)
+                    flush(*sessions[i]);
             }
 
-            if (rs.getStatus(id) != STATUS[0]) // Check if the status is "Pending"
+            for (size_t turn = 0; turn < TURNS_PER_POLL && (!ready[0].empty() || !ready[1].empty()); turn++)
             {
-                cout << "Reservation ID " << id << " status is already updated.\n";
-                break;
+                Lane lane = ready[(int)Lane::Admin].empty() ? Lane::Customer : Lane::Admin;
+                Session *session = ready[(int)lane].front();
+                ready[(int)lane].pop_front();
+                session->queued = false;
+                admission.dequeue(lane);
+                if (session->waiting)
+                    resume(*session, exchange(session->waiting, nullptr));
             }
 
-            do
+            if (chrono::steady_clock::now() - lastSweep > chrono::minutes(1))
             {
-                cout << "Approve or Reject reservation ID " << id << "? : "; // Enter "Approve" or "Reject"
-                getline(cin, action);
-                action = toUpperCase(action);
+                admission.forgetIdle();
+                lastSweep = chrono::steady_clock::now();
+            }
 
-                if (action.empty())
-                {
-                    cout << "Review option cannot be empty! Please enter Approve or Reject.\n";
-                }
-                else if (action == "APPROVE" || action == "REJECT")
-                {
-                    do
-                    {
-                        cout << "Are you sure you want to " << toLowerCase(action) << " reservation ID " << id << "? (Y/N): ";
-                        getline(cin, confirm);
-                        confirm = toUpperCase(confirm);
+            // A session ends when its menu returns and its last output is sent, or when its client is gone
+            sessions.erase(remove_if(sessions.begin(), sessions.end(), [](const unique_ptr<Session> &session)
+                                     {
+                                         bool finished = !session->queued && (session->hungUp || (session->task.handle.done() && session->output.empty()));
+                                         if (finished)
+                                             close(session->fd);
+                                         return finished; }),
+                           sessions.end());
+
+            if (fds[0].revents & POLLIN)
+                acceptAll();
+        }
+        rs.logToFile("Session server stopped: " + to_string(served) + " session(s) served, at most " + to_string(peak) + " at once, " + admission.stats());
+    }
+};
 
-                        if (confirm == "Y")
-                        {
-                            if (action == "APPROVE")
-                            {
-                                rs.approveReservation(id);
-                                cout << "Reservation ID " << id << " has been approved successfully!\n";
-                            }
-                            else
-                            {
-                                rs.rejectReservation(id);
-                                cout << "Reservation ID " << id << " has been rejected.\n";
-                            }
-                            break;
-                        }
-                        else if (confirm == "N")
-                        {
-                            cout << action << " cancelled.\n";
-                            break;
-                        }
-                        else
-                        {
-                            cout << "Invalid input! Please enter Y or N only.\n";
-                        }
-                    } while (confirm != "Y" && confirm != "N");
+// Opens count customer sessions against a running --serve process, keeps them all connected and times menu round trips
+void runLoadTest(const string &socketPath, int count, int requests)
+{
+    raiseFileLimit();
+    struct Client
+    {
+        int fd;
+        string received;
+    };
+    vector<Client> clients;
+    auto started = chrono::steady_clock::now();
+    auto millisecondsSince = [](chrono::steady_clock::time_point start)
+    { return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(); };
+
+    for (int i = 0; i < count; i++)
+    {
+        int fd = connectUnix(socketPath);
+        if (fd < 0)
+        {
+            cerr << "Connection " << i + 1 << " failed: " << strerror(errno) << "\n";
+            break;
+        }
+        setNonBlocking(fd);
+        clients.push_back({fd, ""});
+    }
+    if (clients.empty())
+        return;
+    double connectMs = millisecondsSince(started);
 
-                    break;
-                }
-                else
+    auto send = [](Client &client, const string &text)
+    {
+        for (size_t sent = 0; sent < text.size();)
+        {
+            ssize_t written = write(client.fd, text.data() + sent, text.size() - sent);
+            if (written > 0)
+                sent += (size_t)written;
+            else if (errno != EAGAIN && errno != EINTR)
+                return;
+        }
+    };
+    // Waits until each of the given clients has been shown the customer menu prompt, counting answers that say to retry
+    size_t turnedAway = 0;
+    auto awaitMenu = [&](const vector<size_t> &waiting)
+    {
+        const string prompt = "Enter choice: ";
+        vector<size_t> left = waiting;
+        vector<pollfd> fds;
+        while (!left.empty())
+        {
+            fds.clear();
+            for (size_t index : left)
+                fds.push_back({clients[index].fd, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), 10000) <= 0)
+            {
+                cerr << left.size() << " session(s) did not answer.\n";
+                return false;
+            }
+            vector<size_t> still;
+            for (size_t k = 0; k < left.size(); k++)
+            {
+                Client &client = clients[left[k]];
+                char buffer[4096];
+                ssize_t count;
+                while ((count = read(client.fd, buffer, sizeof(buffer))) > 0)
+                    client.received.append(buffer, (size_t)count);
+                if (count == 0)
+                    return false;
+                bool answered = client.received.size() >= prompt.size() &&
+                                client.received.compare(client.received.size() - prompt.size(), prompt.size(), prompt) == 0;
+                if (answered)
                 {
-                    cout << "Invalid input! Please enter Approve or Reject only.\n";
+                    turnedAway += client.received.find("Too many requests") != string::npos;
+                    client.received.clear();
                 }
-
-            } while (condition);
-            break;
+                else
+                    still.push_back(left[k]);
+            }
+            left.swap(still);
         }
+        return true;
+    };
 
-        // Back to main menu
-        case 3:
+    // Logging in takes two answers, so sessions log in a wave at a time to stay within the server's queue
+    vector<size_t> everyone(clients.size());
+    auto loginStart = chrono::steady_clock::now();
+    for (size_t first = 0; first < clients.size(); first += 256)
+    {
+        vector<size_t> wave;
+        for (size_t i = first; i < min(first + 256, clients.size()); i++)
         {
-            cout << "Logging out...\n\n";
-            condition = false;
+            everyone[i] = i;
+            wave.push_back(i);
+            send(clients[i], TEST_ACCOUNT_PREFIX + to_string(i) + "\nloadtest-password\n");
+        }
+        if (!awaitMenu(wave))
+            return;
+    }
+    double loginMs = millisecondsSince(loginStart);
+
+    // One request at a time from a random session while all the others sit idle
+    mt19937 random(42);
+    vector<double> latencies;
+    for (int r = 0; r < requests; r++)
+    {
+        size_t index = random() % clients.size();
+        auto sent = chrono::steady_clock::now();
+        send(clients[index], "2\n");
+        if (!awaitMenu({index}))
             return;
+        latencies.push_back(millisecondsSince(sent));
+    }
+    sort(latencies.begin(), latencies.end());
+
+    // A tenth of the sessions flood the server with pipelined requests while the others keep asking one at a time
+    size_t flooders = clients.size() / 10;
+    vector<double> spikeLatencies;
+    size_t floodTurnedAway = 0;
+    if (flooders > 0 && flooders < clients.size())
+    {
+        string flood;
+        for (int k = 0; k < 50; k++)
+            flood += "2\n";
+        for (size_t i = 0; i < flooders; i++)
+            send(clients[i], flood);
+        size_t before = turnedAway;
+        for (int r = 0; r < requests; r++)
+        {
+            size_t index = flooders + random() % (clients.size() - flooders);
+            auto sent = chrono::steady_clock::now();
+            send(clients[index], "2\n");
+            if (!awaitMenu({index}))
+                return;
+            spikeLatencies.push_back(millisecondsSince(sent));
         }
+        sort(spikeLatencies.begin(), spikeLatencies.end());
+        floodTurnedAway = turnedAway - before;
+
+        // Reads the flood's answers until the server has been quiet for a second
+        vector<pollfd> fds;
+        for (size_t i = 0; i < flooders; i++)
+            fds.push_back({clients[i].fd, POLLIN, 0});
+        while (poll(fds.data(), fds.size(), 1000) > 0)
+        {
+            for (size_t i = 0; i < flooders; i++)
+            {
+                char buffer[65536];
+                ssize_t count;
+                while ((count = read(clients[i].fd, buffer, sizeof(buffer))) > 0)
+                {
+                    string_view text(buffer, (size_t)count);
+                    for (size_t at = text.find("Too many requests"); at != string_view::npos; at = text.find("Too many requests", at + 1))
+                        floodTurnedAway++;
+                }
+            }
         }
     }
+
+    // Every session asks at once
+    size_t before = turnedAway;
+    auto burstStart = chrono::steady_clock::now();
+    for (auto &client : clients)
+        send(client, "2\n");
+    if (!awaitMenu(everyone))
+        return;
+    double burstMs = millisecondsSince(burstStart);
+    size_t burstTurnedAway = turnedAway - before;
+
+    for (auto &client : clients)
+    {
+        send(client, "4\n");
+        close(client.fd);
+    }
+
+    cout << fixed << setprecision(2);
+    cout << clients.size() << " session(s) connected in " << connectMs << " ms and logged in in " << loginMs << " ms.\n";
+    if (!latencies.empty())
+        cout << "Single requests with the rest idle: p50 " << latencies[latencies.size() / 2] << " ms, p99 "
+             << latencies[latencies.size() * 99 / 100] << " ms, max " << latencies.back() << " ms over " << latencies.size() << " request(s).\n";
+    if (!spikeLatencies.empty())
+        cout << "Single requests while " << flooders << " session(s) flood: p50 " << spikeLatencies[spikeLatencies.size() / 2] << " ms, p99 "
+             << spikeLatencies[spikeLatencies.size() * 99 / 100] << " ms, max " << spikeLatencies.back() << " ms; "
+             << floodTurnedAway << " flood request(s) told to retry.\n";
+    cout << "All sessions at once: " << clients.size() << " request(s) in " << burstMs << " ms, " << burstTurnedAway << " told to retry.\n";
 }
+#endif
 
 // Main program
-int main()
+int main(int argc, char *argv[])
 {
-    loadUsersFromFile();
-    rs.loadReservationsFromFile("reservations.txt");
+    setEngineOutput(&cout); // The console shows the engine's listings and problems
+    setEngineLog([](const string &message)
+                 { cerr << message << '\n'; });
+#ifdef RESERVE_EAT_BENCH
+    if (argc > 1 && string(argv[1]) == "--bench")
+    {
+        runBenchmark(argc > 2 ? atoi(argv[2]) : 100000);
+        return 0;
+    }
+#endif
+    // --selftest runs the engine's regression checks and exits with 1 if any failed
+    if (argc > 1 && string(argv[1]) == "--selftest")
+        return runSelfTest() ? 0 : 1;
+    // --simulate [days] [seed] [arrivals per day] runs a virtual stretch of bookings through the engine and reports on it
+    if (argc > 1 && string(argv[1]) == "--simulate")
+    {
+        runSimulation(argc > 2 ? atoi(argv[2]) : 365, argc > 3 ? (unsigned)atoi(argv[3]) : 1, argc > 4 ? atof(argv[4]) : 60);
+        return 0;
+    }
+#ifdef RESERVE_EAT_MEMPROFILE
+    // --memreport [reservations file] [users file] loads them and reports the heap they take up
+    if (argc > 1 && string(argv[1]) == "--memreport")
+    {
+        runMemoryReport(argc > 2 ? argv[2] : "reservations.txt", argc > 3 ? argv[3] : "users.txt");
+        return 0;
+    }
+#endif
+
+    // --store <file> mirrors the book into a paged on-disk store, written through on every change, instead of rewriting
+    // reservations.txt at exit; the load window still decides how much of it is held in memory
+    // --window-days <days> loads that many days of history at startup (default 7, -1 loads everything)
+    // --serve <socket> serves customer sessions on a UNIX domain socket instead of the console menu
+    // --loadtest <socket> [sessions] [requests] drives a running server and reports its response times; its sessions
+    // log in as ~LOADTEST0, ~LOADTEST1, ..., which the server keeps in memory only
+    // --ship <socket> streams every change to read replicas connecting on a UNIX domain socket
+    // --replica <primary socket> <socket> runs a read replica of a --ship process, answering availability queries on <socket>
+    // --readtest <socket>[,<socket>...] [seconds] [connections] measures the queries per second replicas answer
+    string storePath, servePath, shipPath;
+    int windowDays = 7;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (string(argv[i]) == "--ship" || string(argv[i]) == "--replica" || string(argv[i]) == "--readtest")
+        {
+#ifdef RESERVE_EAT_POSIX
+            if (string(argv[i]) == "--ship")
+                shipPath = argv[i + 1];
+            else if (string(argv[i]) == "--readtest")
+            {
+                runReadTest(argv[i + 1], i + 2 < argc ? atoi(argv[i + 2]) : 5, i + 3 < argc ? atoi(argv[i + 3]) : 4);
+                return 0;
+            }
+            else
+                return runReplica(argv[i + 1], i + 2 < argc ? argv[i + 2] : "");
+#else
+            cerr << argv[i] << " needs UNIX domain sockets (a POSIX system).\n";
+            return 1;
+#endif
+        }
+        if (string(argv[i]) == "--store")
+            storePath = argv[i + 1];
+        else if (string(argv[i]) == "--window-days")
+            windowDays = atoi(argv[i + 1]);
+        else if (string(argv[i]) == "--serve" || string(argv[i]) == "--loadtest")
+        {
+#ifdef RESERVE_EAT_SERVER
+            if (string(argv[i]) == "--serve")
+                servePath = argv[i + 1];
+            else
+            {
+                runLoadTest(argv[i + 1], i + 2 < argc ? atoi(argv[i + 2]) : 1000, i + 3 < argc ? atoi(argv[i + 3]) : 1000);
+                return 0;
+            }
+#else
+            cerr << argv[i] << " needs a C++20 build with coroutines on a POSIX system (g++ -std=c++20).\n";
+            return 1;
+#endif
+        }
+    }
 
-    bool condition = true;
+    thread userLoader([]
+                      { loadUsersFromFile(); }); // Users and reservations share nothing, so they load side by side
+    rs.setLoadWindow(windowDays);
+    if (storePath.empty() || !filesystem::exists(storePath))
+        rs.loadReservationsFromFile("reservations.txt"); // A new store starts from reservations.txt
+    userLoader.join();
+    if (!storePath.empty() && !rs.openStore(storePath))
+    {
+        cerr << "Cannot open reservation store " << storePath << ".\n";
+        return 1;
+    }
+    rs.loadStandingRules();
+    rs.archiveColdReservations();
+    rs.startTimers((int)envSetting("RESERVE_EAT_REMINDER_HOURS", 24)); // Pending bookings already past their start expire now
+#ifdef RESERVE_EAT_POSIX
+    LogShipper shipper;
+    if (!shipPath.empty())
+    {
+        if (!shipper.start(shipPath, rs))
+        {
+            cerr << "Cannot listen for replicas on " << shipPath << ".\n";
+            return 1;
+        }
+        signal(SIGPIPE, SIG_IGN);
+    }
+#endif
+
+    bool condition = servePath.empty();
+#ifdef RESERVE_EAT_SERVER
+    if (!servePath.empty())
+    {
+        SessionServer server;
+        if (!server.listen(servePath))
+        {
+            cerr << "Cannot listen on " << servePath << ".\n";
+            return 1;
+        }
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGINT, [](int) { serverStopping = true; });
+        signal(SIGTERM, [](int) { serverStopping = true; });
+        cerr << "Serving customer sessions on " << servePath << ". Press Ctrl+C to stop.\n";
+        server.run();
+    }
+#endif
     int choice;
 
     // Main menu
@@ -1593,7 +3838,15 @@ int main()
                 {
                     cout << "Input cannot be empty! Please enter a valid username.\n";
                 }
-            } while (username.empty());
+                else if (!isValidUsername(username))
+                {
+                    cout << "Invalid username! Please use at most " << MAX_USERNAME_LENGTH << " characters and no commas.\n";
+                }
+                else if (username.rfind(TEST_ACCOUNT_PREFIX, 0) == 0)
+                {
+                    cout << "Invalid username! Names starting with " << TEST_ACCOUNT_PREFIX << " are reserved for load tests.\n";
+                }
+            } while (!isValidUsername(username) || username.rfind(TEST_ACCOUNT_PREFIX, 0) == 0);
 
             do
             {
@@ -1647,7 +3900,17 @@ int main()
         }
         }
     }
+    payments.shutdown(); // Let payments in progress finish before saving
+    rs.stopTimers();
+#ifdef RESERVE_EAT_POSIX
+    shipper.stop();
+#endif
     saveUsersToFile();
-    rs.saveReservationsToFile("reservations.txt");
+    rs.saveStandingRules();
+    rs.archiveColdReservations();
+    if (rs.usesStore())
+        rs.logToFile("Reservation store closed: " + rs.storeStats()); // Already written through
+    else
+        rs.saveReservationsToFile("reservations.txt");
     return 0;
-}
\ No newline at end of file
+}